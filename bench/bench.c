@@ -0,0 +1,1117 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "../client/src/mesher.c"
+#include "../client/src/worldgen.c"
+#include "../client/src/region.c"
+#include "../client/src/player.c"
+#include "../client/src/matrix.c"
+#include "../client/res/obj_parser.c"
+#include "../chunk_format.c"
+#include "../server/src/world.c"
+
+// GL-free benchmarks for the client's hot paths (make bench)
+// output is CSV (benchmark,case,ops_per_sec,ns_per_op,vertices_per_sec) so runs can be diffed or graphed
+// ops are chunks for the meshing benchmarks, and single calls for everything else
+
+#define BENCH_SECONDS 0.5 // minimum time spent on each benchmark
+
+static double get_seconds() {
+
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static void print_result(const char *benchmark, const char *bench_case, long ops, double elapsed, long vertices) {
+
+	printf("%s,%s,%.0f,%.1f,", benchmark, bench_case, ops / elapsed, elapsed * 1e9 / ops);
+
+	if (vertices >= 0) {
+		printf("%.0f\n", vertices / elapsed);
+	} else {
+		printf("\n");
+	}
+}
+
+// keeps the compiler from optimizing away work whose result is otherwise unused
+static volatile float bench_sink;
+
+// deterministic synthetic worlds, as functions of block coordinates so chunk borders line up with their neighbors
+
+static unsigned char generate_flat(int x, int y, int z) {
+
+	return y < 8;
+}
+
+static unsigned char generate_hills(int x, int y, int z) {
+
+	return y < 8 + 3 * sin(x * 0.3) + 3 * cos(z * 0.2);
+}
+
+static unsigned char generate_noisy(int x, int y, int z) {
+
+	// integer hash, so every run sees the same blocks
+	unsigned int hash = (unsigned int) x * 73856093u ^ (unsigned int) y * 19349663u ^ (unsigned int) z * 83492791u;
+	hash ^= hash >> 13;
+	hash *= 0x5bd1e995u;
+	hash ^= hash >> 15;
+
+	return hash % 3 == 0;
+}
+
+static unsigned char generate_caves(int x, int y, int z) {
+
+	// solid ground up to y = 24, with winding tunnels where a few sine waves line up
+	if (y >= 24)
+		return 0;
+
+	return sin(x * 0.31) + sin(y * 0.47 + x * 0.13) + sin(z * 0.29 - y * 0.11) < 1.1;
+}
+
+static unsigned char generate_checkerboard(int x, int y, int z) {
+
+	return (x + y + z) & 1; // every face of every solid block is exposed
+}
+
+typedef struct {
+
+	const char *name;
+	unsigned char (*generate)(int x, int y, int z);
+
+} BenchWorld;
+
+static const BenchWorld bench_worlds[] = {
+	{"flat", generate_flat},
+	{"hills", generate_hills},
+	{"noisy", generate_noisy},
+	{"caves", generate_caves},
+	{"checkerboard", generate_checkerboard},
+};
+
+#define BENCH_WORLD_COUNT (sizeof(bench_worlds) / sizeof(BenchWorld))
+
+// a World streamed in around the origin, filled by whichever BenchWorld is being loaded
+static const BenchWorld *loading_bench_world;
+
+static void on_bench_chunk_load(Chunk *chunk) {
+
+	unsigned char blocks[16][16][16];
+
+	for (int x = 0; x < 16; x++)
+		for (int y = 0; y < 16; y++)
+			for (int z = 0; z < 16; z++)
+				blocks[x][y][z] = loading_bench_world->generate(chunk->x * 16 + x, chunk->y * 16 + y, chunk->z * 16 + z);
+
+	pack_chunk_blocks(&chunk->blocks, blocks);
+}
+
+static void load_bench_world(World *world, const BenchWorld *bench_world) {
+
+	initialize_world(world, 2, 1);
+	world->on_chunk_load = on_bench_chunk_load;
+
+	loading_bench_world = bench_world;
+
+	do {
+		update_world(world, 0, 0, 0);
+	} while (world->load_queue_head < world->load_queue_count);
+}
+
+// ops are 16x16 chunk heightmaps, walking across the world so every call sees new coordinates
+static void bench_noise() {
+
+	static const struct { const char *name; int octaves; int per_sample; } cases[] = {
+		{"16x16_1_octave", 1, FALSE},
+		{"16x16_4_octaves", 4, FALSE},
+		{"16x16_4_octaves_per_sample", 4, TRUE}, // fractal_noise_2D for every sample, no SIMD across rows
+	};
+
+	float heightmap[16][16];
+
+	for (int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+
+		long ops = 0;
+
+		double start = get_seconds();
+		double elapsed;
+
+		do {
+
+			for (int i = 0; i < 64; i++) {
+
+				int chunk_x = ops + i;
+				int chunk_z = -(ops + i) / 7;
+
+				if (cases[c].per_sample) {
+
+					for (int x = 0; x < 16; x++)
+						for (int z = 0; z < 16; z++)
+							heightmap[x][z] = fractal_noise_2D(1, (chunk_z * 16 + z) / 48.0f, (chunk_x * 16 + x) / 48.0f, cases[c].octaves);
+
+				} else {
+					populate_chunk_heightmap(1, chunk_x, chunk_z, 1 / 48.0f, cases[c].octaves, heightmap);
+				}
+
+				bench_sink = heightmap[3][5];
+			}
+
+			ops += 64;
+			elapsed = get_seconds() - start;
+
+		} while (elapsed < BENCH_SECONDS);
+
+		print_result("chunk_heightmap", cases[c].name, ops, elapsed, -1);
+	}
+}
+
+#define WORLDGEN_BENCH_RADIUS 6 // chunks requested: (2r)^2 columns, 3 high
+
+// requests a fresh area from the generator and polls until all of it is done, returns the seconds it took
+static double generate_bench_area(WorldGenerator *gen) {
+
+	ChunkBlocks blocks = {0};
+	int done;
+
+	double start = get_seconds();
+
+	do {
+
+		done = TRUE;
+
+		for (int x = -WORLDGEN_BENCH_RADIUS; x < WORLDGEN_BENCH_RADIUS; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -WORLDGEN_BENCH_RADIUS; z < WORLDGEN_BENCH_RADIUS; z++)
+					done &= request_generated_chunk(gen, x, y, z, &blocks);
+
+		if (!done)
+			usleep(100);
+
+	} while (!done);
+
+	free_chunk_blocks(&blocks);
+
+	return get_seconds() - start;
+}
+
+// generated chunks per second as worker threads are added, then the same area again out of the cache
+static void bench_worldgen() {
+
+	int cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int area = WORLDGEN_BENCH_RADIUS * 2 * WORLDGEN_BENCH_RADIUS * 2 * 3;
+
+	for (int threads = 1; threads <= cores; threads = threads * 2 > cores && threads != cores ? cores : threads * 2) {
+
+		long chunks = 0;
+		double elapsed = 0;
+		unsigned int seed = 1;
+
+		// a new seed each round, so nothing comes from the cache
+		do {
+
+			WorldGenerator gen;
+			initialize_world_generator(&gen, seed++, threads, 4096);
+
+			elapsed += generate_bench_area(&gen);
+			chunks += gen.chunks_generated;
+
+			free_world_generator(&gen);
+
+		} while (elapsed < BENCH_SECONDS);
+
+		char bench_case[64];
+		snprintf(bench_case, sizeof(bench_case), "%d_threads", threads);
+
+		print_result("generate_chunk", bench_case, chunks, elapsed, -1);
+	}
+
+	WorldGenerator gen;
+	initialize_world_generator(&gen, 1, 0, 4096);
+	generate_bench_area(&gen);
+
+	long chunks = 0;
+	double elapsed = 0;
+
+	do {
+		elapsed += generate_bench_area(&gen);
+		chunks += area;
+	} while (elapsed < BENCH_SECONDS);
+
+	print_result("generate_chunk", "cached", chunks, elapsed, -1);
+
+	free_world_generator(&gen);
+}
+
+// meshes every loaded chunk over and over, unpacking and borders included, like remesh_chunk does minus the upload
+static void bench_mesher() {
+
+	static const struct { const char *name; int mode; } modes[] = {
+		{"per_face_scalar", CHUNK_MESH_PER_FACE_SCALAR}, // append_block_to_mesh for every block
+		{"per_face_bitmask", CHUNK_MESH_PER_FACE},
+		{"greedy", CHUNK_MESH_GREEDY},
+	};
+
+	unsigned char blocks[16][16][16];
+	unsigned char borders[6][16][16];
+
+	for (int w = 0; w < BENCH_WORLD_COUNT; w++) {
+
+		World world;
+		load_bench_world(&world, &bench_worlds[w]);
+
+		for (int m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+
+			// reuse one allocation, like a worker meshing chunk after chunk would
+			EZArray mesh = {0};
+			long chunks = 0;
+			long vertices = 0;
+
+			double start = get_seconds();
+			double elapsed;
+
+			do {
+
+				for (int i = 0; i < world.loaded_count; i++) {
+
+					int vertex_count = 0;
+					mesh.bytecount = 0;
+
+					unpack_chunk_blocks(&world.loaded[i]->blocks, blocks);
+					copy_chunk_borders(&world, world.loaded[i], borders);
+					build_chunk_mesh(&mesh, &vertex_count, blocks, borders, modes[m].mode);
+
+					vertices += vertex_count;
+				}
+
+				chunks += world.loaded_count;
+				elapsed = get_seconds() - start;
+
+			} while (elapsed < BENCH_SECONDS);
+
+			char bench_case[64];
+			snprintf(bench_case, sizeof(bench_case), "%s_%s", bench_worlds[w].name, modes[m].name);
+
+			print_result("mesh_chunk", bench_case, chunks, elapsed, vertices);
+
+			free(mesh.data);
+		}
+
+		free_world(&world);
+	}
+}
+
+// a view's worth of generated terrain, with its caves and trees
+static void load_generated_world(World *world) {
+
+	WorldGenerator gen;
+	initialize_world_generator(&gen, 1, 0, 4096);
+	generate_bench_area(&gen);
+
+	initialize_world(world, WORLDGEN_BENCH_RADIUS - 1, 1);
+
+	for (int x = -WORLDGEN_BENCH_RADIUS; x < WORLDGEN_BENCH_RADIUS; x++)
+		for (int y = -1; y <= 1; y++)
+			for (int z = -WORLDGEN_BENCH_RADIUS; z < WORLDGEN_BENCH_RADIUS; z++) {
+
+				ChunkBlocks blocks = {0};
+				request_generated_chunk(&gen, x, y, z, &blocks);
+				load_chunk(world, x, y, z, &blocks);
+			}
+
+	free_world_generator(&gen);
+}
+
+// packing, unpacking and random reads of palette compressed chunks, on the bench worlds and on generated terrain
+// (whose memory use per chunk goes to stderr, keeping stdout plain CSV)
+static void bench_chunk_blocks() {
+
+	World worlds[BENCH_WORLD_COUNT + 1];
+	const char *names[BENCH_WORLD_COUNT + 1];
+
+	for (int w = 0; w < BENCH_WORLD_COUNT; w++) {
+		load_bench_world(&worlds[w], &bench_worlds[w]);
+		names[w] = bench_worlds[w].name;
+	}
+
+	load_generated_world(&worlds[BENCH_WORLD_COUNT]);
+	names[BENCH_WORLD_COUNT] = "generated";
+
+	unsigned char blocks[16][16][16];
+
+	for (int w = 0; w <= BENCH_WORLD_COUNT; w++) {
+
+		World *world = &worlds[w];
+		int width_counts[9] = {0};
+
+		for (int i = 0; i < world->loaded_count; i++) {
+			width_counts[world->loaded[i]->blocks.bits]++;
+		}
+
+		fprintf(stderr, "%s: %d chunks, %.0f bytes of blocks per chunk (0/1/2/4/8 bits: %d/%d/%d/%d/%d)\n", names[w], world->loaded_count,
+			(double) get_world_block_memory(world) / world->loaded_count, width_counts[0], width_counts[1], width_counts[2], width_counts[4], width_counts[8]);
+
+		char bench_case[64];
+		long ops = 0;
+		double start = get_seconds();
+		double elapsed;
+
+		do {
+
+			for (int i = 0; i < world->loaded_count; i++) {
+				unpack_chunk_blocks(&world->loaded[i]->blocks, blocks);
+				pack_chunk_blocks(&world->loaded[i]->blocks, blocks);
+			}
+
+			ops += world->loaded_count;
+			elapsed = get_seconds() - start;
+
+		} while (elapsed < BENCH_SECONDS);
+
+		snprintf(bench_case, sizeof(bench_case), "%s_unpack_pack", names[w]);
+		print_result("chunk_blocks", bench_case, ops, elapsed, -1);
+
+		// reads scattered all over the loaded chunks
+		unsigned int sum = 0;
+		ops = 0;
+		rng_state = 1;
+		start = get_seconds();
+
+		do {
+
+			for (int i = 0; i < 4096; i++) {
+
+				const Chunk *chunk = world->loaded[random_uint(world->loaded_count)];
+				unsigned int position = random_uint(4096);
+
+				sum += get_chunk_block(&chunk->blocks, position >> 8, position >> 4 & 15, position & 15);
+			}
+
+			ops += 4096;
+			elapsed = get_seconds() - start;
+
+		} while (elapsed < BENCH_SECONDS);
+
+		bench_sink = sum;
+
+		snprintf(bench_case, sizeof(bench_case), "%s_get", names[w]);
+		print_result("chunk_blocks", bench_case, ops, elapsed, -1);
+
+		free_world(world);
+	}
+}
+
+// the network chunk format, with and without LZ, on the bench worlds and on generated terrain
+// (average encoded sizes go to stderr, keeping stdout plain CSV)
+static void bench_chunk_format() {
+
+	World worlds[BENCH_WORLD_COUNT + 1];
+	const char *names[BENCH_WORLD_COUNT + 1];
+
+	for (int w = 0; w < BENCH_WORLD_COUNT; w++) {
+		load_bench_world(&worlds[w], &bench_worlds[w]);
+		names[w] = bench_worlds[w].name;
+	}
+
+	load_generated_world(&worlds[BENCH_WORLD_COUNT]);
+	names[BENCH_WORLD_COUNT] = "generated";
+
+	for (int w = 0; w <= BENCH_WORLD_COUNT; w++) {
+
+		World *world = &worlds[w];
+
+		unsigned char (*blocks)[16][16][16] = malloc(sizeof(unsigned char[16][16][16]) * world->loaded_count);
+		unsigned char *encoded = malloc(MAX_ENCODED_CHUNK_SIZE * world->loaded_count);
+		int *lengths = malloc(sizeof(int) * world->loaded_count);
+
+		for (int i = 0; i < world->loaded_count; i++) {
+			unpack_chunk_blocks(&world->loaded[i]->blocks, blocks[i]);
+		}
+
+		for (int compress = FALSE; compress <= TRUE; compress++) {
+
+			char bench_case[64];
+			long ops = 0;
+			long bytes = 0;
+			double start = get_seconds();
+			double elapsed;
+
+			do {
+
+				for (int i = 0; i < world->loaded_count; i++) {
+					lengths[i] = encode_chunk(blocks[i], compress, encoded + MAX_ENCODED_CHUNK_SIZE * i);
+				}
+
+				ops += world->loaded_count;
+				elapsed = get_seconds() - start;
+
+			} while (elapsed < BENCH_SECONDS);
+
+			snprintf(bench_case, sizeof(bench_case), "%s_encode%s", names[w], compress ? "_lz" : "");
+			print_result("chunk_format", bench_case, ops, elapsed, -1);
+
+			for (int i = 0; i < world->loaded_count; i++) {
+				bytes += lengths[i];
+			}
+
+			fprintf(stderr, "%s: %.0f bytes per chunk%s\n", names[w], (double) bytes / world->loaded_count, compress ? " with LZ" : "");
+
+			unsigned char decoded[16][16][16];
+			ops = 0;
+			start = get_seconds();
+
+			do {
+
+				for (int i = 0; i < world->loaded_count; i++) {
+					bench_sink = decode_chunk(encoded + MAX_ENCODED_CHUNK_SIZE * i, lengths[i], decoded);
+				}
+
+				ops += world->loaded_count;
+				elapsed = get_seconds() - start;
+
+			} while (elapsed < BENCH_SECONDS);
+
+			snprintf(bench_case, sizeof(bench_case), "%s_decode%s", names[w], compress ? "_lz" : "");
+			print_result("chunk_format", bench_case, ops, elapsed, -1);
+		}
+
+		free(blocks);
+		free(encoded);
+		free(lengths);
+		free_world(world);
+	}
+}
+
+#define EXPLOSION_RADIUS 5
+
+// what the client does with each kind of message collect_block_deltas makes, returns FALSE if it didn't apply
+static int apply_server_delta(World *world, const unsigned char *message, int length) {
+
+	int x = get_message_uint(message + 1);
+	int y = get_message_uint(message + 5);
+	int z = get_message_uint(message + 9);
+
+	switch (message[0]) {
+
+		case SERVER_MESSAGE_BLOCK:
+			set_block(world, x, y, z, message[13]);
+			return get_block(world, x, y, z) == message[13];
+
+		case SERVER_MESSAGE_BLOCKS:
+			return apply_block_changes(world, x, y, z, message + CHUNK_MESSAGE_HEADER_SIZE, (length - CHUNK_MESSAGE_HEADER_SIZE) / BLOCK_CHANGE_SIZE);
+
+		case SERVER_MESSAGE_CHUNK:
+			return apply_encoded_chunk(world, x, y, z, message + CHUNK_MESSAGE_HEADER_SIZE, length - CHUNK_MESSAGE_HEADER_SIZE);
+	}
+
+	return FALSE;
+}
+
+// the server's deltas for one tick, copied out (collect_block_deltas reuses its buffers)
+typedef struct {
+
+	unsigned char *messages;
+	int lengths[8];
+	int count;
+	int kinds[3]; // how many were SERVER_MESSAGE_BLOCK, _BLOCKS and _CHUNK
+
+} DeltaSet;
+
+// sets every block in the sphere on the server and takes that tick's deltas
+static void collect_explosion_deltas(ServerWorld *server, unsigned char block, DeltaSet *set) {
+
+	for (int x = -EXPLOSION_RADIUS; x < EXPLOSION_RADIUS; x++)
+		for (int y = -EXPLOSION_RADIUS; y < EXPLOSION_RADIUS; y++)
+			for (int z = -EXPLOSION_RADIUS; z < EXPLOSION_RADIUS; z++)
+				if (x * x + y * y + z * z <= EXPLOSION_RADIUS * EXPLOSION_RADIUS)
+					set_server_block(server, x, y, z, block);
+
+	collect_block_deltas(server);
+
+	set->messages = malloc(server->delta_messages.bytecount + server->delta_count * (CHUNK_MESSAGE_HEADER_SIZE + MAX_ENCODED_CHUNK_SIZE));
+	set->count = server->delta_count;
+	memset(set->kinds, 0, sizeof(set->kinds));
+
+	int offset = 0;
+
+	for (int i = 0; i < server->delta_count; i++) {
+
+		memcpy(set->messages + offset, server->deltas[i].message, server->deltas[i].length);
+		set->lengths[i] = server->deltas[i].length;
+		unsigned char type = server->deltas[i].message[0];
+		set->kinds[type == SERVER_MESSAGE_BLOCK ? 0 : type == SERVER_MESSAGE_BLOCKS ? 1 : 2]++;
+
+		offset += server->deltas[i].length;
+	}
+}
+
+static int apply_delta_set(World *world, const DeltaSet *set) {
+
+	int applied = TRUE;
+	int offset = 0;
+
+	for (int i = 0; i < set->count; i++) {
+		applied &= apply_server_delta(world, set->messages + offset, set->lengths[i]);
+		offset += set->lengths[i];
+	}
+
+	return applied;
+}
+
+// whether the client's copy of every chunk the explosion touched matches the server's
+static int does_world_match_server(const World *world, ServerWorld *server) {
+
+	for (int x = -1; x <= 0; x++)
+		for (int y = -1; y <= 0; y++)
+			for (int z = -1; z <= 0; z++) {
+
+				const Chunk *chunk = get_chunk(world, x, y, z);
+				unsigned char blocks[16][16][16];
+
+				unpack_chunk_blocks(&chunk->blocks, blocks);
+
+				if (memcmp(blocks, find_server_chunk(server, x, y, z)->blocks, sizeof(blocks)))
+					return FALSE;
+			}
+
+	return TRUE;
+}
+
+// blowing a sphere out of the server's terrain (and filling it back in) across a chunk corner, on a client that has the
+// same chunks: block by block with set_block vs applying the deltas the server's collect_block_deltas made for it, which
+// are first checked to leave the client matching the server (a mismatch goes to stderr and fails the run); ops are
+// explosions, and the kinds of message the server picked go to stderr
+static void bench_block_changes() {
+
+	ServerWorld server;
+	initialize_server_world(&server, 1);
+
+	World world;
+	initialize_world(&world, 2, 2);
+
+	for (int x = -2; x <= 1; x++)
+		for (int y = -2; y <= 1; y++)
+			for (int z = -2; z <= 1; z++) {
+
+				ServerChunk *chunk = get_server_chunk(&server, x, y, z);
+
+				// (the server's generator works in the background)
+				while (!generate_server_chunk(&server, chunk)) {
+					usleep(100);
+				}
+
+				ChunkBlocks blocks = {0};
+				pack_chunk_blocks(&blocks, chunk->blocks);
+				load_chunk(&world, x, y, z, &blocks);
+			}
+
+	DeltaSet deltas[2]; // blowing it out, filling it back in
+	collect_explosion_deltas(&server, BLOCK_AIR, &deltas[0]);
+
+	int round_trip = apply_delta_set(&world, &deltas[0]) && does_world_match_server(&world, &server);
+
+	collect_explosion_deltas(&server, BLOCK_STONE, &deltas[1]);
+
+	round_trip &= apply_delta_set(&world, &deltas[1]) && does_world_match_server(&world, &server);
+
+	if (!round_trip) {
+		fprintf(stderr, "block_changes: the client doesn't match the server after applying its deltas\n");
+		exit(1);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		fprintf(stderr, "%s: %d chunks changed, sent as %d block, %d blocks and %d chunk messages\n", i ? "fill" : "explosion", deltas[i].count,
+			deltas[i].kinds[0], deltas[i].kinds[1], deltas[i].kinds[2]);
+	}
+
+	for (int batched = FALSE; batched <= TRUE; batched++) {
+
+		long ops = 0;
+		double start = get_seconds();
+		double elapsed;
+
+		do {
+
+			if (batched) {
+
+				apply_delta_set(&world, &deltas[ops & 1]);
+
+			} else {
+
+				unsigned char block = ops & 1 ? BLOCK_STONE : BLOCK_AIR;
+
+				for (int x = -EXPLOSION_RADIUS; x < EXPLOSION_RADIUS; x++)
+					for (int y = -EXPLOSION_RADIUS; y < EXPLOSION_RADIUS; y++)
+						for (int z = -EXPLOSION_RADIUS; z < EXPLOSION_RADIUS; z++)
+							if (x * x + y * y + z * z <= EXPLOSION_RADIUS * EXPLOSION_RADIUS)
+								set_block(&world, x, y, z, block);
+			}
+
+			// (what process_tick would hand to the mesher, the same chunks either way since the dirty list dedups them)
+			while (pop_dirty_chunk(&world));
+
+			ops++;
+			elapsed = get_seconds() - start;
+
+		} while (elapsed < BENCH_SECONDS);
+
+		print_result("block_changes", batched ? "explosion_deltas" : "explosion_set_block", ops, elapsed, -1);
+	}
+
+	free(deltas[0].messages);
+	free(deltas[1].messages);
+	free_world(&world);
+	free_server_world(&server);
+}
+
+static long region_file_bytes;
+
+static void measure_region_file(const char *path) {
+
+	struct stat status;
+
+	if (stat(path, &status) == 0)
+		region_file_bytes += status.st_size;
+}
+
+// drops the file from the page cache (only the pages already written back, which after a flush is all of them)
+static void evict_region_file(const char *path) {
+
+	int descriptor = open(path, O_RDONLY);
+
+	if (descriptor != -1) {
+		posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+		close(descriptor);
+	}
+}
+
+static void remove_region_file(const char *path) {
+
+	unlink(path);
+}
+
+static void visit_region_files(const char *directory, void (*visit)(const char *path)) {
+
+	DIR *dir = opendir(directory);
+	struct dirent *entry;
+
+	while (dir && (entry = readdir(dir))) {
+
+		if (entry->d_name[0] == '.')
+			continue;
+
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+		visit(path);
+	}
+
+	if (dir)
+		closedir(dir);
+}
+
+// saving generated terrain to region files (in a scratch directory next to wherever this runs, so on the same disk) and
+// loading it back, with the files in the page cache and evicted from it; saves count once they're flushed to disk, and
+// cold loads include reopening the files (bytes on disk and fsyncs per batch go to stderr, keeping stdout plain CSV)
+static void bench_region() {
+
+	World world;
+	load_generated_world(&world);
+
+	unsigned char (*blocks)[16][16][16] = malloc(sizeof(unsigned char[16][16][16]) * world.loaded_count);
+
+	for (int i = 0; i < world.loaded_count; i++) {
+		unpack_chunk_blocks(&world.loaded[i]->blocks, blocks[i]);
+	}
+
+	char directory[] = "bench_regions_XXXXXX";
+	RegionStore store;
+
+	if (!mkdtemp(directory) || !initialize_region_store(&store, directory)) {
+
+		fprintf(stderr, "Could not make a directory for the region benchmark\n");
+		free(blocks);
+		free_world(&world);
+
+		return;
+	}
+
+	long ops = 0;
+	double start = get_seconds();
+	double elapsed;
+
+	do {
+
+		for (int i = 0; i < world.loaded_count; i++) {
+			save_region_chunk(&store, world.loaded[i]->x, world.loaded[i]->y, world.loaded[i]->z, blocks[i]);
+		}
+
+		flush_region_store(&store);
+
+		ops += world.loaded_count;
+		elapsed = get_seconds() - start;
+
+	} while (elapsed < BENCH_SECONDS);
+
+	print_result("region", "generated_save", ops, elapsed, -1);
+
+	region_file_bytes = 0;
+	visit_region_files(directory, measure_region_file);
+
+	fprintf(stderr, "region: %.0f bytes on disk per chunk, %.1f files synced per batch of %d chunks\n", (double) region_file_bytes / world.loaded_count,
+		(double) store.files_synced / store.batches_written, world.loaded_count);
+
+	unsigned char loaded[16][16][16];
+	ops = 0;
+	start = get_seconds();
+
+	do {
+
+		for (int i = 0; i < world.loaded_count; i++) {
+			bench_sink = load_region_chunk(&store, world.loaded[i]->x, world.loaded[i]->y, world.loaded[i]->z, loaded);
+		}
+
+		ops += world.loaded_count;
+		elapsed = get_seconds() - start;
+
+	} while (elapsed < BENCH_SECONDS);
+
+	print_result("region", "generated_load_warm", ops, elapsed, -1);
+
+	// one pass per eviction, since a pass warms the cache back up
+	ops = 0;
+	elapsed = 0;
+
+	do {
+
+		free_region_store(&store);
+		visit_region_files(directory, evict_region_file);
+		initialize_region_store(&store, directory);
+
+		start = get_seconds();
+
+		for (int i = 0; i < world.loaded_count; i++) {
+			bench_sink = load_region_chunk(&store, world.loaded[i]->x, world.loaded[i]->y, world.loaded[i]->z, loaded);
+		}
+
+		ops += world.loaded_count;
+		elapsed += get_seconds() - start;
+
+	} while (elapsed < BENCH_SECONDS);
+
+	print_result("region", "generated_load_cold", ops, elapsed, -1);
+
+	free_region_store(&store);
+	visit_region_files(directory, remove_region_file);
+	rmdir(directory);
+
+	free(blocks);
+	free_world(&world);
+}
+
+#define COLLISION_POINTS 4096
+
+// random player-sized boxes within the loaded area
+static void bench_collision() {
+
+	for (int w = 0; w < BENCH_WORLD_COUNT; w++) {
+
+		World world;
+		load_bench_world(&world, &bench_worlds[w]);
+
+		// precomputed so the benchmark measures the queries, not the random numbers
+		static float points[COLLISION_POINTS][3];
+
+		rng_state = 1;
+
+		for (int i = 0; i < COLLISION_POINTS; i++) {
+			points[i][0] = random_uint(64000) * 0.001 - 32;
+			points[i][1] = random_uint(48000) * 0.001 - 16;
+			points[i][2] = random_uint(64000) * 0.001 - 32;
+		}
+
+		long ops = 0;
+		int hits = 0;
+
+		double start = get_seconds();
+		double elapsed;
+
+		do {
+
+			for (int i = 0; i < COLLISION_POINTS; i++) {
+				hits += is_aabb_cube_inside_block(&world, points[i][0], points[i][1], points[i][2], 0.2);
+			}
+
+			ops += COLLISION_POINTS;
+			elapsed = get_seconds() - start;
+
+		} while (elapsed < BENCH_SECONDS);
+
+		bench_sink = hits;
+
+		print_result("is_aabb_cube_inside_block", bench_worlds[w].name, ops, elapsed, -1);
+
+		free_world(&world);
+	}
+}
+
+// what tick_player used to do: take the whole step along an axis, then back off in tenths while stuck in a block
+static void move_box_backoff(const World *world, float position[3], const float motion[3], float size) {
+
+	for (int axis = 0; axis < 3; axis++) {
+
+		position[axis] += motion[axis];
+
+		for (int i = 0; i < 10 && is_aabb_cube_inside_block(world, position[0], position[1], -position[2], size); i++) {
+			position[axis] -= motion[axis] * 0.1;
+		}
+	}
+}
+
+// one tick's worth of movement for lots of player-sized boxes, the old way and with move_aabb (one at a time and batched)
+static void bench_move_box() {
+
+	static const char *methods[] = {"backoff", "swept", "swept_batch"};
+
+	static float starts[COLLISION_POINTS][3];
+	static float motions[COLLISION_POINTS][3];
+	static AABB boxes[COLLISION_POINTS];
+	static float motion_copies[COLLISION_POINTS][3];
+
+	for (int w = 0; w < BENCH_WORLD_COUNT; w++) {
+
+		World world;
+		load_bench_world(&world, &bench_worlds[w]);
+
+		rng_state = 1;
+
+		for (int i = 0; i < COLLISION_POINTS; i++) {
+
+			starts[i][0] = random_uint(64000) * 0.001 - 32;
+			starts[i][1] = random_uint(48000) * 0.001 - 16;
+			starts[i][2] = random_uint(64000) * 0.001 - 32;
+
+			float angle = random_uint(6283) * 0.001;
+
+			motions[i][0] = cos(angle) * 0.1;
+			motions[i][1] = random_uint(3) * 0.1 - 0.1;
+			motions[i][2] = sin(angle) * 0.1;
+		}
+
+		for (int m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+
+			long ops = 0;
+			float total = 0;
+
+			double start = get_seconds();
+			double elapsed;
+
+			do {
+
+				// every round starts from the same boxes, so all methods do the same work
+				for (int i = 0; i < COLLISION_POINTS; i++) {
+
+					for (int axis = 0; axis < 3; axis++) {
+						boxes[i].min[axis] = starts[i][axis] - PLAYER_SIZE;
+						boxes[i].max[axis] = starts[i][axis] + PLAYER_SIZE;
+					}
+
+					memcpy(motion_copies[i], motions[i], sizeof(motions[i]));
+				}
+
+				if (m == 0) {
+
+					for (int i = 0; i < COLLISION_POINTS; i++) {
+
+						float position[3] = {starts[i][0], starts[i][1], starts[i][2]};
+						move_box_backoff(&world, position, motions[i], PLAYER_SIZE);
+						total += position[0];
+					}
+
+				} else if (m == 1) {
+
+					for (int i = 0; i < COLLISION_POINTS; i++) {
+						move_aabb(&world, &boxes[i], motion_copies[i]);
+						total += boxes[i].min[0];
+					}
+
+				} else {
+
+					move_aabbs(&world, boxes, motion_copies, NULL, COLLISION_POINTS);
+					total += boxes[0].min[0];
+				}
+
+				ops += COLLISION_POINTS;
+				elapsed = get_seconds() - start;
+
+			} while (elapsed < BENCH_SECONDS);
+
+			bench_sink = total;
+
+			char bench_case[64];
+			snprintf(bench_case, sizeof(bench_case), "%s_%s", bench_worlds[w].name, methods[m]);
+
+			print_result("move_box", bench_case, ops, elapsed, -1);
+		}
+
+		free_world(&world);
+	}
+}
+
+#define RAYCAST_RAYS 4096
+
+// rays in random directions from random points, single and batched, at picking range and at line of sight range
+static void bench_raycast() {
+
+	static float origins[RAYCAST_RAYS][3];
+	static float directions[RAYCAST_RAYS][3];
+	static RaycastHit hits[RAYCAST_RAYS];
+	static int found[RAYCAST_RAYS];
+
+	static const struct { const char *name; float distance; int batched; } cases[] = {
+		{"6_blocks", 6, FALSE},
+		{"32_blocks", 32, FALSE},
+		{"32_blocks_batch", 32, TRUE},
+	};
+
+	for (int w = 0; w < BENCH_WORLD_COUNT; w++) {
+
+		World world;
+		load_bench_world(&world, &bench_worlds[w]);
+
+		rng_state = 1;
+
+		for (int i = 0; i < RAYCAST_RAYS; i++) {
+
+			origins[i][0] = random_uint(64000) * 0.001 - 32;
+			origins[i][1] = random_uint(48000) * 0.001 - 16;
+			origins[i][2] = random_uint(64000) * 0.001 - 32;
+
+			float yaw = random_uint(6283) * 0.001;
+			float pitch = random_uint(3141) * 0.001 - 1.5708;
+
+			directions[i][0] = sin(yaw) * cos(pitch);
+			directions[i][1] = sin(pitch);
+			directions[i][2] = cos(yaw) * cos(pitch);
+		}
+
+		for (int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+
+			long ops = 0;
+			int hit_count = 0;
+
+			double start = get_seconds();
+			double elapsed;
+
+			do {
+
+				if (cases[c].batched) {
+
+					raycast_blocks_batch(&world, (const float (*)[3]) origins, (const float (*)[3]) directions, cases[c].distance, hits, found, RAYCAST_RAYS);
+
+					for (int i = 0; i < RAYCAST_RAYS; i++) {
+						hit_count += found[i];
+					}
+
+				} else {
+
+					for (int i = 0; i < RAYCAST_RAYS; i++) {
+						hit_count += raycast_blocks(&world, origins[i], directions[i], cases[c].distance, &hits[i]);
+					}
+				}
+
+				ops += RAYCAST_RAYS;
+				elapsed = get_seconds() - start;
+
+			} while (elapsed < BENCH_SECONDS);
+
+			bench_sink = hit_count;
+
+			char bench_case[64];
+			snprintf(bench_case, sizeof(bench_case), "%s_%s", bench_worlds[w].name, cases[c].name);
+
+			print_result("raycast_blocks", bench_case, ops, elapsed, -1);
+		}
+
+		free_world(&world);
+	}
+}
+
+static void bench_mat4_mult() {
+
+	float a[4][4], b[4][4];
+
+	generate_rotation_matrices(a, 0.3, b, 1.2);
+
+	long ops = 0;
+
+	double start = get_seconds();
+	double elapsed;
+
+	do {
+
+		for (int i = 0; i < 4096; i++) {
+			mat4_mult(b, a, a); // chained, so each multiply depends on the last
+		}
+
+		ops += 4096;
+		elapsed = get_seconds() - start;
+
+	} while (elapsed < BENCH_SECONDS);
+
+	bench_sink = a[1][2];
+
+	print_result("mat4_mult", "chained", ops, elapsed, -1);
+}
+
+static void bench_obj_parse() {
+
+	const char *path = "client/res/miku.obj";
+
+	long ops = 0;
+	long vertices = 0;
+
+	double start = get_seconds();
+	double elapsed;
+
+	do {
+
+		ObjMesh mesh;
+
+		if (!parse_obj(path, &mesh)) {
+			fprintf(stderr, "could not open %s (run from the repository root)\n", path);
+			return;
+		}
+
+		vertices += mesh.index_count; // vertices as drawn, so runs stay comparable however well they dedup
+
+		free_obj_mesh(&mesh);
+
+		ops++;
+		elapsed = get_seconds() - start;
+
+	} while (elapsed < BENCH_SECONDS);
+
+	print_result("parse_obj", "miku", ops, elapsed, vertices);
+}
+
+int main() {
+
+	printf("benchmark,case,ops_per_sec,ns_per_op,vertices_per_sec\n");
+
+	bench_noise();
+	bench_worldgen();
+	bench_mesher();
+	bench_chunk_blocks();
+	bench_chunk_format();
+	bench_block_changes();
+	bench_region();
+	bench_collision();
+	bench_move_box();
+	bench_raycast();
+	bench_mat4_mult();
+	bench_obj_parse();
+
+	return 0;
+}
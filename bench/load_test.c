@@ -0,0 +1,374 @@
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "../server/src/net.c"
+#include "../chunk_format.c"
+
+// loopback load test for server_app (make load_test starts one and points this at it)
+// holds thousands of connections that never say anything, hundreds of players that move every tick (a crowd of them at
+// spawn, one of which also changes a few hundred blocks at once every second, and the rest spread out on a grid around it,
+// walking out to their places first since the server only lets a player move so far a tick), and a few that join at spawn
+// but never read,
+// then reports whether the idle connections survived, how steadily the players got their ticks, whether the chunks they
+// were sent decode, how the block changes arrived, and whether the slow players got dropped (the server reports its own
+// tick times), exiting with 1 if any connection was lost, or kept, that shouldn't have been
+
+#define LOAD_IDLE_CONNECTIONS 5000
+#define LOAD_PLAYERS 300
+#define LOAD_SLOW_PLAYERS 4
+#define LOAD_CROWD_PLAYERS 100 // of the players, standing around spawn (the middle of the grid) instead of on the grid
+#define LOAD_PLAYER_SPACING 64 // blocks between players on the grid (a player cell), so each only sees the few around it
+#define LOAD_SECONDS 12
+
+#define LOAD_MOVES_PER_SECOND 20
+#define LOAD_BLOCK_CHANGES 200 // changed at once, every second, in one chunk
+#define LOAD_READ_BUFFER_SIZE 65536 // must fit a whole tick's worth of player updates
+
+typedef struct {
+
+	int socket;
+	RingBuffer incoming;
+
+	int welcomed;
+	double last_tick_time;
+	double worst_tick_gap;
+	long ticks;
+	int chunks;
+	int block_messages;
+	int block_changes;
+	int block_chunk_resends; // of the chunk the block changes are in (which the server resends whole when that's smaller)
+	int has_block_chunk;
+
+	float x, y, z;
+
+} LoadPlayer;
+
+static double get_seconds() {
+
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// where the index'th row or column of a grid size long goes, in spacings from the middle (index 0 at 0)
+static int get_grid_offset(int index, int size) {
+
+	return (index + size / 2) % size - size / 2;
+}
+
+// returns -1 on error
+static int connect_to_server(int port, int receive_buffer_size) {
+
+	int socket_descriptor = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (socket_descriptor == -1)
+		return -1;
+
+	if (receive_buffer_size)
+		setsockopt(socket_descriptor, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size));
+
+	struct sockaddr_in address = {0};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	if (connect(socket_descriptor, (struct sockaddr *) &address, sizeof(address)) == -1) {
+		close(socket_descriptor);
+		return -1;
+	}
+
+	int no_delay = 1;
+	setsockopt(socket_descriptor, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+	return socket_descriptor;
+}
+
+// the sockets are blocking and the messages tiny, so this always sends the whole thing
+static int send_message(int socket_descriptor, const unsigned char *message, uint32_t length) {
+
+	unsigned char framed[MESSAGE_HEADER_SIZE + 32];
+	put_message_uint(framed, length);
+	memcpy(framed + MESSAGE_HEADER_SIZE, message, length);
+
+	return send(socket_descriptor, framed, MESSAGE_HEADER_SIZE + length, MSG_NOSIGNAL) == MESSAGE_HEADER_SIZE + length;
+}
+
+// returns FALSE if the server closed the connection (reads everything that's there to find out)
+static int is_connection_open(int socket_descriptor) {
+
+	unsigned char buffer[65536];
+
+	while (TRUE) {
+
+		ssize_t received = recv(socket_descriptor, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+		if (received == 0 || (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+			return FALSE;
+
+		if (received == -1)
+			return TRUE;
+	}
+}
+
+int main(int argc, char **argv) {
+
+	int port = argc > 1 ? atoi(argv[1]) : 25565;
+
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	static int idle[LOAD_IDLE_CONNECTIONS];
+	static LoadPlayer players[LOAD_PLAYERS];
+	int slow[LOAD_SLOW_PLAYERS];
+
+	double start = get_seconds();
+
+	for (int i = 0; i < LOAD_IDLE_CONNECTIONS; i++) {
+
+		if ((idle[i] = connect_to_server(port, 0)) == -1) {
+			fprintf(stderr, "Could not open idle connection %d (is server_app running on port %d?)\n", i, port);
+			return 1;
+		}
+	}
+
+	printf("opened %d idle connections in %.2f seconds\n", LOAD_IDLE_CONNECTIONS, get_seconds() - start);
+
+	const unsigned char join[1] = { CLIENT_MESSAGE_JOIN };
+
+	// slow players: tiny receive buffers, and they never read, so they fall behind as fast as possible (staying at spawn,
+	// in the crowd there at the start and in the block changes)
+	for (int i = 0; i < LOAD_SLOW_PLAYERS; i++) {
+
+		if ((slow[i] = connect_to_server(port, 4096)) == -1 || !send_message(slow[i], join, 1)) {
+			fprintf(stderr, "Could not open slow player %d\n", i);
+			return 1;
+		}
+	}
+
+	int epoll = epoll_create1(0);
+	int grid_count = LOAD_PLAYERS - LOAD_CROWD_PLAYERS + 1; // (the crowd's in the middle one)
+	int grid_width = (int) ceil(sqrt(grid_count));
+	int grid_height = (grid_count + grid_width - 1) / grid_width;
+
+	for (int i = 0; i < LOAD_PLAYERS; i++) {
+
+		LoadPlayer *player = &players[i];
+
+		if ((player->socket = connect_to_server(port, 0)) == -1 || !send_message(player->socket, join, 1)) {
+			fprintf(stderr, "Could not open player %d\n", i);
+			return 1;
+		}
+
+		initialize_ring_buffer(&player->incoming, LOAD_READ_BUFFER_SIZE);
+		player->y = 22;
+
+		if (i < LOAD_CROWD_PLAYERS) {
+
+			player->x = i % 10 * 1.5f;
+			player->z = i / 10 * 1.5f;
+
+		} else {
+
+			int spot = i - LOAD_CROWD_PLAYERS + 1;
+
+			player->x = get_grid_offset(spot % grid_width, grid_width) * LOAD_PLAYER_SPACING;
+			player->z = get_grid_offset(spot / grid_width, grid_height) * LOAD_PLAYER_SPACING;
+		}
+
+		struct epoll_event event = { .events = EPOLLIN, .data.ptr = player };
+		epoll_ctl(epoll, EPOLL_CTL_ADD, player->socket, &event);
+	}
+
+	static unsigned char scratch[LOAD_READ_BUFFER_SIZE];
+
+	long updates = 0;
+	long bytes = 0;
+	long chunk_bytes = 0;
+	int bad_chunks = 0;
+	int players_lost = 0;
+
+	start = get_seconds();
+	double next_move = start;
+	int move_count = 0;
+
+	while (get_seconds() - start < LOAD_SECONDS) {
+
+		// every player moves a little
+		if (get_seconds() >= next_move) {
+
+			for (int i = 0; i < LOAD_PLAYERS; i++) {
+
+				unsigned char move[13] = { CLIENT_MESSAGE_MOVE };
+
+				players[i].z += 0.1f;
+				put_message_float(move + 1, players[i].x);
+				put_message_float(move + 5, players[i].y);
+				put_message_float(move + 9, players[i].z);
+
+				send_message(players[i].socket, move, sizeof(move));
+			}
+
+			// and the first one (at spawn) digs out (or fills back in) a patch of the chunk above it
+			if (move_count % LOAD_MOVES_PER_SECOND == 0) {
+
+				for (int i = 0; i < LOAD_BLOCK_CHANGES; i++) {
+
+					unsigned char set_block[14] = { CLIENT_MESSAGE_SET_BLOCK };
+
+					put_message_uint(set_block + 1, i % 10);
+					put_message_uint(set_block + 5, 16 + i / 100);
+					put_message_uint(set_block + 9, i / 10 % 10);
+					set_block[13] = move_count / LOAD_MOVES_PER_SECOND % 2 ? 3 : 0; // stone or air
+
+					send_message(players[0].socket, set_block, sizeof(set_block));
+				}
+			}
+
+			move_count++;
+			next_move += 1.0 / LOAD_MOVES_PER_SECOND;
+		}
+
+		double timeout = next_move - get_seconds();
+
+		struct epoll_event events[256];
+		int event_count = epoll_wait(epoll, events, 256, timeout > 0 ? (int) (timeout * 1000) + 1 : 0);
+
+		for (int e = 0; e < event_count; e++) {
+
+			LoadPlayer *player = events[e].data.ptr;
+			int received = receive_ring_buffer(&player->incoming, player->socket);
+
+			if (received == -1) {
+				players_lost++;
+				epoll_ctl(epoll, EPOLL_CTL_DEL, player->socket, NULL);
+				continue;
+			}
+
+			bytes += received;
+
+			const unsigned char *message;
+			int length;
+
+			while ((length = read_message(&player->incoming, LOAD_READ_BUFFER_SIZE - MESSAGE_HEADER_SIZE, scratch, &message)) > 0) {
+
+				if (message[0] == SERVER_MESSAGE_WELCOME) {
+
+					player->welcomed = TRUE;
+
+				} else if (message[0] == SERVER_MESSAGE_PLAYERS) {
+
+					double now = get_seconds();
+
+					// (ignoring the first second, while everyone's still joining)
+					if (player->ticks && now - start > 1 && now - player->last_tick_time > player->worst_tick_gap)
+						player->worst_tick_gap = now - player->last_tick_time;
+
+					player->last_tick_time = now;
+					player->ticks++;
+
+					updates += (length - 5) / PLAYER_UPDATE_SIZE;
+
+				} else if (message[0] == SERVER_MESSAGE_BLOCK) {
+
+					player->block_messages++;
+					player->block_changes++;
+
+				} else if (message[0] == SERVER_MESSAGE_BLOCKS) {
+
+					player->block_messages++;
+					player->block_changes += (length - 13) / BLOCK_CHANGE_SIZE;
+
+				} else if (message[0] == SERVER_MESSAGE_CHUNK) {
+
+					unsigned char blocks[16][16][16];
+
+					if (length > 13 && decode_chunk(message + 13, length - 13, blocks)) {
+
+						player->chunks++;
+						chunk_bytes += length;
+
+						if (get_message_uint(message + 1) == 0 && get_message_uint(message + 5) == 1 && get_message_uint(message + 9) == 0) {
+
+							if (player->has_block_chunk) {
+								player->block_messages++;
+								player->block_chunk_resends++;
+							}
+
+							player->has_block_chunk = TRUE;
+						}
+
+					} else {
+						bad_chunks++;
+					}
+				}
+
+				consume_message(&player->incoming, length);
+			}
+		}
+	}
+
+	double elapsed = get_seconds() - start;
+
+	int idle_lost = 0;
+	int slow_dropped = 0;
+	int welcomed = 0;
+	long ticks = 0;
+	long chunks = 0;
+	long block_messages = 0;
+	long block_changes = 0;
+	long block_chunk_resends = 0;
+	int block_receivers = 0;
+	double worst_tick_gap = 0;
+
+	for (int i = 0; i < LOAD_IDLE_CONNECTIONS; i++) {
+		idle_lost += !is_connection_open(idle[i]);
+	}
+
+	for (int i = 0; i < LOAD_SLOW_PLAYERS; i++) {
+		slow_dropped += !is_connection_open(slow[i]);
+	}
+
+	for (int i = 0; i < LOAD_PLAYERS; i++) {
+
+		welcomed += players[i].welcomed;
+		ticks += players[i].ticks;
+		chunks += players[i].chunks;
+		block_messages += players[i].block_messages;
+		block_changes += players[i].block_changes;
+		block_chunk_resends += players[i].block_chunk_resends;
+		block_receivers += players[i].block_messages > 0;
+		worst_tick_gap = players[i].worst_tick_gap > worst_tick_gap ? players[i].worst_tick_gap : worst_tick_gap;
+	}
+
+	printf("idle connections: %d held, %d lost\n", LOAD_IDLE_CONNECTIONS - idle_lost, idle_lost);
+	printf("players: %d welcomed, %d lost, %.2f ticks per second each, %.1f ms worst gap between ticks\n", welcomed, players_lost,
+		ticks / elapsed / LOAD_PLAYERS, worst_tick_gap * 1000);
+	printf("player updates: %.0f per second received (%.0f per player), %.2f MB/s\n", updates / elapsed, updates / elapsed / LOAD_PLAYERS,
+		bytes / elapsed / 1e6);
+	printf("chunks: %.1f per player, %.0f bytes each on average, %d failed to decode\n", (double) chunks / LOAD_PLAYERS,
+		chunks ? (double) chunk_bytes / chunks : 0, bad_chunks);
+	printf("block changes: %d bursts of %d sent, received by the %d players near them, as %.1f messages each (%.1f of them the whole chunk, "
+		"the rest carrying %.0f changes)\n", (move_count + LOAD_MOVES_PER_SECOND - 1) / LOAD_MOVES_PER_SECOND, LOAD_BLOCK_CHANGES, block_receivers,
+		block_receivers ? (double) block_messages / block_receivers : 0, block_receivers ? (double) block_chunk_resends / block_receivers : 0,
+		block_receivers ? (double) block_changes / block_receivers : 0);
+	printf("slow players: %d of %d dropped for falling behind\n", slow_dropped, LOAD_SLOW_PLAYERS);
+
+	if (idle_lost || players_lost || bad_chunks || slow_dropped < LOAD_SLOW_PLAYERS) {
+		fprintf(stderr, "Load test failed\n");
+		return 1;
+	}
+
+	return 0;
+}
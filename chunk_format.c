@@ -0,0 +1,470 @@
+#ifndef CHUNK_FORMAT_DEFINED
+
+#define CHUNK_FORMAT_DEFINED
+
+#include <stdint.h>
+#include <string.h>
+#include "util.c"
+
+// the binary form of a chunk's 16x16x16 blocks, as it goes over the network (shared by the client and the server, like
+// util.c), versus 4KB for the blocks as they are:
+//
+//     byte 0   CHUNK_FORMAT_VERSION
+//     byte 1   flags (CHUNK_FORMAT_RAW or CHUNK_FORMAT_LZ, or neither)
+//     if LZ    uint16 little endian length of the body before compression, then the compressed body
+//     body     palette size - 1, the palette (block types), then runs of (palette index, run length - 1 as a varint)
+//              over the blocks in y, x, z order (horizontal layers, which are mostly one block type in terrain)
+//     if RAW   the body is just the 4096 blocks, x, y, z order, for chunks whose runs wouldn't be any smaller
+//
+// encoding and decoding work straight out of and into the caller's buffers, with nothing allocated
+
+#define CHUNK_FORMAT_VERSION 1
+
+#define CHUNK_FORMAT_RAW 1
+#define CHUNK_FORMAT_LZ 2
+
+#define MAX_ENCODED_CHUNK_SIZE (2 + 4096) // the most encode_chunk ever writes
+
+// LZ77 with a byte oriented format (in the style of LZ4), so it's simple and fast to decode:
+// each sequence is a token (literal count in the high nibble, match length - 4 in the low nibble, 15 meaning more length
+// bytes follow, each added on until one isn't 255), the literals, then a uint16 little endian match offset and any more
+// match length bytes, except the last sequence, which is literals only
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+
+static inline unsigned int hash_lz_bytes(const unsigned char *bytes) {
+
+	uint32_t word;
+	memcpy(&word, bytes, 4);
+
+	return word * 2654435761u >> (32 - LZ_HASH_BITS);
+}
+
+// writes a length's extra bytes, returns FALSE if they don't fit
+static int write_lz_length(unsigned char **out, const unsigned char *end, int length) {
+
+	for (; length >= 255; length -= 255) {
+
+		if (*out == end)
+			return FALSE;
+
+		*(*out)++ = 255;
+	}
+
+	if (*out == end)
+		return FALSE;
+
+	*(*out)++ = length;
+
+	return TRUE;
+}
+
+static int write_lz_sequence(unsigned char **out, const unsigned char *end, const unsigned char *literals, int literal_count, int offset, int match_length) {
+
+	if (*out == end)
+		return FALSE;
+
+	unsigned char *token = (*out)++;
+	*token = (literal_count < 15 ? literal_count : 15) << 4;
+
+	if (literal_count >= 15 && !write_lz_length(out, end, literal_count - 15))
+		return FALSE;
+
+	if (end - *out < literal_count)
+		return FALSE;
+
+	memcpy(*out, literals, literal_count);
+	*out += literal_count;
+
+	if (match_length == 0)
+		return TRUE;
+
+	if (end - *out < 2)
+		return FALSE;
+
+	*(*out)++ = offset;
+	*(*out)++ = offset >> 8;
+
+	match_length -= LZ_MIN_MATCH;
+	*token |= match_length < 15 ? match_length : 15;
+
+	return match_length < 15 || write_lz_length(out, end, match_length - 15);
+}
+
+// returns the compressed length, or 0 if it doesn't fit in capacity (source_length must be under 64KB)
+int compress_lz(const unsigned char *source, int source_length, unsigned char *destination, int capacity) {
+
+	uint16_t table[1 << LZ_HASH_BITS] = {0}; // positions + 1, 0 being empty
+
+	unsigned char *out = destination;
+	const unsigned char *end = destination + capacity;
+
+	int anchor = 0; // start of the literals not yet written
+	int i = 0;
+
+	while (i + LZ_MIN_MATCH <= source_length) {
+
+		unsigned int hash = hash_lz_bytes(source + i);
+		int candidate = table[hash] - 1;
+		table[hash] = i + 1;
+
+		if (candidate < 0 || memcmp(source + candidate, source + i, LZ_MIN_MATCH)) {
+			i++;
+			continue;
+		}
+
+		int length = LZ_MIN_MATCH;
+
+		while (i + length < source_length && source[candidate + length] == source[i + length])
+			length++;
+
+		if (!write_lz_sequence(&out, end, source + anchor, i - anchor, i - candidate, length))
+			return 0;
+
+		i += length;
+		anchor = i;
+	}
+
+	if (!write_lz_sequence(&out, end, source + anchor, source_length - anchor, 0, 0))
+		return 0;
+
+	return out - destination;
+}
+
+// reads a length's extra bytes, returns -1 if the input runs out
+static int read_lz_length(const unsigned char **in, const unsigned char *end) {
+
+	int length = 0;
+
+	do {
+
+		if (*in == end)
+			return -1;
+
+		length += **in;
+
+	} while (*(*in)++ == 255);
+
+	return length;
+}
+
+// returns the decompressed length, or -1 if the input is malformed or would decompress past capacity
+int decompress_lz(const unsigned char *source, int source_length, unsigned char *destination, int capacity) {
+
+	const unsigned char *in = source;
+	const unsigned char *in_end = source + source_length;
+	unsigned char *out = destination;
+	unsigned char *out_end = destination + capacity;
+
+	while (in < in_end) {
+
+		int token = *in++;
+		int literal_count = token >> 4;
+
+		if (literal_count == 15) {
+
+			int more = read_lz_length(&in, in_end);
+
+			if (more == -1)
+				return -1;
+
+			literal_count += more;
+		}
+
+		if (in_end - in < literal_count || out_end - out < literal_count)
+			return -1;
+
+		memcpy(out, in, literal_count);
+		in += literal_count;
+		out += literal_count;
+
+		if (in == in_end)
+			break; // the last sequence
+
+		if (in_end - in < 2)
+			return -1;
+
+		int offset = in[0] | in[1] << 8;
+		in += 2;
+
+		int match_length = token & 15;
+
+		if (match_length == 15) {
+
+			int more = read_lz_length(&in, in_end);
+
+			if (more == -1)
+				return -1;
+
+			match_length += more;
+		}
+
+		match_length += LZ_MIN_MATCH;
+
+		if (offset == 0 || offset > out - destination || out_end - out < match_length)
+			return -1;
+
+		// byte by byte, since a match can overlap what it's copying (that's how runs get encoded)
+		for (int i = 0; i < match_length; i++, out++)
+			*out = out[-offset];
+	}
+
+	return out - destination;
+}
+
+typedef struct {
+
+	short indices[256]; // by block type, -1 if it's not in the palette yet
+	unsigned char blocks[256];
+	int size;
+
+} ChunkPalette;
+
+// appends one run (adding its block type to the palette if it's new), returns FALSE if it doesn't fit
+static int write_chunk_run(unsigned char **out, const unsigned char *end, ChunkPalette *palette, unsigned char block, int length) {
+
+	if (end - *out < 3)
+		return FALSE;
+
+	if (palette->indices[block] == -1) {
+		palette->indices[block] = palette->size;
+		palette->blocks[palette->size++] = block;
+	}
+
+	*(*out)++ = palette->indices[block];
+
+	// run length - 1 as a varint, 7 bits at a time, low bits first
+	unsigned int value = length - 1;
+
+	for (; value >= 128; value >>= 7)
+		*(*out)++ = (value & 127) | 128;
+
+	*(*out)++ = value;
+
+	return TRUE;
+}
+
+// writes the palette and runs, returns their length, or 0 if that would be more than capacity
+static int write_chunk_runs(const unsigned char blocks[16][16][16], unsigned char *destination, int capacity) {
+
+	ChunkPalette palette = { .size = 0 };
+	memset(palette.indices, -1, sizeof(palette.indices));
+
+	// the runs go after room for the biggest possible palette, and move down once the palette's known
+	unsigned char *runs = destination + 1 + 256;
+	unsigned char *out = runs;
+	const unsigned char *end = destination + capacity;
+
+	if (end <= runs)
+		return 0;
+
+	unsigned char run_block = blocks[0][0][0];
+	unsigned char run_row[16]; // a row that's all run_block
+	int run_length = 0;
+
+	memset(run_row, run_block, 16);
+
+	// rows of 16 blocks along z, in y, x order, skipping over whole rows that continue the current run
+	for (int y = 0; y < 16; y++)
+		for (int x = 0; x < 16; x++) {
+
+			const unsigned char *row = blocks[x][y];
+
+			if (!memcmp(row, run_row, 16)) {
+				run_length += 16;
+				continue;
+			}
+
+			for (int z = 0; z < 16; z++) {
+
+				if (row[z] == run_block) {
+					run_length++;
+					continue;
+				}
+
+				if (!write_chunk_run(&out, end, &palette, run_block, run_length))
+					return 0;
+
+				run_block = row[z];
+				run_length = 1;
+				memset(run_row, run_block, 16);
+			}
+		}
+
+	if (!write_chunk_run(&out, end, &palette, run_block, run_length))
+		return 0;
+
+	destination[0] = palette.size - 1;
+	memcpy(destination + 1, palette.blocks, palette.size);
+	memmove(destination + 1 + palette.size, runs, out - runs);
+
+	return 1 + palette.size + (out - runs);
+}
+
+// returns FALSE if the runs are malformed or don't cover exactly 4096 blocks
+static int read_chunk_runs(const unsigned char *source, int length, unsigned char blocks[16][16][16]) {
+
+	const unsigned char *in = source;
+	const unsigned char *end = source + length;
+
+	if (in == end)
+		return FALSE;
+
+	int palette_size = *in++ + 1;
+
+	if (end - in < palette_size)
+		return FALSE;
+
+	const unsigned char *palette = in;
+	in += palette_size;
+
+	int block = 0; // in y, x, z order
+
+	while (in < end) {
+
+		int index = *in++;
+
+		unsigned int run_length = 0;
+		int shift = 0;
+
+		do {
+
+			if (in == end || shift > 14)
+				return FALSE;
+
+			run_length |= (*in & 127) << shift;
+			shift += 7;
+
+		} while (*in++ & 128);
+
+		run_length++;
+
+		if (index >= palette_size || run_length > 4096 - block)
+			return FALSE;
+
+		// a row (16 blocks along z) at a time
+		while (run_length) {
+
+			int z = block & 15;
+			int count = 16 - z < run_length ? 16 - z : run_length;
+
+			memset(&blocks[block >> 4 & 15][block >> 8][z], palette[index], count);
+
+			block += count;
+			run_length -= count;
+		}
+	}
+
+	return block == 4096;
+}
+
+// encodes into destination (which needs MAX_ENCODED_CHUNK_SIZE bytes), LZ compressing the runs if compress is TRUE (and
+// it makes them smaller), returns the encoded length
+int encode_chunk(const unsigned char blocks[16][16][16], int compress, unsigned char *destination) {
+
+	destination[0] = CHUNK_FORMAT_VERSION;
+	destination[1] = 0;
+
+	unsigned char *body = destination + 2;
+	unsigned char runs[4096];
+
+	int length = write_chunk_runs(blocks, compress ? runs : body, 4096);
+
+	if (length == 0) {
+
+		destination[1] = CHUNK_FORMAT_RAW;
+		memcpy(body, &blocks[0][0][0], 4096);
+
+		return 2 + 4096;
+	}
+
+	if (!compress)
+		return 2 + length;
+
+	// has to beat the uncompressed runs, counting its 2 extra length bytes
+	int compressed_length = compress_lz(runs, length, body + 2, length - 2);
+
+	if (compressed_length == 0) {
+		memcpy(body, runs, length);
+		return 2 + length;
+	}
+
+	destination[1] = CHUNK_FORMAT_LZ;
+	body[0] = length;
+	body[1] = length >> 8;
+
+	return 4 + compressed_length;
+}
+
+// decodes straight into blocks, returns FALSE if the data is malformed or from a different version
+int decode_chunk(const unsigned char *source, int length, unsigned char blocks[16][16][16]) {
+
+	if (length < 2 || source[0] != CHUNK_FORMAT_VERSION)
+		return FALSE;
+
+	const unsigned char *body = source + 2;
+	int body_length = length - 2;
+
+	switch (source[1]) {
+
+		case 0:
+			return read_chunk_runs(body, body_length, blocks);
+
+		case CHUNK_FORMAT_RAW:
+
+			if (body_length != 4096)
+				return FALSE;
+
+			memcpy(&blocks[0][0][0], body, 4096);
+
+			return TRUE;
+
+		case CHUNK_FORMAT_LZ: {
+
+			if (body_length < 2)
+				return FALSE;
+
+			int runs_length = body[0] | body[1] << 8;
+
+			unsigned char runs[4096];
+
+			if (runs_length > 4096 || decompress_lz(body + 2, body_length - 2, runs, runs_length) != runs_length)
+				return FALSE;
+
+			return read_chunk_runs(runs, runs_length, blocks);
+		}
+
+		default:
+			return FALSE;
+	}
+}
+
+// a batch of block changes within one chunk goes over as BLOCK_CHANGE_SIZE bytes per change: the block's index in the
+// chunk (x * 256 + y * 16 + z) as a uint16 little endian, then its new block type
+
+#define BLOCK_CHANGE_SIZE 3
+
+static inline void put_block_change(unsigned char *data, int x, int y, int z, unsigned char block) {
+
+	int index = x << 8 | y << 4 | z;
+
+	data[0] = index;
+	data[1] = index >> 8;
+	data[2] = block;
+}
+
+// returns FALSE if the index is out of range
+static inline int get_block_change(const unsigned char *data, int *x, int *y, int *z, unsigned char *block) {
+
+	int index = data[0] | data[1] << 8;
+
+	*x = index >> 8;
+	*y = index >> 4 & 15;
+	*z = index & 15;
+	*block = data[2];
+
+	return index < 4096;
+}
+
+#endif
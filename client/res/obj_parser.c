@@ -0,0 +1,428 @@
+#ifndef OBJ_PARSER_DEFINED
+
+#define OBJ_PARSER_DEFINED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../../util.c"
+
+// OBJ importer: one pass over the memory-mapped file with a hand-rolled number parser, triangulating quads/ngons as
+// fans, and merging identical vertices so the mesh can be drawn indexed
+
+#define OBJ_VERTEX_FLOATS 8 // position (3), normal (3), UV (2)
+
+typedef struct {
+
+	float *vertices; // OBJ_VERTEX_FLOATS per vertex, each vertex unique
+	int vertex_count;
+
+	void *indices; // three per triangle, 16 bit if every vertex fits, otherwise 32 bit
+	int index_count;
+	int index_size; // 2 or 4 bytes
+
+} ObjMesh;
+
+// a growable array of fixed size elements (EZArray grows fine, but appending a float at a time through it is slow)
+typedef struct {
+
+	void *data;
+	int count;
+	int capacity;
+
+} ObjList;
+
+static void *push_obj_list(ObjList *list, int element_size) {
+
+	if (list->count == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 1024;
+		list->data = realloc(list->data, (size_t) list->capacity * element_size);
+	}
+
+	return (char *) list->data + (size_t) element_size * list->count++;
+}
+
+static int is_obj_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// parses a decimal float like "-0.113360" or "1.5e-3", leaves *cursor just past it
+static float parse_obj_float(const char **cursor, const char *end) {
+
+	static const double powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+	};
+
+	const char *c = *cursor;
+
+	while (c < end && is_obj_space(*c)) {
+		c++;
+	}
+
+	int negative = FALSE;
+
+	if (c < end && (*c == '-' || *c == '+')) {
+		negative = *c == '-';
+		c++;
+	}
+
+	// digits past the 18th only affect precision a float can't hold anyway
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+
+	for (; c < end && *c >= '0' && *c <= '9'; c++) {
+
+		if (digits < 18) {
+			mantissa = mantissa * 10 + (*c - '0');
+			digits += mantissa != 0;
+		} else {
+			exponent++;
+		}
+	}
+
+	if (c < end && *c == '.') {
+
+		for (c++; c < end && *c >= '0' && *c <= '9'; c++) {
+
+			if (digits < 18) {
+				mantissa = mantissa * 10 + (*c - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+
+	if (c < end && (*c == 'e' || *c == 'E')) {
+
+		c++;
+
+		int exponent_negative = FALSE;
+
+		if (c < end && (*c == '-' || *c == '+')) {
+			exponent_negative = *c == '-';
+			c++;
+		}
+
+		int written_exponent = 0;
+
+		for (; c < end && *c >= '0' && *c <= '9'; c++) {
+
+			if (written_exponent < 1000)
+				written_exponent = written_exponent * 10 + (*c - '0');
+		}
+
+		exponent += exponent_negative ? -written_exponent : written_exponent;
+	}
+
+	*cursor = c;
+
+	double value = mantissa;
+
+	while (exponent > 18) {
+		value *= 1e18;
+		exponent -= 18;
+	}
+
+	while (exponent < -18) {
+		value /= 1e18;
+		exponent += 18;
+	}
+
+	value = exponent >= 0 ? value * powers_of_ten[exponent] : value / powers_of_ten[-exponent];
+
+	return negative ? -value : value;
+}
+
+// parses a (possibly negative) integer, returns 0 if there's none
+static int parse_obj_int(const char **cursor, const char *end) {
+
+	const char *c = *cursor;
+	int negative = FALSE;
+
+	if (c < end && *c == '-') {
+		negative = TRUE;
+		c++;
+	}
+
+	int value = 0;
+
+	for (; c < end && *c >= '0' && *c <= '9'; c++) {
+		value = value * 10 + (*c - '0');
+	}
+
+	*cursor = c;
+
+	return negative ? -value : value;
+}
+
+// OBJ indices start at 1, and negative ones count back from the latest element; returns -1 if absent or out of range
+static int resolve_obj_index(int index, int count) {
+
+	if (index < 0)
+		index += count;
+	else
+		index -= 1;
+
+	return index >= 0 && index < count ? index : -1;
+}
+
+// open addressing table from vertex contents to the vertex's index, so identical vertices are only stored once
+typedef struct {
+
+	int *slots; // vertex index + 1, 0 for empty
+	int slot_mask;
+
+} ObjVertexTable;
+
+static uint32_t hash_obj_vertex(const float vertex[OBJ_VERTEX_FLOATS]) {
+
+	// FNV-1a over the bytes (-0 and 0 hash differently, which only means they don't merge)
+	const unsigned char *bytes = (const unsigned char *) vertex;
+	uint32_t hash = 2166136261u;
+
+	for (int i = 0; i < sizeof(float) * OBJ_VERTEX_FLOATS; i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static void grow_obj_vertex_table(ObjVertexTable *table, const ObjList *vertices) {
+
+	int slot_count = table->slots ? (table->slot_mask + 1) * 2 : 4096;
+
+	free(table->slots);
+	table->slots = calloc(slot_count, sizeof(int));
+	table->slot_mask = slot_count - 1;
+
+	for (int i = 0; i < vertices->count; i++) {
+
+		const float *vertex = (const float *) vertices->data + (size_t) i * OBJ_VERTEX_FLOATS;
+		uint32_t slot = hash_obj_vertex(vertex) & table->slot_mask;
+
+		while (table->slots[slot]) {
+			slot = (slot + 1) & table->slot_mask;
+		}
+
+		table->slots[slot] = i + 1;
+	}
+}
+
+// returns the index of the vertex, adding it if it's new
+static int add_obj_vertex(ObjVertexTable *table, ObjList *vertices, const float vertex[OBJ_VERTEX_FLOATS]) {
+
+	// keep the table at most half full
+	if (!table->slots || vertices->count * 2 >= table->slot_mask + 1)
+		grow_obj_vertex_table(table, vertices);
+
+	uint32_t slot = hash_obj_vertex(vertex) & table->slot_mask;
+
+	while (table->slots[slot]) {
+
+		int index = table->slots[slot] - 1;
+
+		if (!memcmp((const float *) vertices->data + (size_t) index * OBJ_VERTEX_FLOATS, vertex, sizeof(float) * OBJ_VERTEX_FLOATS))
+			return index;
+
+		slot = (slot + 1) & table->slot_mask;
+	}
+
+	int index = vertices->count;
+	memcpy(push_obj_list(vertices, sizeof(float) * OBJ_VERTEX_FLOATS), vertex, sizeof(float) * OBJ_VERTEX_FLOATS);
+	table->slots[slot] = index + 1;
+
+	return index;
+}
+
+// imports the OBJ at obj_path (missing normals or UVs come out as zeros), returns FALSE if it can't be opened
+int parse_obj(const char *obj_path, ObjMesh *mesh) {
+
+	memset(mesh, 0, sizeof(ObjMesh));
+
+	int file = open(obj_path, O_RDONLY);
+
+	if (file == -1)
+		return FALSE;
+
+	struct stat file_stat;
+
+	if (fstat(file, &file_stat) == -1) {
+		close(file);
+		return FALSE;
+	}
+
+	const char *data = "";
+
+	if (file_stat.st_size > 0) {
+
+		data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (data == MAP_FAILED) {
+			close(file);
+			return FALSE;
+		}
+	}
+
+	close(file);
+
+	ObjList positions = {0}; // 3 floats each
+	ObjList normals = {0};   // 3 floats each
+	ObjList uvs = {0};       // 2 floats each
+	ObjList vertices = {0};  // OBJ_VERTEX_FLOATS floats each
+	ObjList indices = {0};   // 32 bit, narrowed at the end if possible
+
+	ObjVertexTable table = {0};
+
+	const char *c = data;
+	const char *end = data + file_stat.st_size;
+
+	while (c < end) {
+
+		while (c < end && is_obj_space(*c)) {
+			c++;
+		}
+
+		if (c + 1 < end && c[0] == 'v' && is_obj_space(c[1])) {
+
+			c += 2;
+
+			float *position = push_obj_list(&positions, sizeof(float) * 3);
+			position[0] = -parse_obj_float(&c, end); // obj vertices have reverse xz
+			position[1] = parse_obj_float(&c, end);
+			position[2] = -parse_obj_float(&c, end);
+
+		} else if (c + 2 < end && c[0] == 'v' && c[1] == 'n' && is_obj_space(c[2])) {
+
+			c += 3;
+
+			float *normal = push_obj_list(&normals, sizeof(float) * 3);
+			normal[0] = -parse_obj_float(&c, end); // obj normals have reverse xz
+			normal[1] = parse_obj_float(&c, end);
+			normal[2] = -parse_obj_float(&c, end);
+
+		} else if (c + 2 < end && c[0] == 'v' && c[1] == 't' && is_obj_space(c[2])) {
+
+			c += 3;
+
+			float *uv = push_obj_list(&uvs, sizeof(float) * 2);
+			uv[0] = parse_obj_float(&c, end);
+			uv[1] = parse_obj_float(&c, end);
+
+		} else if (c + 1 < end && c[0] == 'f' && is_obj_space(c[1])) {
+
+			c += 2;
+
+			// each corner is p, p/t, p//n or p/t/n; polygons become a fan of triangles around the first corner
+			int first_corner = -1;
+			int previous_corner = -1;
+
+			while (TRUE) {
+
+				while (c < end && is_obj_space(*c)) {
+					c++;
+				}
+
+				if (c >= end || *c == '\n' || *c == '#')
+					break;
+
+				int p = resolve_obj_index(parse_obj_int(&c, end), positions.count);
+				int t = -1;
+				int n = -1;
+
+				if (c < end && *c == '/') {
+
+					c++;
+
+					if (c < end && *c != '/')
+						t = resolve_obj_index(parse_obj_int(&c, end), uvs.count);
+
+					if (c < end && *c == '/') {
+						c++;
+						n = resolve_obj_index(parse_obj_int(&c, end), normals.count);
+					}
+				}
+
+				// skip anything unparseable so a bad corner can't stall the loop
+				while (c < end && !is_obj_space(*c) && *c != '\n') {
+					c++;
+				}
+
+				if (p == -1)
+					continue;
+
+				float vertex[OBJ_VERTEX_FLOATS] = {0};
+				memcpy(&vertex[0], (float *) positions.data + p * 3, sizeof(float) * 3);
+
+				if (n != -1)
+					memcpy(&vertex[3], (float *) normals.data + n * 3, sizeof(float) * 3);
+
+				if (t != -1)
+					memcpy(&vertex[6], (float *) uvs.data + t * 2, sizeof(float) * 2);
+
+				int corner = add_obj_vertex(&table, &vertices, vertex);
+
+				if (first_corner == -1) {
+					first_corner = corner;
+				} else if (previous_corner == -1) {
+					previous_corner = corner;
+				} else {
+
+					*(uint32_t *) push_obj_list(&indices, sizeof(uint32_t)) = first_corner;
+					*(uint32_t *) push_obj_list(&indices, sizeof(uint32_t)) = previous_corner;
+					*(uint32_t *) push_obj_list(&indices, sizeof(uint32_t)) = corner;
+
+					previous_corner = corner;
+				}
+			}
+		}
+
+		// anything else (comments, groups, materials...) is ignored, so skip to the next line
+		while (c < end && *c != '\n') {
+			c++;
+		}
+
+		c++;
+	}
+
+	if (file_stat.st_size > 0)
+		munmap((void *) data, file_stat.st_size);
+
+	free(positions.data);
+	free(normals.data);
+	free(uvs.data);
+	free(table.slots);
+
+	mesh->vertices = vertices.data;
+	mesh->vertex_count = vertices.count;
+	mesh->indices = indices.data;
+	mesh->index_count = indices.count;
+	mesh->index_size = sizeof(uint32_t);
+
+	if (vertices.count <= 65536) {
+
+		uint16_t *narrow_indices = mesh->indices;
+
+		for (int i = 0; i < indices.count; i++) {
+			narrow_indices[i] = ((uint32_t *) indices.data)[i];
+		}
+
+		mesh->index_size = sizeof(uint16_t);
+	}
+
+	return TRUE;
+}
+
+void free_obj_mesh(ObjMesh *mesh) {
+
+	free(mesh->vertices);
+	free(mesh->indices);
+	memset(mesh, 0, sizeof(ObjMesh));
+}
+
+#endif
@@ -2,19 +2,34 @@
 #include <string.h>
 #include <stdlib.h>
 #include "../../util.c"
+#include "../src/resource_pack.c"
+#include "obj_parser.c"
 
-// this script is a utility, since must include data object files (images, etc.) in program by formatting the object as C sourcecode (most portable/least effort)
+// this script is a utility that preprocesses every resource (images, models, etc.) into the binary resource pack the
+// client mmaps at startup (see ../src/resource_pack.c for the format), so nothing gets parsed or copied at runtime
 
-void print_binary(const unsigned char *binary, const int binary_length, const char *var_name) {
+#define MAX_RESOURCES 64
 
-	printf("unsigned char %s[] = {", var_name);
-	for (int i = 0; i < binary_length; i++) {
-		printf("%#x,", *(binary + i));
-	}
-	printf("};\n\n");
+static ResourcePackEntry entries[MAX_RESOURCES];
+static EZArray entry_data[MAX_RESOURCES];
+static EZArray entry_indices[MAX_RESOURCES]; // meshes only
+static int entry_count = 0;
+
+// returns NULL if there are too many resources
+static ResourcePackEntry *add_entry(const char *name, uint32_t type) {
+
+	if (entry_count == MAX_RESOURCES)
+		return NULL;
+
+	ResourcePackEntry *entry = &entries[entry_count++];
+	memset(entry, 0, sizeof(ResourcePackEntry));
+	strncpy(entry->name, name, sizeof(entry->name) - 1);
+	entry->type = type;
+
+	return entry;
 }
 
-void print_ppm_to_binary(const char *ppm_path, const char *var_name) {
+void add_ppm_to_pack(const char *ppm_path, const char *name) {
 
 	// by default, OpenGL reads texture data with a 4-byte row alignment: https://stackoverflow.com/questions/72177553/why-is-gl-unpack-alignment-default-4
 	// it's more efficient, but means this function cannot properly read images whose dimensions aren't a multiple of 4 (fix is simple tho)
@@ -23,6 +38,11 @@ void print_ppm_to_binary(const char *ppm_path, const char *var_name) {
 
 	FILE *file = fopen(ppm_path, "r");
 
+	if (file == NULL) {
+		fprintf(stderr, "%s does not exist!\n", ppm_path);
+		return;
+	}
+
 	// read header
 	{
 		char line[1024];
@@ -44,115 +64,110 @@ void print_ppm_to_binary(const char *ppm_path, const char *var_name) {
 
 	fclose(file);
 
-	print_binary(pixels, width * height * 3, var_name);
+	ResourcePackEntry *entry = add_entry(name, RESOURCE_TEXTURE);
+
+	if (entry) {
+		entry->width = width;
+		entry->height = height;
+		append_ezarray(&entry_data[entry - entries], pixels, width * height * 3);
+	}
+
+	free(pixels);
 }
 
-void print_obj_to_binary(const char *obj_path, const char *var_name) {
+void add_obj_to_pack(const char *obj_path, const char *name) {
 
-	// read obj file
-	FILE *file = fopen(obj_path, "r");
+	ObjMesh mesh;
 
-	if (file == NULL) {
-		printf("File does not exist!");
+	if (!parse_obj(obj_path, &mesh)) {
+		fprintf(stderr, "%s does not exist!\n", obj_path);
 		return;
 	}
 
-	char line[1024];
+	ResourcePackEntry *entry = add_entry(name, RESOURCE_MESH);
+
+	if (entry) {
+		entry->vertex_count = mesh.vertex_count;
+		entry->index_count = mesh.index_count;
+		entry->index_size = mesh.index_size;
+		append_ezarray(&entry_data[entry - entries], mesh.vertices, sizeof(float) * OBJ_VERTEX_FLOATS * mesh.vertex_count);
+		append_ezarray(&entry_indices[entry - entries], mesh.indices, mesh.index_size * mesh.index_count);
+	}
+
+	free_obj_mesh(&mesh);
+}
 
-	EZArray position_data  = {0};
-	EZArray normal_data    = {0};
-	EZArray texture_data   = {0};
-	EZArray composite_data = {0}; // stores combined vertex position, normal, and texture data
+static void write_padding(FILE *file) {
 
-	int vertex_count;
+	static const unsigned char zeros[RESOURCE_PACK_ALIGNMENT] = {0};
 
-	while (fgets(line, 1024, file)) {
+	long misalignment = ftell(file) % RESOURCE_PACK_ALIGNMENT;
 
-		char prefix[8];
+	if (misalignment)
+		fwrite(zeros, 1, RESOURCE_PACK_ALIGNMENT - misalignment, file);
+}
 
-		sscanf(line, "%s", prefix);
+// returns FALSE on error
+int write_pack(const char *path) {
 
-		if (!strcmp(prefix, "v")) {
+	FILE *file = fopen(path, "wb");
 
-			float v[3];
-			
-			sscanf(line, "v %f %f %f", &v[0], &v[1], &v[2]);
+	if (file == NULL)
+		return FALSE;
 
-			// obj vertices have reverse xz
-			v[0] = -v[0];
-			v[2] = -v[2];
+	ResourcePackHeader header = {0};
+	memcpy(header.magic, RESOURCE_PACK_MAGIC, 4);
+	header.version = RESOURCE_PACK_VERSION;
+	header.entry_count = entry_count;
 
-			append_ezarray(&position_data, v, sizeof(float) * 3);
-		}
+	// lay out the data first, so the table of contents can be written in one go
+	uint64_t offset = sizeof(ResourcePackHeader) + sizeof(ResourcePackEntry) * entry_count;
 
-		else if (!strcmp(prefix, "vn")) {
+	for (int i = 0; i < entry_count; i++) {
 
-			float n[3];
-			
-			sscanf(line, "vn %f %f %f", &n[0], &n[1], &n[2]);
+		offset = (offset + RESOURCE_PACK_ALIGNMENT - 1) / RESOURCE_PACK_ALIGNMENT * RESOURCE_PACK_ALIGNMENT;
 
-			// obj vertices have reverse xz
-			n[0] = -n[0];
-			n[2] = -n[2];
+		entries[i].offset = offset;
+		entries[i].bytecount = entry_data[i].bytecount;
 
-			append_ezarray(&normal_data, n, sizeof(float) * 3);
-		}
+		offset += entry_data[i].bytecount;
 
-		else if (!strcmp(prefix, "vt")) {
+		if (entry_indices[i].bytecount) {
 
-			float n[2];
-			
-			sscanf(line, "vt %f %f", &n[0], &n[1]);
+			offset = (offset + RESOURCE_PACK_ALIGNMENT - 1) / RESOURCE_PACK_ALIGNMENT * RESOURCE_PACK_ALIGNMENT;
 
-			append_ezarray(&texture_data, n, sizeof(float) * 2);
+			entries[i].index_offset = offset;
+			offset += entry_indices[i].bytecount;
 		}
+	}
 
-		else if (!strcmp(prefix, "f")) {
-
-			// only works with tris right now (no quads or ngons)
-
-			unsigned int p[3]; // vertex position indices
-			unsigned int t[3]; // vertex texture coordinate indices
-			unsigned int n[3]; // vertex normal indices
-			
-			sscanf(line, "f %u/%u/%u %u/%u/%u %u/%u/%u",
-				&p[0], &t[0], &n[0],
-				&p[1], &t[1], &n[1],
-				&p[2], &t[2], &n[2]);
-
-			// convert vertex indices to vertex positions (indices start at 1 for some reason)
-			append_ezarray(&composite_data, position_data.data + ((p[0] - 1) * sizeof(float) * 3), sizeof(float) * 3);
-			append_ezarray(&composite_data, normal_data.data +   ((n[0] - 1) * sizeof(float) * 3), sizeof(float) * 3);
-			append_ezarray(&composite_data, texture_data.data +  ((t[0] - 1) * sizeof(float) * 2), sizeof(float) * 2);
-
-			append_ezarray(&composite_data, position_data.data + ((p[1] - 1) * sizeof(float) * 3), sizeof(float) * 3);
-			append_ezarray(&composite_data, normal_data.data +   ((n[1] - 1) * sizeof(float) * 3), sizeof(float) * 3);
-			append_ezarray(&composite_data, texture_data.data +  ((t[1] - 1) * sizeof(float) * 2), sizeof(float) * 2);
-
-			append_ezarray(&composite_data, position_data.data + ((p[2] - 1) * sizeof(float) * 3), sizeof(float) * 3);
-			append_ezarray(&composite_data, normal_data.data +   ((n[2] - 1) * sizeof(float) * 3), sizeof(float) * 3);
-			append_ezarray(&composite_data, texture_data.data +  ((t[2] - 1) * sizeof(float) * 2), sizeof(float) * 2);
-			
-			vertex_count += 3;
+	fwrite(&header, sizeof(ResourcePackHeader), 1, file);
+	fwrite(entries, sizeof(ResourcePackEntry), entry_count, file);
+
+	for (int i = 0; i < entry_count; i++) {
+
+		write_padding(file);
+		fwrite(entry_data[i].data, 1, entry_data[i].bytecount, file);
+
+		if (entry_indices[i].bytecount) {
+			write_padding(file);
+			fwrite(entry_indices[i].data, 1, entry_indices[i].bytecount, file);
 		}
 	}
 
-	fclose(file);
-
-	// print composite_data info
-	printf("int %s_bytecount = %d;\n", var_name, composite_data.bytecount);
-	printf("int %s_vertcount = %d;\n", var_name, vertex_count);
-	print_binary(composite_data.data, composite_data.bytecount, var_name);
+	return fclose(file) == 0;
 }
 
 int main() {
 
-	freopen("../src/resources.c", "w", stdout);
+	add_obj_to_pack("miku.obj", "miku_mesh");
+	add_ppm_to_pack("dirt.ppm", "dirt_texture");
+	add_ppm_to_pack("minecraft_block_spritemap.ppm", "block_spritemap");
 
-	printf("// This file was automagically generated by ../res/resloader.c at linking time. Do not edit it!\n\n");
-	print_obj_to_binary("miku.obj", "miku_mesh");
-	print_ppm_to_binary("dirt.ppm", "dirt_texture");
-	print_ppm_to_binary("minecraft_block_spritemap.ppm", "block_spritemap");
+	if (!write_pack("../../resources.pack")) {
+		fprintf(stderr, "Could not write resources.pack\n");
+		return 1;
+	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include "../../util.c"
+#include "matrix.c"
+#include "resource_pack.c"
 
-// all 3D objects use the same hardcoded shader for simplicity
+// all 3D objects use the same hardcoded shader for simplicity (except chunks, see below)
 static char *vertex =
 "#version 150 core\n"
 "uniform mat4 position_matrix;\n"
@@ -27,7 +29,64 @@ static char *fragment =
 	"outColor = texture(tex, frag_UV) * vec4(c, c, c, 1.0);\n"
 "}";
 
-static GLuint shader_program;
+// chunk meshes use a packed vertex format (see mesher.c) and texture from the block spritemap
+// vertices are relative to their chunk, whose origin comes from the vertex's page of the chunk arena (see below)
+// their UVs come from the block position along the face and wrap within the vertex's 16x16 tile,
+// so one greedy-merged quad can repeat a block texture across its whole surface
+static char *chunk_vertex =
+"#version 150 core\n"
+"uniform mat4 position_matrix;\n"
+"uniform mat4 normal_matrix;\n"
+"uniform isamplerBuffer chunk_origins;\n"
+"in uint vertex_data;\n"
+"out vec3 normal_camera;\n"
+"out vec2 frag_UV;\n"
+"flat out vec2 frag_tile;\n"
+"const vec3 normals[6] = vec3[6](vec3(-1, 0, 0), vec3(1, 0, 0), vec3(0, 0, -1), vec3(0, 0, 1), vec3(0, -1, 0), vec3(0, 1, 0));\n"
+"const ivec3 uv_axes[6] = ivec3[6](ivec3(2, 1, 1), ivec3(2, 0, 1), ivec3(0, 0, 1), ivec3(0, 1, 1), ivec3(2, 0, 0), ivec3(2, 1, 0));\n" // u axis | u flipped | v axis
+"void main() {\n"
+    "vec3 position = vec3(float(vertex_data & 31u), float((vertex_data >> 5) & 31u), float((vertex_data >> 10) & 31u));\n"
+    "int face = int((vertex_data >> 15) & 7u);\n"
+    "float tile = float((vertex_data >> 18) & 255u);\n"
+    "vec3 origin = vec3(texelFetch(chunk_origins, gl_VertexID >> 8).xyz);\n" // gl_VertexID includes the draw's base vertex, >> CHUNK_ARENA_PAGE_SHIFT
+    "gl_Position = position_matrix * vec4(origin + vec3(position.xy, -position.z), 1.0);\n"
+    "normal_camera = (normal_matrix * vec4(normals[face], 1.0)).xyz;\n"
+    "ivec3 uv_axis = uv_axes[face];\n"
+    "frag_UV = vec2(uv_axis.y == 1 ? -position[uv_axis.x] : position[uv_axis.x], position[uv_axis.z]);\n"
+    "frag_tile = vec2(mod(tile, 16.0), floor(tile / 16.0));\n" // column/row of the tile in the spritemap
+"}";
+
+static char *chunk_fragment =
+"#version 150 core\n"
+"uniform sampler2D tex;\n"
+"in vec3 normal_camera;\n"
+"in vec2 frag_UV;\n"
+"flat in vec2 frag_tile;\n"
+"out vec4 outColor;\n"
+"void main() {\n"
+	"float c = dot(normal_camera, vec3(0.7, 0.7, 0)) * 0.5 + 0.5;\n"
+	"outColor = texture(tex, (frag_tile + fract(frag_UV)) / 16.0) * vec4(c, c, c, 1.0);\n"
+"}";
+
+// a linked shader program plus its uniform and attribute locations, looked up once in initialize_shader instead of per draw
+typedef struct {
+
+	GLuint program;
+
+	GLint position_matrix_uniform;
+	GLint normal_matrix_uniform;
+
+	GLint position_attrib; // -1 for attributes the program doesn't have
+	GLint normal_attrib;
+	GLint uv_attrib;
+	GLint vertex_data_attrib;
+
+} Shader;
+
+static Shader model_shader;
+static Shader chunk_shader;
+static GLuint chunk_index_buffer; // shared by every chunk model, since chunk faces are all indexed the same way
+static GLuint block_spritemap_texture; // shared by every chunk model, uploaded once
 static GLfloat proj_matrix[4][4] = {0};
 
 typedef struct {
@@ -46,63 +105,83 @@ typedef struct {
 	Transform transform;
 
 	GLuint vertex_array; // "VAO"
+	GLuint vertex_buffer;
+	GLuint index_buffer; // 0 if the model isn't indexed
 	uint vertex_count;
+	uint index_count; // if not 0, the model is drawn with the index buffer bound to its VAO
+	GLenum index_type;
 	GLuint texture;
+	const Shader *shader;
 
 } Model;
 
-typedef struct {
+// render data for a Chunk (see world.c), which holds the actual blocks
+// every chunk's mesh lives in one shared vertex buffer, the chunk arena (see below), so a ChunkModel is just where
+// its mesh sits in there
+struct ChunkModel {
+
+	int origin[3]; // world position of the chunk's corner (z flipped, like everything in world space)
 
-	Model model;
-	unsigned char blocks[16][16][16]; // array of bytes representing blockstates
+	int first_page; // pages of the chunk arena holding the mesh
+	int page_count;
 
-} ChunkModel;
+	uint vertex_count;
+	uint index_count;
+
+	// bit b of face_connections[a] is set if face a of the chunk can see face b through its empty space (see culling.c)
+	unsigned char face_connections[6];
 
-static unsigned char block_types[256 * 4] = { // 4 bytes: block model (0:empty,1:cube) | top texture index | side texture index | bottom texture index
-	0, 0, 0, 0,
-	1, 98, 243, 242
 };
 
-#define BLOCK_MESH_EMPTY 0
-#define BLOCK_MESH_CUBE 1
+// the chunk arena is carved up into pages of CHUNK_ARENA_PAGE_VERTICES vertices, and each chunk mesh takes a run of them
+// chunk vertices only hold their position within the chunk, so the chunk shader finds the chunk's origin by looking up
+// the vertex's page in a buffer texture (which is why meshes start on a page boundary)
+#define CHUNK_ARENA_PAGE_SHIFT 8 // has to match the chunk vertex shader
+#define CHUNK_ARENA_PAGE_VERTICES (1 << CHUNK_ARENA_PAGE_SHIFT)
+#define CHUNK_ARENA_PAGE_BYTES (CHUNK_ARENA_PAGE_VERTICES * sizeof(unsigned int))
+#define CHUNK_ARENA_INITIAL_PAGES 4096 // 4MB of vertices
+#define CHUNK_ARENA_MAX_FREE_RANGES 256 // past this many holes, the arena gets compacted
 
-#define BLOCK_GET_MESH_TYPE(block) (block_types[block * 4])
-#define BLOCK_GET_TOP(block) (block_types[block * 4 + 1])
-#define BLOCK_GET_SIDE(block) (block_types[block * 4 + 2])
-#define BLOCK_GET_BOTTOM(block) (block_types[block * 4 + 3])
-#define BLOCK_HAS_PASSTHROUGH(block) (BLOCK_GET_MESH_TYPE(block) == 0) // "passthrough" means adjacent blocks aren't able to cull the faces that touch it
+typedef struct {
 
-#define GET_SPRITEMAP_UV(index, u_sml, v_sml, u_big, v_big) u_sml = ((index) % 16) / 16.; v_sml = ((index) / 16) / 16.; u_big = (((index) + 1) % 16) / 16.; v_big = ((index) / 16 + 1) / 16.;
+	int first_page;
+	int page_count;
 
-// returns NULL on error
-Model *create_model(const unsigned char *mesh, const int mesh_bytecount, const int mesh_vertcount, const unsigned char *tex, const int tex_width, const int tex_height) {
+} ChunkArenaRange;
 
-	// make vertex array
-	GLuint vertex_array;
-	glGenVertexArrays(1, &vertex_array);
-	glBindVertexArray(vertex_array);
+typedef struct {
 
-	// make vertex buffer (stored by vertex_array)
-	GLuint vertexBuffer;
-	glGenBuffers(1, &vertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);							// make it the active buffer
-	glBufferData(GL_ARRAY_BUFFER, mesh_bytecount, mesh, GL_STATIC_DRAW);	// copy vertex data into the active buffer
+	GLuint vertex_array; // the only VAO chunks use
+	GLuint vertex_buffer;
+	GLuint origin_buffer; // an ivec4 per page, the origin of the chunk owning it
+	GLuint origin_texture; // buffer texture over origin_buffer
 
-	// link active vertex data and shader attributes
-	GLint pos_attrib = glGetAttribLocation(shader_program, "position");
-	glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, 0);
-	glEnableVertexAttribArray(pos_attrib); // requires a VAO to be bound
+	int page_capacity;
+	ChunkModel **page_owners; // chunk model each page belongs to (NULL if free)
 
-	GLint normal_attrib = glGetAttribLocation(shader_program, "normal");
-	glVertexAttribPointer(normal_attrib, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (GLvoid *) (sizeof(float) * 3));
-	glEnableVertexAttribArray(normal_attrib);
+	// holes, sorted by first page (adjacent holes are always merged)
+	ChunkArenaRange *free_ranges;
+	int free_range_count;
+	int free_range_capacity;
+	int free_page_count;
 
-	GLint uv_attrib = glGetAttribLocation(shader_program, "UV");
-	glVertexAttribPointer(uv_attrib, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (GLvoid *) (sizeof(float) * 6));
-	glEnableVertexAttribArray(uv_attrib);
+} ChunkArena;
 
-	// debind vertex array
-	glBindVertexArray(0);
+static ChunkArena chunk_arena = {0};
+
+// live GL object counts, so leaks show up (and VRAM use can be eyeballed)
+typedef struct {
+
+	int vertex_arrays;
+	int buffers;
+	int textures;
+	long buffer_bytes; // storage allocated for all vertex and index buffers
+
+} GLObjectStats;
+
+GLObjectStats gl_object_stats = {0};
+
+GLuint create_texture(const unsigned char *tex, const int tex_width, const int tex_height) {
 
 	// create texture object
 	GLuint texture;
@@ -122,6 +201,58 @@ Model *create_model(const unsigned char *mesh, const int mesh_bytecount, const i
 	// write texture data
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tex_width, tex_height, 0, GL_RGB, GL_UNSIGNED_BYTE, tex);
 
+	gl_object_stats.textures++;
+
+	return texture;
+}
+
+// indices can be NULL for a mesh that's just a list of triangles, otherwise index_size is 2 or 4 bytes
+// returns NULL on error
+Model *create_model(const unsigned char *mesh, const int mesh_bytecount, const int mesh_vertcount, const void *indices, const int index_count, const int index_size, const unsigned char *tex, const int tex_width, const int tex_height) {
+
+	// make vertex array
+	GLuint vertex_array;
+	glGenVertexArrays(1, &vertex_array);
+	glBindVertexArray(vertex_array);
+
+	// make vertex buffer (stored by vertex_array)
+	GLuint vertexBuffer;
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);							// make it the active buffer
+	glBufferData(GL_ARRAY_BUFFER, mesh_bytecount, mesh, GL_STATIC_DRAW);	// copy vertex data into the active buffer
+
+	gl_object_stats.vertex_arrays++;
+	gl_object_stats.buffers++;
+	gl_object_stats.buffer_bytes += mesh_bytecount;
+
+	// link active vertex data and shader attributes
+	glVertexAttribPointer(model_shader.position_attrib, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, 0);
+	glEnableVertexAttribArray(model_shader.position_attrib); // requires a VAO to be bound
+
+	glVertexAttribPointer(model_shader.normal_attrib, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (GLvoid *) (sizeof(float) * 3));
+	glEnableVertexAttribArray(model_shader.normal_attrib);
+
+	glVertexAttribPointer(model_shader.uv_attrib, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (GLvoid *) (sizeof(float) * 6));
+	glEnableVertexAttribArray(model_shader.uv_attrib);
+
+	// make index buffer (also stored by vertex_array)
+	GLuint index_buffer = 0;
+
+	if (indices) {
+
+		glGenBuffers(1, &index_buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * index_size, indices, GL_STATIC_DRAW);
+
+		gl_object_stats.buffers++;
+		gl_object_stats.buffer_bytes += index_count * index_size;
+	}
+
+	// debind vertex array
+	glBindVertexArray(0);
+
+	GLuint texture = create_texture(tex, tex_width, tex_height);
+
 	// create final model object to return
 	Model *model = malloc(sizeof(Model));
 	model->transform.x 		= 0.0f;
@@ -130,312 +261,758 @@ Model *create_model(const unsigned char *mesh, const int mesh_bytecount, const i
 	model->transform.pitch 	= 0.0f;
 	model->transform.yaw 	= 0.0f;
 	model->vertex_array = vertex_array;
+	model->vertex_buffer = vertexBuffer;
+	model->index_buffer = index_buffer;
 	model->vertex_count = mesh_vertcount;
+	model->index_count = indices ? index_count : 0;
+	model->index_type = index_size == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
 	model->texture = texture;
+	model->shader = &model_shader;
 
 	return model;
 }
 
-void append_block_to_mesh(EZArray *mesh, int *vertex_count, const unsigned char blocks[16][16][16], int block_x, int block_y, int block_z) {
+// creates a model straight from mesh and texture data in the resource pack, returns NULL if either is missing
+Model *create_model_from_resources(const ResourcePack *pack, const char *mesh_name, const char *texture_name) {
+
+	const ResourcePackEntry *mesh = find_resource(pack, mesh_name, RESOURCE_MESH);
+	const ResourcePackEntry *texture = find_resource(pack, texture_name, RESOURCE_TEXTURE);
+
+	if (!mesh || !texture)
+		return NULL;
 
-	// this function determines what mesh/UV a block gets (including considering its environment)
+	return create_model(
+		get_resource_data(pack, mesh), mesh->bytecount, mesh->vertex_count,
+		get_resource_indices(pack, mesh), mesh->index_count, mesh->index_size,
+		get_resource_data(pack, texture), texture->width, texture->height
+	);
+}
 
-	unsigned char block = blocks[block_x][block_y][block_z];
+// deletes the model's GL objects, but not the Model itself
+void free_model_gl_objects(Model *model) {
 
-	if (BLOCK_GET_MESH_TYPE(block) == BLOCK_MESH_EMPTY) { return; }
+	GLint buffer_bytes;
+	glBindBuffer(GL_ARRAY_BUFFER, model->vertex_buffer);
+	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &buffer_bytes);
 
-	float u_sml, v_sml, u_big, v_big;
+	glDeleteVertexArrays(1, &model->vertex_array);
+	glDeleteBuffers(1, &model->vertex_buffer);
+	glDeleteTextures(1, &model->texture);
 
-	// get UV for sides
-	GET_SPRITEMAP_UV(BLOCK_GET_SIDE(block), u_sml, v_sml, u_big, v_big)
+	gl_object_stats.vertex_arrays--;
+	gl_object_stats.buffers--;
+	gl_object_stats.textures--;
+	gl_object_stats.buffer_bytes -= buffer_bytes;
 
-	// -x face
-	if (block_x == 0 || BLOCK_HAS_PASSTHROUGH(blocks[block_x-1][block_y][block_z])) {
+	if (model->index_buffer) {
 
-		float full_block_data[] = {
-			block_x, block_y, block_z,			-1, 0, 0,	u_big, v_sml,
-			block_x, block_y, block_z + 1,		-1, 0, 0,	u_sml, v_sml,
-			block_x, block_y + 1, block_z,		-1, 0, 0,	u_big, v_big,
-			block_x, block_y + 1, block_z + 1,	-1, 0, 0,	u_sml, v_big,
-			block_x, block_y + 1, block_z,		-1, 0, 0,	u_big, v_big,
-			block_x, block_y, block_z + 1,		-1, 0, 0,	u_sml, v_sml,
-		};
+		glBindBuffer(GL_ARRAY_BUFFER, model->index_buffer);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &buffer_bytes);
+		glDeleteBuffers(1, &model->index_buffer);
 
-		append_ezarray(mesh, full_block_data, sizeof(float) * 8 * 6);
-		*vertex_count += 6;
+		gl_object_stats.buffers--;
+		gl_object_stats.buffer_bytes -= buffer_bytes;
 	}
+}
+
+// returns the first of page_count contiguous free pages (first fit), or -1 if no hole is big enough
+static int allocate_chunk_arena_pages(int page_count) {
+
+	for (int i = 0; i < chunk_arena.free_range_count; i++) {
+
+		ChunkArenaRange *range = &chunk_arena.free_ranges[i];
+
+		if (range->page_count < page_count)
+			continue;
 
-	// +x face
-	if (block_x == 15 || BLOCK_HAS_PASSTHROUGH(blocks[block_x+1][block_y][block_z])) {
+		int first_page = range->first_page;
 
-		float full_block_data[] = {
-			block_x + 1, block_y, block_z,			1, 0, 0,	u_sml, v_sml,
-			block_x + 1, block_y + 1, block_z,		1, 0, 0,	u_sml, v_big,
-			block_x + 1, block_y, block_z + 1,		1, 0, 0,	u_big, v_sml,
-			block_x + 1, block_y + 1, block_z + 1,	1, 0, 0,	u_big, v_big,
-			block_x + 1, block_y, block_z + 1,		1, 0, 0,	u_big, v_sml,
-			block_x + 1, block_y + 1, block_z,		1, 0, 0,	u_sml, v_big,
-		};
+		range->first_page += page_count;
+		range->page_count -= page_count;
 
-		append_ezarray(mesh, full_block_data, sizeof(float) * 8 * 6);
-		*vertex_count += 6;
+		if (range->page_count == 0) {
+			chunk_arena.free_range_count--;
+			memmove(range, range + 1, sizeof(ChunkArenaRange) * (chunk_arena.free_range_count - i));
+		}
+
+		chunk_arena.free_page_count -= page_count;
+
+		return first_page;
 	}
 
-	// -z face
-	if (block_z == 0 || BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y][block_z-1])) {
+	return -1;
+}
+
+static void free_chunk_arena_pages(int first_page, int page_count) {
 
-		float full_block_data[] = {
-			block_x, block_y, block_z,			0, 0, -1,	u_sml, v_sml,
-			block_x, block_y + 1, block_z,		0, 0, -1,	u_sml, v_big,
-			block_x + 1, block_y, block_z,		0, 0, -1,	u_big, v_sml,
-			block_x + 1, block_y + 1, block_z,	0, 0, -1,	u_big, v_big,
-			block_x + 1, block_y, block_z,		0, 0, -1,	u_big, v_sml,
-			block_x, block_y + 1, block_z,		0, 0, -1,	u_sml, v_big,
-		};
+	if (page_count == 0)
+		return;
 
-		append_ezarray(mesh, full_block_data, sizeof(float) * 8 * 6);
-		*vertex_count += 6;
+	memset(&chunk_arena.page_owners[first_page], 0, sizeof(ChunkModel *) * page_count);
+	chunk_arena.free_page_count += page_count;
+
+	// find where the hole goes (first range after it)
+	int low = 0;
+	int high = chunk_arena.free_range_count;
+
+	while (low < high) {
+
+		int middle = (low + high) / 2;
+
+		if (chunk_arena.free_ranges[middle].first_page < first_page) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
 	}
 
-	// +z face
-	if (block_z == 15 || BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y][block_z+1])) {
+	ChunkArenaRange *before = low > 0 ? &chunk_arena.free_ranges[low - 1] : NULL;
+	ChunkArenaRange *after = low < chunk_arena.free_range_count ? &chunk_arena.free_ranges[low] : NULL;
 
-		float full_block_data[] = {
-			block_x, block_y, block_z + 1,			0, 0, 1,	u_big, v_sml,
-			block_x + 1, block_y, block_z + 1,		0, 0, 1,	u_sml, v_sml,
-			block_x, block_y + 1, block_z + 1,		0, 0, 1,	u_big, v_big,
-			block_x + 1, block_y + 1, block_z + 1,	0, 0, 1,	u_sml, v_big,
-			block_x, block_y + 1, block_z + 1,		0, 0, 1,	u_big, v_big,
-			block_x + 1, block_y, block_z + 1,		0, 0, 1,	u_sml, v_sml,
-		};
+	int joins_before = before && before->first_page + before->page_count == first_page;
+	int joins_after = after && first_page + page_count == after->first_page;
 
-		append_ezarray(mesh, full_block_data, sizeof(float) * 8 * 6);
-		*vertex_count += 6;
+	if (joins_before && joins_after) {
+
+		before->page_count += page_count + after->page_count;
+
+		chunk_arena.free_range_count--;
+		memmove(after, after + 1, sizeof(ChunkArenaRange) * (chunk_arena.free_range_count - low));
+
+	} else if (joins_before) {
+
+		before->page_count += page_count;
+
+	} else if (joins_after) {
+
+		after->first_page = first_page;
+		after->page_count += page_count;
+
+	} else {
+
+		if (chunk_arena.free_range_count == chunk_arena.free_range_capacity) {
+			chunk_arena.free_range_capacity = chunk_arena.free_range_capacity ? chunk_arena.free_range_capacity * 2 : 64;
+			chunk_arena.free_ranges = realloc(chunk_arena.free_ranges, sizeof(ChunkArenaRange) * chunk_arena.free_range_capacity);
+		}
+
+		memmove(&chunk_arena.free_ranges[low + 1], &chunk_arena.free_ranges[low], sizeof(ChunkArenaRange) * (chunk_arena.free_range_count - low));
+		chunk_arena.free_ranges[low] = (ChunkArenaRange) { first_page, page_count };
+		chunk_arena.free_range_count++;
 	}
+}
+
+// points the pages at their chunk model, and tells the shader where that chunk is
+static void claim_chunk_arena_pages(ChunkModel *chunk_model, int first_page, int page_count) {
 
-	// -y face
-	if (block_y == 0 || BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y-1][block_z])) {
+	GLint origins[page_count][4];
 
-		// get UV for bottom
-		GET_SPRITEMAP_UV(BLOCK_GET_BOTTOM(block), u_sml, v_sml, u_big, v_big)
+	for (int i = 0; i < page_count; i++) {
 
-		float full_block_data[] = {
-			block_x, block_y, block_z,			0, -1, 0,	u_sml, v_sml,
-			block_x + 1, block_y, block_z,		0, -1, 0,	u_sml, v_big,
-			block_x, block_y, block_z + 1,		0, -1, 0,	u_big, v_sml,
-			block_x + 1, block_y, block_z + 1,	0, -1, 0,	u_big, v_big,
-			block_x, block_y, block_z + 1,		0, -1, 0,	u_big, v_sml,
-			block_x + 1, block_y, block_z,		0, -1, 0,	u_sml, v_big,
-		};
+		chunk_arena.page_owners[first_page + i] = chunk_model;
 
-		append_ezarray(mesh, full_block_data, sizeof(float) * 8 * 6);
-		*vertex_count += 6;
+		origins[i][0] = chunk_model->origin[0];
+		origins[i][1] = chunk_model->origin[1];
+		origins[i][2] = chunk_model->origin[2];
+		origins[i][3] = 0;
 	}
 
-	// +y face
-	if (block_y == 15 || BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y+1][block_z])) {
+	glBindBuffer(GL_TEXTURE_BUFFER, chunk_arena.origin_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, sizeof(GLint) * 4 * first_page, sizeof(GLint) * 4 * page_count, origins);
+}
+
+// moves every mesh to the front of a fresh buffer of page_capacity pages (which has to fit them all), leaving one hole
+// at the end, and updates the chunk models to match
+// (also how the arena grows, and how it gets set up in the first place)
+static void rebuild_chunk_arena(int page_capacity) {
+
+	GLuint vertex_buffer;
+	glGenBuffers(1, &vertex_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, CHUNK_ARENA_PAGE_BYTES * page_capacity, NULL, GL_DYNAMIC_DRAW);
+
+	ChunkModel **page_owners = calloc(page_capacity, sizeof(ChunkModel *));
+	GLint (*origins)[4] = calloc(page_capacity, sizeof(GLint) * 4);
+
+	int write_page = 0;
+
+	if (chunk_arena.vertex_buffer) {
+
+		glBindBuffer(GL_COPY_READ_BUFFER, chunk_arena.vertex_buffer);
 
-		// get UV for top
-		GET_SPRITEMAP_UV(BLOCK_GET_TOP(block), u_sml, v_sml, u_big, v_big)
+		// copy meshes over in runs, so neighboring meshes (the usual case) move with one copy
+		int run_read_page = 0;
+		int run_write_page = 0;
+		int run_page_count = 0;
 
-		float full_block_data[] = {
-			block_x, block_y + 1, block_z,			0, 1, 0,	u_big, v_sml,
-			block_x, block_y + 1, block_z + 1,		0, 1, 0,	u_sml, v_sml,
-			block_x + 1, block_y + 1, block_z,		0, 1, 0,	u_big, v_big,
-			block_x + 1, block_y + 1, block_z + 1,	0, 1, 0,	u_sml, v_big,
-			block_x + 1, block_y + 1, block_z,		0, 1, 0,	u_big, v_big,
-			block_x, block_y + 1, block_z + 1,		0, 1, 0,	u_sml, v_sml,
-		};
+		for (int page = 0; page < chunk_arena.page_capacity; page++) {
 
-		append_ezarray(mesh, full_block_data, sizeof(float) * 8 * 6);
-		*vertex_count += 6;
+			ChunkModel *chunk_model = chunk_arena.page_owners[page];
+
+			if (!chunk_model || chunk_model->first_page != page)
+				continue;
+
+			if (run_read_page + run_page_count != page) {
+
+				if (run_page_count)
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, CHUNK_ARENA_PAGE_BYTES * run_read_page, CHUNK_ARENA_PAGE_BYTES * run_write_page, CHUNK_ARENA_PAGE_BYTES * run_page_count);
+
+				run_read_page = page;
+				run_write_page = write_page;
+				run_page_count = 0;
+			}
+
+			run_page_count += chunk_model->page_count;
+			chunk_model->first_page = write_page;
+
+			for (int i = 0; i < chunk_model->page_count; i++, write_page++) {
+
+				page_owners[write_page] = chunk_model;
+
+				origins[write_page][0] = chunk_model->origin[0];
+				origins[write_page][1] = chunk_model->origin[1];
+				origins[write_page][2] = chunk_model->origin[2];
+			}
+
+			page += chunk_model->page_count - 1;
+		}
+
+		if (run_page_count)
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, CHUNK_ARENA_PAGE_BYTES * run_read_page, CHUNK_ARENA_PAGE_BYTES * run_write_page, CHUNK_ARENA_PAGE_BYTES * run_page_count);
+
+		glDeleteBuffers(1, &chunk_arena.vertex_buffer);
+
+		gl_object_stats.buffers--;
+		gl_object_stats.buffer_bytes -= (CHUNK_ARENA_PAGE_BYTES + sizeof(GLint) * 4) * chunk_arena.page_capacity;
+
+	} else {
+
+		glGenVertexArrays(1, &chunk_arena.vertex_array);
+		glGenBuffers(1, &chunk_arena.origin_buffer);
+		glGenTextures(1, &chunk_arena.origin_texture);
+
+		gl_object_stats.vertex_arrays++;
+		gl_object_stats.buffers++;
+		gl_object_stats.textures++;
 	}
+
+	chunk_arena.vertex_buffer = vertex_buffer;
+	chunk_arena.page_capacity = page_capacity;
+
+	free(chunk_arena.page_owners);
+	chunk_arena.page_owners = page_owners;
+
+	chunk_arena.free_range_count = 0;
+	chunk_arena.free_page_count = 0;
+	free_chunk_arena_pages(write_page, page_capacity - write_page);
+
+	gl_object_stats.buffers++;
+	gl_object_stats.buffer_bytes += (CHUNK_ARENA_PAGE_BYTES + sizeof(GLint) * 4) * page_capacity;
+
+	// point the VAO at the new buffer (the element buffer binding is part of the VAO's state too)
+	glBindVertexArray(chunk_arena.vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, chunk_arena.vertex_buffer);
+	glVertexAttribIPointer(chunk_shader.vertex_data_attrib, 1, GL_UNSIGNED_INT, sizeof(unsigned int), 0);
+	glEnableVertexAttribArray(chunk_shader.vertex_data_attrib);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk_index_buffer);
+	glBindVertexArray(0);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, chunk_arena.origin_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLint) * 4 * page_capacity, origins, GL_DYNAMIC_DRAW);
+
+	glBindTexture(GL_TEXTURE_BUFFER, chunk_arena.origin_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, chunk_arena.origin_buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	free(origins);
 }
 
-// remeshes based on the model's internal chunk_data
-void remesh_chunk(const ChunkModel *chunk) {
+// compacts the arena if it has gotten too full of holes (cheap to call every tick)
+void defragment_chunk_arena() {
 
-	EZArray mesh = {0};
+	if (chunk_arena.free_range_count > CHUNK_ARENA_MAX_FREE_RANGES)
+		rebuild_chunk_arena(chunk_arena.page_capacity);
+}
 
-	int vertex_count = 0;
+void free_chunk_arena() {
+
+	glDeleteVertexArrays(1, &chunk_arena.vertex_array);
+	glDeleteBuffers(1, &chunk_arena.vertex_buffer);
+	glDeleteBuffers(1, &chunk_arena.origin_buffer);
+	glDeleteTextures(1, &chunk_arena.origin_texture);
 
-	for (int x = 0; x < 16; x++)
-		for (int y = 0; y < 16; y++)
-			for (int z = 0; z < 16; z++)
-				append_block_to_mesh(&mesh, &vertex_count, chunk->blocks, x, y, z);
+	gl_object_stats.vertex_arrays--;
+	gl_object_stats.buffers -= 2;
+	gl_object_stats.textures--;
+	gl_object_stats.buffer_bytes -= (CHUNK_ARENA_PAGE_BYTES + sizeof(GLint) * 4) * chunk_arena.page_capacity;
 
-	Model *model = create_model(mesh.data, mesh.bytecount, vertex_count, block_spritemap, 256, 256);
+	free(chunk_arena.page_owners);
+	free(chunk_arena.free_ranges);
 
-	memcpy((void *) &chunk->model, model, sizeof(Model));
-	free(model);
+	memset(&chunk_arena, 0, sizeof(chunk_arena));
 }
 
-void mat4_mult(const GLfloat b[4][4], const GLfloat a[4][4], GLfloat out[4][4]) {
-
-	// a (rightmost) is applied first, then b
-
-	GLfloat matrix[4][4] = {
-		{
-			a[0][0] * b[0][0] + a[0][1] * b[1][0] + a[0][2] * b[2][0] + a[0][3] * b[3][0],
-			a[0][0] * b[0][1] + a[0][1] * b[1][1] + a[0][2] * b[2][1] + a[0][3] * b[3][1],
-			a[0][0] * b[0][2] + a[0][1] * b[1][2] + a[0][2] * b[2][2] + a[0][3] * b[3][2],
-			a[0][0] * b[0][3] + a[0][1] * b[1][3] + a[0][2] * b[2][3] + a[0][3] * b[3][3],
-		},
-		{
-			a[1][0] * b[0][0] + a[1][1] * b[1][0] + a[1][2] * b[2][0] + a[1][3] * b[3][0],
-			a[1][0] * b[0][1] + a[1][1] * b[1][1] + a[1][2] * b[2][1] + a[1][3] * b[3][1],
-			a[1][0] * b[0][2] + a[1][1] * b[1][2] + a[1][2] * b[2][2] + a[1][3] * b[3][2],
-			a[1][0] * b[0][3] + a[1][1] * b[1][3] + a[1][2] * b[2][3] + a[1][3] * b[3][3],
-		},
-		{
-			a[2][0] * b[0][0] + a[2][1] * b[1][0] + a[2][2] * b[2][0] + a[2][3] * b[3][0],
-			a[2][0] * b[0][1] + a[2][1] * b[1][1] + a[2][2] * b[2][1] + a[2][3] * b[3][1],
-			a[2][0] * b[0][2] + a[2][1] * b[1][2] + a[2][2] * b[2][2] + a[2][3] * b[3][2],
-			a[2][0] * b[0][3] + a[2][1] * b[1][3] + a[2][2] * b[2][3] + a[2][3] * b[3][3],
-		},
-		{
-			a[3][0] * b[0][0] + a[3][1] * b[1][0] + a[3][2] * b[2][0] + a[3][3] * b[3][0],
-			a[3][0] * b[0][1] + a[3][1] * b[1][1] + a[3][2] * b[2][1] + a[3][3] * b[3][1],
-			a[3][0] * b[0][2] + a[3][1] * b[1][2] + a[3][2] * b[2][2] + a[3][3] * b[3][2],
-			a[3][0] * b[0][3] + a[3][1] * b[1][3] + a[3][2] * b[2][3] + a[3][3] * b[3][3],
-		},
-	};
+// returns a chunk model with no mesh yet, for the chunk at the given chunk coordinates
+ChunkModel *create_chunk_model(int x, int y, int z) {
+
+	ChunkModel *chunk_model = calloc(1, sizeof(ChunkModel));
+
+	// chunk meshes are built in local block coordinates (z gets flipped by the shader)
+	chunk_model->origin[0] = x * 16;
+	chunk_model->origin[1] = y * 16;
+	chunk_model->origin[2] = z * -16;
+
+	// see-through until its first mesh says otherwise
+	memset(chunk_model->face_connections, 0x3F, sizeof(chunk_model->face_connections));
+
+	return chunk_model;
+}
+
+void release_chunk_model(ChunkModel *chunk_model) {
+
+	free_chunk_arena_pages(chunk_model->first_page, chunk_model->page_count);
+	free(chunk_model);
+}
 
-	int x, y;
+void upload_chunk_mesh(ChunkModel *chunk_model, const unsigned char *mesh, const int mesh_bytecount, const int mesh_vertcount) {
 
-	for (x = 0; x < 4; x++) {
-		for (y = 0; y < 4; y++) {
-			out[x][y] = matrix[x][y];
+	chunk_model->vertex_count = mesh_vertcount;
+	chunk_model->index_count = mesh_vertcount / CHUNK_FACE_VERTICES * CHUNK_FACE_INDICES;
+
+	int page_count = (mesh_vertcount + CHUNK_ARENA_PAGE_VERTICES - 1) >> CHUNK_ARENA_PAGE_SHIFT;
+
+	if (page_count <= chunk_model->page_count) {
+
+		// shrinking (or same size), so give back the pages on the end
+		free_chunk_arena_pages(chunk_model->first_page + page_count, chunk_model->page_count - page_count);
+		chunk_model->page_count = page_count;
+
+	} else {
+
+		// growing, so the mesh moves to wherever it fits
+		free_chunk_arena_pages(chunk_model->first_page, chunk_model->page_count);
+		chunk_model->page_count = 0;
+
+		int first_page = allocate_chunk_arena_pages(page_count);
+
+		if (first_page == -1) {
+
+			// no hole is big enough, so compact (and grow if even that won't leave enough room)
+			int page_capacity = chunk_arena.page_capacity;
+
+			while (page_capacity - (chunk_arena.page_capacity - chunk_arena.free_page_count) < page_count * 2) {
+				page_capacity *= 2;
+			}
+
+			rebuild_chunk_arena(page_capacity);
+			first_page = allocate_chunk_arena_pages(page_count);
 		}
+
+		chunk_model->first_page = first_page;
+		chunk_model->page_count = page_count;
+
+		claim_chunk_arena_pages(chunk_model, first_page, page_count);
 	}
+
+	if (mesh_bytecount == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, chunk_arena.vertex_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, CHUNK_ARENA_PAGE_BYTES * chunk_model->first_page, mesh_bytecount, mesh);
 }
 
-void generate_rotation_matrices(GLfloat pitch_matrix[4][4], float pitch, GLfloat yaw_matrix[4][4], float yaw) {
-
-	pitch_matrix[0][0] = 1;
-	pitch_matrix[0][1] = 0;
-	pitch_matrix[0][2] = 0;
-	pitch_matrix[0][3] = 0;
-
-	pitch_matrix[1][0] = 0;
-	pitch_matrix[1][1] = cos(pitch);
-	pitch_matrix[1][2] = -sin(pitch);
-	pitch_matrix[1][3] = 0;
-
-	pitch_matrix[2][0] = 0;
-	pitch_matrix[2][1] = sin(pitch);
-	pitch_matrix[2][2] = cos(pitch);
-	pitch_matrix[2][3] = 0;
-
-	pitch_matrix[3][0] = 0;
-	pitch_matrix[3][1] = 0;
-	pitch_matrix[3][2] = 0;
-	pitch_matrix[3][3] = 1;
-
-	yaw_matrix[0][0] = cos(yaw);
-	yaw_matrix[0][1] = 0;
-	yaw_matrix[0][2] = sin(yaw);
-	yaw_matrix[0][3] = 0;
-
-	yaw_matrix[1][0] = 0;
-	yaw_matrix[1][1] = 1;
-	yaw_matrix[1][2] = 0;
-	yaw_matrix[1][3] = 0;
-
-	yaw_matrix[2][0] = -sin(yaw);
-	yaw_matrix[2][1] = 0;
-	yaw_matrix[2][2] = cos(yaw);
-	yaw_matrix[2][3] = 0;
-
-	yaw_matrix[3][0] = 0;
-	yaw_matrix[3][1] = 0;
-	yaw_matrix[3][2] = 0;
-	yaw_matrix[3][3] = 1;
+static void set_chunk_mesh(Chunk *chunk, const unsigned char *mesh, const int mesh_bytecount, const int mesh_vertcount, const unsigned char face_connections[6]) {
+
+	if (!chunk->model)
+		chunk->model = create_chunk_model(chunk->x, chunk->y, chunk->z);
+
+	upload_chunk_mesh(chunk->model, mesh, mesh_bytecount, mesh_vertcount);
+	memcpy(chunk->model->face_connections, face_connections, sizeof(chunk->model->face_connections));
 }
 
-void draw_model(const Transform *camera, const Model *model) {
+// chunks of a single block type skip the mesher when the answer is obvious: air has no faces (and needs no model at all),
+// and neither does an opaque block walled in by opaque neighbors; returns FALSE if the chunk needs meshing after all
+int set_uniform_chunk_mesh(const World *world, Chunk *chunk) {
 
-	// shared buffers
-	GLfloat pitch_matrix[4][4];
-	GLfloat yaw_matrix[4][4];
+	if (!is_chunk_uniform(&chunk->blocks))
+		return FALSE;
 
-	GLfloat position_matrix[4][4];
+	unsigned char face_connections[6];
 
-	// bind the model's vertex mesh and texture
-	glBindVertexArray(model->vertex_array);
-	glBindTexture(GL_TEXTURE_2D, model->texture);
+	if (BLOCK_HAS_PASSTHROUGH(chunk->blocks.single_block)) {
 
-	// model matrix (converts from model space to world space)
-	generate_rotation_matrices(
-		pitch_matrix, model->transform.pitch,
-		yaw_matrix, model->transform.yaw
-	);
+		if (!chunk->model)
+			return TRUE;
+
+		memset(face_connections, 0x3F, sizeof(face_connections));
+
+	} else {
+
+		unsigned char borders[6][16][16];
+		copy_chunk_borders(world, chunk, borders);
+
+		for (int i = 0; i < sizeof(borders); i++) {
+
+			if (BLOCK_HAS_PASSTHROUGH((&borders[0][0][0])[i]))
+				return FALSE;
+		}
+
+		memset(face_connections, 0, sizeof(face_connections));
+	}
+
+	set_chunk_mesh(chunk, NULL, 0, 0, face_connections);
+
+	return TRUE;
+}
+
+// remeshes based on the chunk's (and its neighbors') blocks right away, on this thread
+void remesh_chunk(const World *world, Chunk *chunk) {
+
+	if (set_uniform_chunk_mesh(world, chunk))
+		return;
+
+	EZArray mesh = {0};
+
+	int vertex_count = 0;
+
+	unsigned char blocks[16][16][16];
+	unpack_chunk_blocks(&chunk->blocks, blocks);
+
+	unsigned char borders[6][16][16];
+	copy_chunk_borders(world, chunk, borders);
 
-	GLfloat model_matrix[4][4];
+	build_chunk_mesh(&mesh, &vertex_count, blocks, borders, chunk_mesh_mode);
 
-	mat4_mult(yaw_matrix, pitch_matrix, model_matrix); // rotation
+	unsigned char face_connections[6];
+	compute_chunk_connectivity(blocks, face_connections);
 
-	model_matrix[3][0] = model->transform.x; // translation
-	model_matrix[3][1] = model->transform.y;
-	model_matrix[3][2] = model->transform.z;
+	set_chunk_mesh(chunk, mesh.data, mesh.bytecount, vertex_count, face_connections);
+
+	free(mesh.data);
+}
+
+// uploads up to budget meshes finished by the mesh workers, dropping any for chunks that were unloaded or changed since
+void upload_finished_chunk_meshes(const World *world, int budget) {
+
+	MeshJob *job;
+
+	while (budget > 0 && (job = pop_finished_mesh_job())) {
+
+		Chunk *chunk = get_chunk(world, job->x, job->y, job->z);
+
+		if (chunk && chunk->version == job->version) {
+			set_chunk_mesh(chunk, job->mesh.data, job->mesh.bytecount, job->vertex_count, job->face_connections);
+			budget--;
+		}
+
+		free_mesh_job(job);
+	}
+}
+
+// view matrix (converts from world space to view space, aka accounts for camera transformations)
+void generate_view_matrix(const Transform *camera, GLfloat view_matrix[4][4]) {
+
+	GLfloat pitch_matrix[4][4];
+	GLfloat yaw_matrix[4][4];
 
-	// view matrix (converts from world space to view space, aka accounts for camera transformations)
 	// must apply translations before rotations this time, unlike model matrix!
 	generate_rotation_matrices(
 		pitch_matrix, -camera->pitch,
 		yaw_matrix, -camera->yaw
 	);
 
-	GLfloat view_matrix[4][4] = {
+	GLfloat translation_matrix[4][4] = {
 		{1, 0, 0, 0},
 		{0, 1, 0, 0},
 		{0, 0, 1, 0},
 		{-camera->x, -camera->y, -camera->z, 1}
 	};
 
-	mat4_mult(yaw_matrix, view_matrix, view_matrix);
+	mat4_mult(yaw_matrix, translation_matrix, view_matrix);
 	mat4_mult(pitch_matrix, view_matrix, view_matrix);
+}
 
-	// final position matrix (proj_matrix * view_matrix * model_matrix)
-	mat4_mult(proj_matrix, view_matrix, position_matrix);
-	mat4_mult(position_matrix, model_matrix, position_matrix);
+// everything that only changes once per frame, plus the models queued to draw this frame
+typedef struct {
 
-	// normal matrix (applied to normals to account for model rotation)
-	GLfloat normal_matrix[4][4];
+	GLfloat view_matrix[4][4];
+	GLfloat view_proj_matrix[4][4]; // proj_matrix * view_matrix
 
-	generate_rotation_matrices(
-		pitch_matrix, -model->transform.pitch,
-		yaw_matrix, -model->transform.yaw
-	);
+	const Model **queued_models;
+	int queued_model_count;
+	int queued_model_capacity;
 
-	mat4_mult(yaw_matrix, pitch_matrix, normal_matrix);
+	// chunks queued to draw this frame, as glMultiDrawElementsBaseVertex arguments
+	GLsizei *chunk_index_counts;
+	GLint *chunk_base_vertices;
+	const GLvoid **chunk_index_offsets; // always 0, every chunk uses the start of the shared index buffer
+	int queued_chunk_count;
+	int queued_chunk_capacity;
 
-	// load the shader program and the uniforms we just calculated
-	glUseProgram(shader_program);
-	glUniformMatrix4fv(glGetUniformLocation(shader_program, "position_matrix"), 1, GL_FALSE, &position_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shader_program, "normal_matrix"), 1, GL_FALSE, &normal_matrix[0][0]);
+} RenderFrame;
 
-	// draw
-	glDrawArrays(GL_TRIANGLES, 0, model->vertex_count);
+RenderFrame render_frame = {0};
+
+// call once per frame before queueing any draws
+void begin_render_frame(const Transform *camera) {
+
+	generate_view_matrix(camera, render_frame.view_matrix);
+	mat4_mult(proj_matrix, render_frame.view_matrix, render_frame.view_proj_matrix);
+
+	render_frame.queued_model_count = 0;
+	render_frame.queued_chunk_count = 0;
 }
 
-void initialize_shader() {
+// the model gets drawn by end_render_frame, so it has to stay alive (and unchanged) until then
+void queue_model_draw(const Model *model) {
+
+	if (render_frame.queued_model_count == render_frame.queued_model_capacity) {
+		render_frame.queued_model_capacity = render_frame.queued_model_capacity ? render_frame.queued_model_capacity * 2 : 256;
+		render_frame.queued_models = realloc(render_frame.queued_models, sizeof(Model *) * render_frame.queued_model_capacity);
+	}
+
+	render_frame.queued_models[render_frame.queued_model_count++] = model;
+}
+
+// the chunk gets drawn by end_render_frame, along with every other chunk in one draw call
+void queue_chunk_draw(const ChunkModel *chunk_model) {
+
+	if (render_frame.queued_chunk_count == render_frame.queued_chunk_capacity) {
+
+		render_frame.queued_chunk_capacity = render_frame.queued_chunk_capacity ? render_frame.queued_chunk_capacity * 2 : 256;
+
+		render_frame.chunk_index_counts = realloc(render_frame.chunk_index_counts, sizeof(GLsizei) * render_frame.queued_chunk_capacity);
+		render_frame.chunk_base_vertices = realloc(render_frame.chunk_base_vertices, sizeof(GLint) * render_frame.queued_chunk_capacity);
+		render_frame.chunk_index_offsets = realloc(render_frame.chunk_index_offsets, sizeof(GLvoid *) * render_frame.queued_chunk_capacity);
+	}
+
+	int i = render_frame.queued_chunk_count++;
+
+	render_frame.chunk_index_counts[i] = chunk_model->index_count;
+	render_frame.chunk_base_vertices[i] = chunk_model->first_page << CHUNK_ARENA_PAGE_SHIFT;
+	render_frame.chunk_index_offsets[i] = 0;
+}
+
+void free_render_frame() {
+
+	free(render_frame.queued_models);
+	free(render_frame.chunk_index_counts);
+	free(render_frame.chunk_base_vertices);
+	free(render_frame.chunk_index_offsets);
+
+	memset(&render_frame, 0, sizeof(render_frame));
+}
+
+// orders draws by program, then texture, then VAO, so models sharing state end up next to each other
+static int compare_queued_models(const void *a, const void *b) {
+
+	const Model *model_a = *(const Model **) a;
+	const Model *model_b = *(const Model **) b;
+
+	if (model_a->shader->program != model_b->shader->program)
+		return model_a->shader->program < model_b->shader->program ? -1 : 1;
+
+	if (model_a->texture != model_b->texture)
+		return model_a->texture < model_b->texture ? -1 : 1;
+
+	if (model_a->vertex_array != model_b->vertex_array)
+		return model_a->vertex_array < model_b->vertex_array ? -1 : 1;
+
+	return 0;
+}
+
+// draws everything queued this frame, only binding state that changed since the previous draw
+void end_render_frame() {
+
+	qsort(render_frame.queued_models, render_frame.queued_model_count, sizeof(Model *), compare_queued_models);
+
+	const Shader *bound_shader = NULL;
+	GLuint bound_texture = 0;
+	GLuint bound_vertex_array = 0;
+
+	// models that aren't rotated (every chunk) skip building rotation matrices, and their normal matrix is just identity
+	static const GLfloat identity_matrix[4][4] = {
+		{1, 0, 0, 0},
+		{0, 1, 0, 0},
+		{0, 0, 1, 0},
+		{0, 0, 0, 1}
+	};
+
+	for (int i = 0; i < render_frame.queued_model_count; i++) {
+
+		const Model *model = render_frame.queued_models[i];
+
+		if (model->shader != bound_shader) {
+			glUseProgram(model->shader->program);
+			bound_shader = model->shader;
+		}
+
+		if (model->texture != bound_texture) {
+			glBindTexture(GL_TEXTURE_2D, model->texture);
+			bound_texture = model->texture;
+		}
+
+		if (model->vertex_array != bound_vertex_array) {
+			glBindVertexArray(model->vertex_array);
+			bound_vertex_array = model->vertex_array;
+		}
+
+		// model matrix (converts from model space to world space)
+		GLfloat model_matrix[4][4];
+		GLfloat normal_matrix[4][4];
+
+		if (model->transform.pitch == 0 && model->transform.yaw == 0) {
+
+			memcpy(model_matrix, identity_matrix, sizeof(model_matrix));
+			memcpy(normal_matrix, identity_matrix, sizeof(normal_matrix));
+
+		} else {
+
+			GLfloat pitch_matrix[4][4];
+			GLfloat yaw_matrix[4][4];
+
+			generate_rotation_matrices(
+				pitch_matrix, model->transform.pitch,
+				yaw_matrix, model->transform.yaw
+			);
+
+			mat4_mult(yaw_matrix, pitch_matrix, model_matrix); // rotation
+
+			// normal matrix (applied to normals to account for model rotation)
+			generate_rotation_matrices(
+				pitch_matrix, -model->transform.pitch,
+				yaw_matrix, -model->transform.yaw
+			);
+
+			mat4_mult(yaw_matrix, pitch_matrix, normal_matrix);
+		}
+
+		model_matrix[3][0] = model->transform.x; // translation
+		model_matrix[3][1] = model->transform.y;
+		model_matrix[3][2] = model->transform.z;
+
+		// final position matrix (proj_matrix * view_matrix * model_matrix)
+		GLfloat position_matrix[4][4];
+		mat4_mult(render_frame.view_proj_matrix, model_matrix, position_matrix);
+
+		glUniformMatrix4fv(model->shader->position_matrix_uniform, 1, GL_FALSE, &position_matrix[0][0]);
+		glUniformMatrix4fv(model->shader->normal_matrix_uniform, 1, GL_FALSE, &normal_matrix[0][0]);
+
+		// draw
+		if (model->index_count) {
+			glDrawElements(GL_TRIANGLES, model->index_count, model->index_type, 0);
+		} else {
+			glDrawArrays(GL_TRIANGLES, 0, model->vertex_count);
+		}
+	}
+
+	// every chunk at once
+	if (render_frame.queued_chunk_count) {
+
+		glUseProgram(chunk_shader.program);
+		glUniformMatrix4fv(chunk_shader.position_matrix_uniform, 1, GL_FALSE, &render_frame.view_proj_matrix[0][0]);
+		glUniformMatrix4fv(chunk_shader.normal_matrix_uniform, 1, GL_FALSE, &identity_matrix[0][0]);
+
+		glBindTexture(GL_TEXTURE_2D, block_spritemap_texture);
+
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_BUFFER, chunk_arena.origin_texture);
+		glActiveTexture(GL_TEXTURE0);
+
+		glBindVertexArray(chunk_arena.vertex_array);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, render_frame.chunk_index_counts, GL_UNSIGNED_SHORT, render_frame.chunk_index_offsets, render_frame.queued_chunk_count, render_frame.chunk_base_vertices);
+	}
+
+	glBindVertexArray(0);
+}
+
+GLuint create_shader_program(const char *vertex_source, const char *fragment_source) {
 
 	// create shader program
-	shader_program = glCreateProgram();
+	GLuint program = glCreateProgram();
 
 	GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, (const char *const *) &vertex, NULL);
+	glShaderSource(vertex_shader, 1, &vertex_source, NULL);
 	glCompileShader(vertex_shader);
-	glAttachShader(shader_program, vertex_shader);
+	glAttachShader(program, vertex_shader);
 
 	GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, (const char *const *) &fragment, NULL);
+	glShaderSource(fragment_shader, 1, &fragment_source, NULL);
 	glCompileShader(fragment_shader);
-	glAttachShader(shader_program, fragment_shader);
+	glAttachShader(program, fragment_shader);
 
 	// apply changes to shader program (not gonna call "glUseProgram" yet bc not drawing)
-	glLinkProgram(shader_program);
+	glLinkProgram(program);
+
+	return program;
+}
+
+static void initialize_shader_locations(Shader *shader) {
+
+	shader->position_matrix_uniform = glGetUniformLocation(shader->program, "position_matrix");
+	shader->normal_matrix_uniform = glGetUniformLocation(shader->program, "normal_matrix");
+
+	shader->position_attrib = glGetAttribLocation(shader->program, "position");
+	shader->normal_attrib = glGetAttribLocation(shader->program, "normal");
+	shader->uv_attrib = glGetAttribLocation(shader->program, "UV");
+	shader->vertex_data_attrib = glGetAttribLocation(shader->program, "vertex_data");
+}
+
+void initialize_shader() {
+
+	model_shader.program = create_shader_program(vertex, fragment);
+	initialize_shader_locations(&model_shader);
+
+	chunk_shader.program = create_shader_program(chunk_vertex, chunk_fragment);
+	initialize_shader_locations(&chunk_shader);
+
+	// samplers never change texture unit, so set them once (the spritemap on 0, chunk origins on 1)
+	glUseProgram(chunk_shader.program);
+	glUniform1i(glGetUniformLocation(chunk_shader.program, "tex"), 0);
+	glUniform1i(glGetUniformLocation(chunk_shader.program, "chunk_origins"), 1);
+	glUseProgram(0);
+}
+
+// returns FALSE if the block spritemap is missing from the resource pack
+int initialize_chunk_rendering(const ResourcePack *pack) {
+
+	const ResourcePackEntry *spritemap = find_resource(pack, "block_spritemap", RESOURCE_TEXTURE);
+
+	if (!spritemap)
+		return FALSE;
+
+	// every chunk face is the same two triangles over 4 vertices, so one static index buffer covers any chunk mesh
+	// (CHUNK_MAX_FACES * 4 vertices still fits in 16 bit indices)
+	GLushort *indices = malloc(sizeof(GLushort) * CHUNK_MAX_FACES * CHUNK_FACE_INDICES);
+
+	for (int i = 0; i < CHUNK_MAX_FACES; i++) {
+
+		GLushort *face = &indices[i * CHUNK_FACE_INDICES];
+		GLushort first = i * CHUNK_FACE_VERTICES;
+
+		face[0] = first;
+		face[1] = first + 1;
+		face[2] = first + 2;
+		face[3] = first + 3;
+		face[4] = first + 2;
+		face[5] = first + 1;
+	}
+
+	glGenBuffers(1, &chunk_index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk_index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * CHUNK_MAX_FACES * CHUNK_FACE_INDICES, indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	gl_object_stats.buffers++;
+	gl_object_stats.buffer_bytes += sizeof(GLushort) * CHUNK_MAX_FACES * CHUNK_FACE_INDICES;
+
+	free(indices);
+
+	// the spritemap is uploaded once and shared by every chunk
+	block_spritemap_texture = create_texture(get_resource_data(pack, spritemap), spritemap->width, spritemap->height);
+
+	rebuild_chunk_arena(CHUNK_ARENA_INITIAL_PAGES);
+
+	return TRUE;
 }
 
 void initialize_perspective(const float aspectRatio) {
@@ -0,0 +1,231 @@
+#ifndef CHUNK_BLOCKS_DEFINED
+
+#define CHUNK_BLOCKS_DEFINED
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../util.c"
+
+// a chunk's 16x16x16 blocks, stored as a palette of the block types in it plus a packed array of 0, 1, 2, 4 or 8 bit
+// indices into that palette (whichever is the smallest that fits), instead of a byte per block
+// terrain only has a handful of block types per chunk, so this is usually 1-2KB instead of 4KB, and chunks of a single
+// block type (all air, all stone) are just this struct
+// blocks are numbered x * 256 + y * 16 + z, same as an unsigned char[16][16][16]
+
+typedef struct {
+
+	unsigned char bits;         // per block: 0 (every block is single_block), 1, 2, 4 or 8
+	unsigned char single_block; // the only block type, when bits is 0
+	unsigned short palette_size;
+
+	unsigned char *palette; // palette_size block types (room for 1 << bits), NULL when bits is 0
+	uint64_t *indices;      // 4096 indices of bits each (never straddling two words), NULL when bits is 0
+
+} ChunkBlocks;
+
+#define CHUNK_BLOCK_INDEX(x, y, z) ((x) << 8 | (y) << 4 | (z))
+
+static inline unsigned int read_chunk_block_index(const ChunkBlocks *blocks, int block) {
+
+	unsigned int bit = block * blocks->bits;
+
+	return blocks->indices[bit >> 6] >> (bit & 63) & ((1u << blocks->bits) - 1);
+}
+
+static inline void write_chunk_block_index(ChunkBlocks *blocks, int block, unsigned int index) {
+
+	unsigned int bit = block * blocks->bits;
+	uint64_t mask = (uint64_t) ((1u << blocks->bits) - 1) << (bit & 63);
+
+	blocks->indices[bit >> 6] = (blocks->indices[bit >> 6] & ~mask) | (uint64_t) index << (bit & 63);
+}
+
+static inline unsigned char get_chunk_block(const ChunkBlocks *blocks, int x, int y, int z) {
+
+	if (blocks->bits == 0)
+		return blocks->single_block;
+
+	return blocks->palette[read_chunk_block_index(blocks, CHUNK_BLOCK_INDEX(x, y, z))];
+}
+
+static inline int is_chunk_uniform(const ChunkBlocks *blocks) {
+
+	return blocks->bits == 0;
+}
+
+// zeroed ChunkBlocks are all air, and are what this leaves behind
+void free_chunk_blocks(ChunkBlocks *blocks) {
+
+	free(blocks->palette);
+	free(blocks->indices);
+	memset(blocks, 0, sizeof(ChunkBlocks));
+}
+
+// the smallest index width for a palette this big
+static int get_chunk_block_bits(int palette_size) {
+
+	return palette_size <= 1 ? 0 : palette_size <= 2 ? 1 : palette_size <= 4 ? 2 : palette_size <= 16 ? 4 : 8;
+}
+
+// moves the indices to a new width (the palette keeps its order, so indices keep their values)
+static void repack_chunk_blocks(ChunkBlocks *blocks, int bits) {
+
+	ChunkBlocks repacked = {
+		.bits = bits,
+		.palette_size = blocks->bits ? blocks->palette_size : 1,
+		.palette = malloc(1 << bits),
+		.indices = calloc(4096 * bits / 64, sizeof(uint64_t))
+	};
+
+	if (blocks->bits) {
+
+		memcpy(repacked.palette, blocks->palette, blocks->palette_size);
+
+		for (int block = 0; block < 4096; block++) {
+			write_chunk_block_index(&repacked, block, read_chunk_block_index(blocks, block));
+		}
+
+	} else {
+		repacked.palette[0] = blocks->single_block; // (every index is already 0)
+	}
+
+	free_chunk_blocks(blocks);
+	*blocks = repacked;
+}
+
+// replaces the contents with a byte per block array, at the smallest width that fits
+void pack_chunk_blocks(ChunkBlocks *blocks, const unsigned char source[16][16][16]) {
+
+	const unsigned char *cells = &source[0][0][0];
+
+	// palette in order of first appearance
+	short palette_indices[256];
+	unsigned char palette[256];
+	int palette_size = 0;
+
+	memset(palette_indices, -1, sizeof(palette_indices));
+
+	for (int block = 0; block < 4096; block++) {
+
+		if (palette_indices[cells[block]] == -1) {
+			palette_indices[cells[block]] = palette_size;
+			palette[palette_size++] = cells[block];
+		}
+	}
+
+	free_chunk_blocks(blocks);
+
+	blocks->bits = get_chunk_block_bits(palette_size);
+
+	if (blocks->bits == 0) {
+		blocks->single_block = palette[0];
+		return;
+	}
+
+	blocks->palette_size = palette_size;
+	blocks->palette = malloc(1 << blocks->bits);
+	blocks->indices = malloc(4096 * blocks->bits / 8);
+
+	memcpy(blocks->palette, palette, palette_size);
+
+	// whole words at a time, since nothing straddles them
+	int per_word = 64 / blocks->bits;
+
+	for (int word = 0; word < 4096 / per_word; word++) {
+
+		uint64_t packed = 0;
+
+		for (int i = 0; i < per_word; i++) {
+			packed |= (uint64_t) palette_indices[cells[word * per_word + i]] << (i * blocks->bits);
+		}
+
+		blocks->indices[word] = packed;
+	}
+}
+
+// expands back to a byte per block (e.g. for the mesher)
+void unpack_chunk_blocks(const ChunkBlocks *blocks, unsigned char destination[16][16][16]) {
+
+	unsigned char *cells = &destination[0][0][0];
+
+	if (blocks->bits == 0) {
+		memset(cells, blocks->single_block, 4096);
+		return;
+	}
+
+	int per_word = 64 / blocks->bits;
+	uint64_t mask = (1u << blocks->bits) - 1;
+
+	for (int word = 0; word < 4096 / per_word; word++) {
+
+		uint64_t packed = blocks->indices[word];
+
+		for (int i = 0; i < per_word; i++) {
+			cells[word * per_word + i] = blocks->palette[packed & mask];
+			packed >>= blocks->bits;
+		}
+	}
+}
+
+// drops the palette entries no block uses any more (edits only ever add them), so a chunk edited back down to a few block
+// types gets its narrow indices back, or none at all if it's a single block type again
+void compact_chunk_blocks(ChunkBlocks *blocks) {
+
+	if (blocks->bits == 0)
+		return;
+
+	unsigned char cells[16][16][16];
+	unpack_chunk_blocks(blocks, cells);
+	pack_chunk_blocks(blocks, cells);
+}
+
+void set_chunk_block(ChunkBlocks *blocks, int x, int y, int z, unsigned char block) {
+
+	if (get_chunk_block(blocks, x, y, z) == block)
+		return;
+
+	int index = 0;
+
+	if (blocks->bits)
+		while (index < blocks->palette_size && blocks->palette[index] != block)
+			index++;
+
+	// new block type, so the palette grows (and if it's full, the indices get wider, unless dropping unused entries made room)
+	if (blocks->bits == 0 || index == blocks->palette_size) {
+
+		if (blocks->bits && blocks->palette_size == 1 << blocks->bits)
+			compact_chunk_blocks(blocks);
+
+		if (blocks->bits == 0 || blocks->palette_size == 1 << blocks->bits)
+			repack_chunk_blocks(blocks, get_chunk_block_bits((blocks->bits ? blocks->palette_size : 1) + 1));
+
+		index = blocks->palette_size++;
+		blocks->palette[index] = block;
+	}
+
+	write_chunk_block_index(blocks, CHUNK_BLOCK_INDEX(x, y, z), index);
+}
+
+void copy_chunk_blocks(ChunkBlocks *destination, const ChunkBlocks *source) {
+
+	free_chunk_blocks(destination);
+	*destination = *source;
+
+	if (source->bits == 0)
+		return;
+
+	destination->palette = malloc(1 << source->bits);
+	destination->indices = malloc(4096 * source->bits / 8);
+
+	memcpy(destination->palette, source->palette, source->palette_size);
+	memcpy(destination->indices, source->indices, 4096 * source->bits / 8);
+}
+
+// bytes used, including the struct itself
+size_t get_chunk_blocks_memory(const ChunkBlocks *blocks) {
+
+	return sizeof(ChunkBlocks) + (blocks->bits ? (1 << blocks->bits) + 4096 * blocks->bits / 8 : 0);
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include "world.c"
+
+// decides which loaded chunks actually get drawn each frame
+// - frustum culling: chunks whose bounding box is completely outside the camera's view are skipped
+// - occlusion culling: a breadth-first search out from the camera's chunk, only stepping from one chunk into the next
+//   through faces that the chunk's empty space connects (see compute_chunk_connectivity in mesher.c), so chunks sealed
+//   off underground never get reached and are skipped too
+
+typedef struct {
+
+	int considered;       // loaded chunks with a mesh
+	int frustum_culled;   // outside the view
+	int occlusion_culled; // in view, but hidden behind solid chunks
+	int drawn;
+
+} ChunkCullStats;
+
+ChunkCullStats chunk_cull_stats; // for the last frame drawn
+
+int chunk_occlusion_culling = TRUE;
+
+static unsigned int cull_frame = 0;
+
+// breadth-first search queue, grown as needed
+typedef struct {
+
+	Chunk *chunk;
+	signed char in_face;      // face of this chunk the search came in through (-1 for the camera's chunk)
+	unsigned char directions; // faces stepped through so far, so the search never doubles back on itself
+
+} ChunkVisit;
+
+static ChunkVisit *chunk_visits = NULL;
+static int chunk_visits_capacity = 0;
+
+// the planes bounding what the camera can see, as (a, b, c, d) with ax + by + cz + d >= 0 inside
+static void extract_frustum_planes(const GLfloat clip_matrix[4][4], GLfloat planes[6][4]) {
+
+	// matrices are column-major, so row i is clip_matrix[0..3][i]
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			planes[i * 2][j]     = clip_matrix[j][3] + clip_matrix[j][i];
+			planes[i * 2 + 1][j] = clip_matrix[j][3] - clip_matrix[j][i];
+		}
+	}
+}
+
+// tests the corner furthest along each plane's normal, so the box only counts as outside if it is entirely behind a plane
+static int is_aabb_outside_frustum(const GLfloat planes[6][4], const GLfloat min[3], const GLfloat max[3]) {
+
+	for (int i = 0; i < 6; i++) {
+
+		GLfloat distance = planes[i][3];
+
+		for (int axis = 0; axis < 3; axis++) {
+			distance += planes[i][axis] * (planes[i][axis] > 0 ? max[axis] : min[axis]);
+		}
+
+		if (distance < 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+// bounding box of the chunk in world space (z is flipped relative to block coordinates)
+static void get_chunk_aabb(const Chunk *chunk, GLfloat min[3], GLfloat max[3]) {
+
+	min[0] = chunk->x * 16;
+	min[1] = chunk->y * 16;
+	min[2] = chunk->z * -16 - 16;
+
+	max[0] = min[0] + 16;
+	max[1] = min[1] + 16;
+	max[2] = min[2] + 16;
+}
+
+static int is_chunk_outside_frustum(const GLfloat planes[6][4], const Chunk *chunk) {
+
+	GLfloat min[3], max[3];
+	get_chunk_aabb(chunk, min, max);
+
+	return is_aabb_outside_frustum(planes, min, max);
+}
+
+// stamps chunk->visible_frame on every chunk the camera could see into; returns FALSE if the search couldn't start
+static int find_visible_chunks(const World *world, const Transform *camera, const GLfloat planes[6][4]) {
+
+	Chunk *start = get_chunk(world,
+		BLOCK_TO_CHUNK((int) floorf(camera->x)),
+		BLOCK_TO_CHUNK((int) floorf(camera->y)),
+		BLOCK_TO_CHUNK((int) floorf(-camera->z))
+	);
+
+	if (!start)
+		return FALSE;
+
+	if (chunk_visits_capacity < world->loaded_count) {
+		chunk_visits_capacity = world->loaded_count;
+		chunk_visits = realloc(chunk_visits, sizeof(ChunkVisit) * chunk_visits_capacity);
+	}
+
+	int head = 0;
+	int tail = 0;
+
+	start->visible_frame = cull_frame;
+	chunk_visits[tail++] = (ChunkVisit) { start, -1, 0 };
+
+	while (head < tail) {
+
+		ChunkVisit visit = chunk_visits[head++];
+
+		// chunks without a mesh yet are treated as see-through
+		unsigned char connections = visit.in_face == -1 || !visit.chunk->model ? 0x3F : visit.chunk->model->face_connections[visit.in_face];
+
+		for (int face = 0; face < 6; face++) {
+
+			if (!(connections >> face & 1) || (visit.directions >> (face ^ 1) & 1))
+				continue;
+
+			Chunk *neighbor = get_chunk(world,
+				visit.chunk->x + face_normals[face][0],
+				visit.chunk->y + face_normals[face][1],
+				visit.chunk->z + face_normals[face][2]
+			);
+
+			if (!neighbor || neighbor->visible_frame == cull_frame || is_chunk_outside_frustum(planes, neighbor))
+				continue;
+
+			neighbor->visible_frame = cull_frame;
+			chunk_visits[tail++] = (ChunkVisit) { neighbor, face ^ 1, visit.directions | 1 << face };
+		}
+	}
+
+	return TRUE;
+}
+
+// queues every loaded chunk the camera can see for drawing this frame (see begin_render_frame), filling in chunk_cull_stats
+void draw_world(const Transform *camera, const World *world) {
+
+	memset(&chunk_cull_stats, 0, sizeof(chunk_cull_stats));
+
+	GLfloat planes[6][4];
+	extract_frustum_planes(render_frame.view_proj_matrix, planes);
+
+	cull_frame++;
+
+	// (if the camera is outside the loaded area there's nowhere to search from, so just frustum cull)
+	int occlusion_culling = chunk_occlusion_culling && find_visible_chunks(world, camera, planes);
+
+	for (int i = 0; i < world->loaded_count; i++) {
+
+		Chunk *chunk = world->loaded[i];
+
+		if (!chunk->model || !chunk->model->vertex_count)
+			continue;
+
+		chunk_cull_stats.considered++;
+
+		if (is_chunk_outside_frustum(planes, chunk)) {
+			chunk_cull_stats.frustum_culled++;
+		} else if (occlusion_culling && chunk->visible_frame != cull_frame) {
+			chunk_cull_stats.occlusion_culled++;
+		} else {
+			chunk_cull_stats.drawn++;
+			queue_chunk_draw(chunk->model);
+		}
+	}
+
+	PROFILE_COUNT(PROFILE_CHUNKS_CONSIDERED, chunk_cull_stats.considered);
+	PROFILE_COUNT(PROFILE_CHUNKS_FRUSTUM_CULLED, chunk_cull_stats.frustum_culled);
+	PROFILE_COUNT(PROFILE_CHUNKS_OCCLUSION_CULLED, chunk_cull_stats.occlusion_culled);
+	PROFILE_COUNT(PROFILE_CHUNKS_DRAWN, chunk_cull_stats.drawn);
+}
+
+void free_culling() {
+
+	free(chunk_visits);
+	chunk_visits = NULL;
+	chunk_visits_capacity = 0;
+}
@@ -1,209 +1,277 @@
-Transform camera;
+Player player;
+Player previous_player; // where the player was one tick ago, for interpolating the camera between ticks
+PlayerInput player_input;
 
 Model *model_test;
 
-ChunkModel chunk;
+World world;
+WorldGenerator world_generator;
+unsigned int world_seed = 1; // the same seed always generates the same terrain
+int worldgen_cache_capacity = 4096; // generated chunks kept around (about 3KB each), so walking back doesn't regenerate them
 
-int left     = FALSE;
-int right    = FALSE;
-int forward  = FALSE;
-int backward = FALSE;
-int up       = FALSE;
-int down     = FALSE;
+RegionStore region_store;
+const char *world_directory = "world"; // where changed chunks are saved (see region.c)
+int world_saving; // FALSE if the directory couldn't be made, in which case changes are lost when their chunk unloads
 
-void on_start() {
-	
-	glClearColor(0.2f, 0.2f, 0.23f, 1.0f);
-	SDL_SetRelativeMouseMode(SDL_TRUE);
+int mesh_upload_budget = 8; // chunk meshes uploaded per frame at most, so a burst of finished meshes doesn't hitch
+int meshing_in_background;
 
-	camera.z = 2;
+// chunks that have been changed are loaded from the world's region files, and everything else is generated in the
+// background, the world just waits on them
+int fill_chunk(int x, int y, int z, ChunkBlocks *blocks) {
 
-	// create a model for testing
-	model_test = create_model(miku_mesh, miku_mesh_bytecount, miku_mesh_vertcount, dirt_texture, 16, 16);
-
-	// create a chunk for testing
-	float heightmap[16][16];
-	populate_2D_noise(16, 16, 20, (float *) heightmap);
+	unsigned char saved[16][16][16];
 
-	for (int x = 0; x < 16; x++)
-		for (int y = 0; y < 16; y++)
-			for (int z = 0; z < 16; z++)
-				chunk.blocks[x][y][z] = heightmap[x][z] > (1 - y / 16.) ? 0 : 1;
+	if (world_saving && load_region_chunk(&region_store, x, y, z, saved)) {
+		pack_chunk_blocks(blocks, saved);
+		return TRUE;
+	}
 
-	remesh_chunk(&chunk);
+	return request_generated_chunk(&world_generator, x, y, z, blocks);
 }
 
-void on_terminate() {
+void cancel_chunk(int x, int y, int z) {
 
-	free(model_test);
+	cancel_generated_chunk(&world_generator, x, y, z);
 }
 
-int is_point_inside_block(float x, float y, float z) {
+// changes a block, and saves its chunk (in the background) so the change is still there after it unloads
+static void edit_block(int x, int y, int z, unsigned char block) {
 
-	if (x < 0 || y < 0 || z > 0 || x > 16 || y > 16 || z < -16)
-		return FALSE;
+	set_block(&world, x, y, z, block);
 
-	return chunk.blocks[(int) x][(int) y][(int) -z];
-}
+	Chunk *chunk = get_chunk(&world, BLOCK_TO_CHUNK(x), BLOCK_TO_CHUNK(y), BLOCK_TO_CHUNK(z));
+
+	if (world_saving && chunk) {
 
-int is_aabb_cube_inside_block(float x, float y, float z, float size) {
-
-	// gonna use unit aabb for now
-	return is_point_inside_block(x - size, y - size, z - size)
-	    || is_point_inside_block(x - size, y - size, z + size)
-		|| is_point_inside_block(x - size, y + size, z - size)
-		|| is_point_inside_block(x - size, y + size, z + size)
-		|| is_point_inside_block(x + size, y - size, z - size)
-		|| is_point_inside_block(x + size, y - size, z + size)
-		|| is_point_inside_block(x + size, y + size, z - size)
-		|| is_point_inside_block(x + size, y + size, z + size);
+		unsigned char blocks[16][16][16];
+		unpack_chunk_blocks(&chunk->blocks, blocks);
+		save_region_chunk(&region_store, chunk->x, chunk->y, chunk->z, blocks);
+	}
 }
 
-void process_tick() {
+void on_chunk_unload(Chunk *chunk) {
 
-	// move in direction of input
-	// if colliding, step in opposite direction in small increments (10) until no longer collision (or completely undid movement)
-	// doesn't allow sliding against walls ugh
+	if (chunk->model)
+		release_chunk_model(chunk->model);
+}
 
-	const float size = 0.2;
+void on_start() {
+	
+	glClearColor(0.2f, 0.2f, 0.23f, 1.0f);
+	SDL_SetRelativeMouseMode(SDL_TRUE);
 
-	if (left) {
+	player.y = 22;
+	player.z = 2;
+	previous_player = player;
 
-		camera.z -= sin(camera.yaw) * 0.1;
-		camera.x -= cos(camera.yaw) * 0.1;
+	// create a model for testing
+	model_test = create_model_from_resources(&resource_pack, "miku_mesh", "dirt_texture");
 
-		if (is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size)) {
+	if (!model_test)
+		fprintf(stderr, "resources.pack is missing the test model\n");
 
-			for (int i=0; i<10 && is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size); i++) {
+	meshing_in_background = start_mesh_workers(0) > 0;
 
-				camera.z += sin(camera.yaw) * 0.01;
-				camera.x += cos(camera.yaw) * 0.01;
-			}
-		}
+	initialize_world_generator(&world_generator, world_seed, 0, worldgen_cache_capacity);
 
-	} else if (right) {
+	world_saving = initialize_region_store(&region_store, world_directory);
 
-		camera.z += sin(camera.yaw) * 0.1;
-		camera.x += cos(camera.yaw) * 0.1;
+	if (!world_saving)
+		fprintf(stderr, "Could not open the world directory %s, changes won't be saved\n", world_directory);
 
-		if (is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size)) {
+	// create the world (chunks get streamed in around the camera every tick)
+	initialize_world(&world, 4, 1);
+	world.fill_chunk = fill_chunk;
+	world.cancel_chunk = cancel_chunk;
+	world.on_chunk_unload = on_chunk_unload;
+}
 
-			for (int i=0; i<10 && is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size); i++) {
+void on_terminate() {
 
-				camera.z -= sin(camera.yaw) * 0.01;
-				camera.x -= cos(camera.yaw) * 0.01;
-			}
-		}
+	stop_mesh_workers();
+	if (world_saving)
+		free_region_store(&region_store); // (writes whatever's still waiting)
+	free_world(&world);
+	free_world_generator(&world_generator);
+	free_chunk_arena();
+	free_culling();
+	free_render_frame();
+	if (model_test) {
+		free_model_gl_objects(model_test);
+		free(model_test);
 	}
+}
 
-	if (forward) {
+// runs at a fixed rate (see main.c), separate from drawing
+void process_tick() {
 
-		camera.z -= cos(camera.yaw) * 0.1;
-		camera.x += sin(camera.yaw) * 0.1;
+	previous_player = player;
+	tick_player(&player, &player_input, &world);
 
-		if (is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size)) {
+	if (model_test)
+		model_test->transform.yaw += 0.01;
 
-			for (int i=0; i<10 && is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size); i++) {
+	// stream chunks around the player and remesh whatever changed
+	update_world(&world, player.x, player.y, player.z);
 
-				camera.z += cos(camera.yaw) * 0.01;
-				camera.x -= sin(camera.yaw) * 0.01;
-			}
-		}
+	PROFILE_BEGIN(PROFILE_MESHING);
 
-	} else if (backward) {
+	Chunk *chunk;
 
-		camera.z += cos(camera.yaw) * 0.1;
-		camera.x -= sin(camera.yaw) * 0.1;
+	while ((chunk = pop_dirty_chunk(&world))) {
 
-		if (is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size)) {
+		if (set_uniform_chunk_mesh(&world, chunk))
+			continue;
 
-			for (int i=0; i<10 && is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size); i++) {
-
-				camera.z -= cos(camera.yaw) * 0.01;
-				camera.x += sin(camera.yaw) * 0.01;
-			}
+		if (meshing_in_background) {
+			submit_mesh_job(&world, chunk, chunk_mesh_mode);
+		} else {
+			remesh_chunk(&world, chunk);
 		}
 	}
 
-	if (up) {
-
-		camera.y += 0.1;
-
-		if (is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size)) {
-
-			for (int i=0; i<10 && is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size); i++) {
-
-				camera.y -= 0.01;
-			}
-		}
+	PROFILE_END(PROFILE_MESHING);
+}
 
-	} else if (down) {
+// runs once per frame drawn, tick_progress being how far (0 to 1) the frame is between the last tick and the next
+void process_frame(float tick_progress) {
+
+	PROFILE_BEGIN(PROFILE_UPLOAD);
+	upload_finished_chunk_meshes(&world, mesh_upload_budget);
+	defragment_chunk_arena();
+	PROFILE_END(PROFILE_UPLOAD);
+
+	// the camera follows the player smoothly between ticks (looking around isn't tick based, so it's always current)
+	Transform camera = {
+		.x = previous_player.x + (player.x - previous_player.x) * tick_progress,
+		.y = previous_player.y + (player.y - previous_player.y) * tick_progress,
+		.z = previous_player.z + (player.z - previous_player.z) * tick_progress,
+		.pitch = player.pitch,
+		.yaw = player.yaw
+	};
+
+	PROFILE_BEGIN(PROFILE_CULL);
+	begin_render_frame(&camera);
+	if (model_test)
+		queue_model_draw(model_test);
+	draw_world(&camera, &world);
+	PROFILE_END(PROFILE_CULL);
+
+	PROFILE_BEGIN(PROFILE_DRAW);
+	end_render_frame();
+	PROFILE_END(PROFILE_DRAW);
+}
 
-		camera.y -= 0.1;
+void process_event(SDL_Event event) {
 
-		if (is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size)) {
+	if (event.type == SDL_MOUSEMOTION) {
 
-			for (int i=0; i<10 && is_aabb_cube_inside_block(camera.x, camera.y, camera.z, size); i++) {
+		player.pitch += event.motion.yrel * 0.01;
+		player.yaw += event.motion.xrel * 0.01;
 
-				camera.y += 0.01;
-			}
+		// clamp camera pitch
+		if (player.pitch > M_PI / 2) {
+			player.pitch = M_PI / 2;
+		} else if (player.pitch < -M_PI / 2) {
+			player.pitch = -M_PI / 2;
 		}
 	}
 
-	model_test->transform.yaw += 0.01;
+	else if (event.type == SDL_MOUSEBUTTONDOWN) {
 
-	draw_model(&camera, model_test);
-	draw_model(&camera, &chunk.model);
-}
+		// left click breaks the block being looked at, right click places one against it
+		RaycastHit hit;
 
-void process_event(SDL_Event event) {
+		if (event.button.button == SDL_BUTTON_LEFT && pick_player_block(&player, &world, &hit)) {
 
-	if (event.type == SDL_MOUSEMOTION) {
+			edit_block(hit.x, hit.y, hit.z, BLOCK_AIR);
 
-		camera.pitch += event.motion.yrel * 0.01;
-		camera.yaw += event.motion.xrel * 0.01;
+		} else if (event.button.button == SDL_BUTTON_RIGHT && pick_player_block(&player, &world, &hit) && hit.face != -1) {
 
-		// clamp camera pitch
-		if (camera.pitch > M_PI / 2) {
-			camera.pitch = M_PI / 2;
-		} else if (camera.pitch < -M_PI / 2) {
-			camera.pitch = -M_PI / 2;
+			// place against the side that was clicked, unless that would put the block inside the player
+			int x = hit.x + face_normals[hit.face][0];
+			int y = hit.y + face_normals[hit.face][1];
+			int z = hit.z + face_normals[hit.face][2];
+
+			AABB box = get_player_aabb(&player);
+
+			if (box.max[0] <= x || box.min[0] >= x + 1 || box.max[1] <= y || box.min[1] >= y + 1 || box.max[2] <= z || box.min[2] >= z + 1)
+				edit_block(x, y, z, BLOCK_DIRT);
 		}
 	}
 
 	else if (event.type == SDL_KEYDOWN && event.key.repeat == 0) {
 
 		if (event.key.keysym.scancode == SDL_SCANCODE_A) {
-			left = TRUE;
+			player_input.left = TRUE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_D) {
-			right = TRUE;
+			player_input.right = TRUE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_W) {
-			forward = TRUE;
+			player_input.forward = TRUE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_S) {
-			backward = TRUE;
+			player_input.backward = TRUE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_SPACE) {
-			up = TRUE;
+			player_input.up = TRUE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_LSHIFT) {
-			down = TRUE;
+			player_input.down = TRUE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE) {
 			SDL_SetRelativeMouseMode(!SDL_GetRelativeMouseMode());
+		} else if (event.key.keysym.scancode == SDL_SCANCODE_M) {
+
+			// toggle between greedy and per-face chunk meshing (for comparing)
+			chunk_mesh_mode = chunk_mesh_mode == CHUNK_MESH_GREEDY ? CHUNK_MESH_PER_FACE : CHUNK_MESH_GREEDY;
+
+			for (int i = 0; i < world.loaded_count; i++) {
+				mark_chunk_dirty(&world, world.loaded[i]);
+			}
+
+		} else if (event.key.keysym.scancode == SDL_SCANCODE_C) {
+
+			// print how many chunks got culled last frame
+			printf("chunks: %d considered, %d frustum culled, %d occlusion culled, %d drawn\n",
+				chunk_cull_stats.considered, chunk_cull_stats.frustum_culled, chunk_cull_stats.occlusion_culled, chunk_cull_stats.drawn);
+
+			// and how much memory the loaded chunks' blocks take
+			printf("blocks: %d chunks loaded, %.0f bytes per chunk\n",
+				world.loaded_count, world.loaded_count ? (double) get_world_block_memory(&world) / world.loaded_count : 0.0);
+
+		} else if (event.key.keysym.scancode == SDL_SCANCODE_O) {
+
+			// toggle occlusion culling (for comparing)
+			chunk_occlusion_culling = !chunk_occlusion_culling;
+		}
+
+#ifdef PROFILER_ENABLED
+		else if (event.key.keysym.scancode == SDL_SCANCODE_P) {
+
+			print_profile_summary();
+
+		} else if (event.key.keysym.scancode == SDL_SCANCODE_F5) {
+
+			if (write_profile_csv("profile.csv")) {
+				printf("wrote profile.csv\n");
+			} else {
+				fprintf(stderr, "could not write profile.csv\n");
+			}
 		}
+#endif
 	}
 
 	else if (event.type == SDL_KEYUP) {
 
 		if (event.key.keysym.scancode == SDL_SCANCODE_A) {
-			left = FALSE;
+			player_input.left = FALSE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_D) {
-			right = FALSE;
+			player_input.right = FALSE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_W) {
-			forward = FALSE;
+			player_input.forward = FALSE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_S) {
-			backward = FALSE;
+			player_input.backward = FALSE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_SPACE) {
-			up = FALSE;
+			player_input.up = FALSE;
 		} else if (event.key.keysym.scancode == SDL_SCANCODE_LSHIFT) {
-			down = FALSE;
+			player_input.down = FALSE;
 		}
 	}
 }
\ No newline at end of file
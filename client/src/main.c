@@ -1,11 +1,30 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 
-#include "resources.c" // binary, automatically updated with new resources on Make (might replace with external loading since modding fun yay)
 #include "../../util.c"
+#include "resource_pack.c"
+#include "world.c"
+#include "worldgen.c"
+#include "region.c"
+#include "mesher.c"
+#include "mesh_workers.c"
+#include "player.c"
+#include "profiler.c"
 #include "3D.c"
+#include "culling.c"
 #include "game.c"
 
+#define TICKS_PER_SECOND 60
+#define MAX_TICKS_PER_FRAME 5 // if a frame takes longer than this many ticks, the simulation slows down instead of spiraling
+
+// how frames get paced (the simulation always runs at TICKS_PER_SECOND regardless)
+#define FRAME_PACING_VSYNC 0    // wait for the display, falling back to capped if vsync isn't available
+#define FRAME_PACING_CAPPED 1   // sleep until the next frame is due, at frame_rate_cap
+#define FRAME_PACING_UNCAPPED 2 // draw as fast as possible
+
+int frame_pacing = FRAME_PACING_VSYNC;
+int frame_rate_cap = 120;
+
 void log_error(const char *msg) {
 	
 	if (strlen(SDL_GetError()) == 0) {
@@ -15,6 +34,39 @@ void log_error(const char *msg) {
 	}
 }
 
+void set_frame_pacing(int pacing) {
+
+	frame_pacing = pacing;
+
+	if (pacing == FRAME_PACING_VSYNC) {
+
+		// adaptive vsync if the driver has it (doesn't wait when a frame is already late), otherwise regular vsync
+		if (SDL_GL_SetSwapInterval(-1) != 0 && SDL_GL_SetSwapInterval(1) != 0) {
+			frame_pacing = FRAME_PACING_CAPPED;
+			SDL_GL_SetSwapInterval(0);
+		}
+
+	} else {
+		SDL_GL_SetSwapInterval(0);
+	}
+}
+
+// sleeps until the performance counter reaches target
+// SDL_Delay can oversleep by a millisecond or so, so it sleeps short and spins the rest of the way
+void wait_until(Uint64 target) {
+
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	Uint64 now;
+
+	while ((now = SDL_GetPerformanceCounter()) < target) {
+
+		Uint64 remaining_ms = (target - now) * 1000 / frequency;
+
+		if (remaining_ms > 2)
+			SDL_Delay(remaining_ms - 2);
+	}
+}
+
 int main() {
 
 	printf("Starting CinnamonCraft\n");
@@ -50,19 +102,48 @@ int main() {
 	glEnable(GL_CULL_FACE);
 	glFrontFace(GL_CW);
 
+	// map the resource pack (built by client/res/resloader.c on Make, can be swapped out without recompiling)
+	if (!open_resource_pack(&resource_pack, "resources.pack")) {
+		fprintf(stderr, "\nCould not open resources.pack (is it next to the executable?)\n\n");
+		return 1;
+	}
+
 	// initialize 3D
 	initialize_shader();
+
+	if (!initialize_chunk_rendering(&resource_pack)) {
+		fprintf(stderr, "\nresources.pack is missing block_spritemap\n\n");
+		return 1;
+	}
+
 	initialize_perspective(2.0);
+
+#ifdef PROFILER_ENABLED
+	initialize_profiler();
+#endif
 	
 	// let programmer initialize stuff
 	on_start();
 
+	set_frame_pacing(frame_pacing);
+
 	// process events until window is closed
 	SDL_Event event;
 	int running = TRUE;
 
+	const Uint64 counter_frequency = SDL_GetPerformanceFrequency();
+	const Uint64 tick_length = counter_frequency / TICKS_PER_SECOND;
+
+	Uint64 previous_time = SDL_GetPerformanceCounter();
+	Uint64 tick_accumulator = 0; // time not yet simulated
+
 	while (running) {
 
+		Uint64 frame_start = SDL_GetPerformanceCounter();
+
+		PROFILE_FRAME();
+		PROFILE_BEGIN(PROFILE_EVENTS);
+
 		while (SDL_PollEvent(&event)) {
 
 			if (event.type == SDL_QUIT) {
@@ -72,21 +153,60 @@ int main() {
 				glViewport(0, 0, event.window.data1, event.window.data2);
 				initialize_perspective(event.window.data1 / (float) event.window.data2);
 			
+			} else if (event.type == SDL_KEYDOWN && event.key.repeat == 0 && event.key.keysym.scancode == SDL_SCANCODE_V) {
+
+				// cycle vsync -> capped -> uncapped
+				set_frame_pacing((frame_pacing + 1) % 3);
+
 			} else {
 				process_event(event);
 			}
 		}
 
-		process_tick();
+		PROFILE_END(PROFILE_EVENTS);
+
+		// run however many ticks have come due since the last frame
+		tick_accumulator += frame_start - previous_time;
+		previous_time = frame_start;
+
+		if (tick_accumulator > tick_length * MAX_TICKS_PER_FRAME)
+			tick_accumulator = tick_length * MAX_TICKS_PER_FRAME;
+
+		PROFILE_BEGIN(PROFILE_TICK);
+
+		while (tick_accumulator >= tick_length) {
+			process_tick();
+			tick_accumulator -= tick_length;
+			PROFILE_COUNT(PROFILE_TICKS, 1);
+		}
+
+		PROFILE_END(PROFILE_TICK);
+
+		// draw, interpolating by how far we are into the next tick
+		PROFILE_GPU_BEGIN();
 
-		SDL_GL_SwapWindow(window);
-		SDL_Delay(1000 / 60);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		process_frame(tick_accumulator / (float) tick_length);
+
+		PROFILE_GPU_END();
+
+		PROFILE_BEGIN(PROFILE_SWAP);
+		SDL_GL_SwapWindow(window);
+		PROFILE_END(PROFILE_SWAP);
+
+		if (frame_pacing == FRAME_PACING_CAPPED)
+			wait_until(frame_start + counter_frequency / frame_rate_cap);
 	}
 
 	// free everything
 	on_terminate();
 
+#ifdef PROFILER_ENABLED
+	free_profiler();
+#endif
+
+	close_resource_pack(&resource_pack);
+
 	SDL_DestroyWindow(window);
 	SDL_GL_DeleteContext(context);
 	SDL_Quit();
@@ -0,0 +1,199 @@
+#ifndef MESH_WORKERS_DEFINED
+
+#define MESH_WORKERS_DEFINED
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "../../util.c"
+#include "world.c"
+#include "mesher.c"
+
+// meshes chunks on a pool of background threads
+// the main thread submits a snapshot of a chunk's blocks, workers build the vertex data, and finished jobs come back
+// through a lock-free queue for the main thread to upload (GL calls have to stay on the main thread)
+
+typedef struct MeshJob {
+
+	// input (copied from the chunk when submitted, so the worker never touches live world data)
+	int x; // chunk coordinates
+	int y;
+	int z;
+	unsigned int version; // chunk->version when submitted, so results for chunks edited since can be thrown out
+	int mode;
+	unsigned char blocks[16][16][16];
+	unsigned char borders[6][16][16]; // neighboring chunks' blocks touching this one
+
+	// output
+	EZArray mesh;
+	int vertex_count;
+	unsigned char face_connections[6];
+
+	struct MeshJob *next;
+
+} MeshJob;
+
+static pthread_t *mesh_worker_threads = NULL;
+static int mesh_worker_count = 0;
+
+// jobs waiting for a worker (FIFO, guarded by a mutex since workers block on it anyway)
+static pthread_mutex_t mesh_job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mesh_job_available = PTHREAD_COND_INITIALIZER;
+static MeshJob *mesh_job_head = NULL;
+static MeshJob *mesh_job_tail = NULL;
+static int mesh_workers_stopping = FALSE;
+
+// finished jobs, pushed by workers onto a lock-free stack that the main thread takes all at once
+static _Atomic(MeshJob *) finished_mesh_jobs = NULL;
+
+// finished jobs the main thread has taken but not handed out yet (oldest first, main thread only)
+static MeshJob *taken_mesh_jobs = NULL;
+
+static void *run_mesh_worker(void *arg) {
+
+	while (TRUE) {
+
+		pthread_mutex_lock(&mesh_job_mutex);
+
+		while (!mesh_job_head && !mesh_workers_stopping) {
+			pthread_cond_wait(&mesh_job_available, &mesh_job_mutex);
+		}
+
+		if (mesh_workers_stopping) {
+			pthread_mutex_unlock(&mesh_job_mutex);
+			return NULL;
+		}
+
+		MeshJob *job = mesh_job_head;
+		mesh_job_head = job->next;
+
+		if (!mesh_job_head)
+			mesh_job_tail = NULL;
+
+		pthread_mutex_unlock(&mesh_job_mutex);
+
+		build_chunk_mesh(&job->mesh, &job->vertex_count, job->blocks, job->borders, job->mode);
+		compute_chunk_connectivity(job->blocks, job->face_connections);
+
+		// push onto the finished stack
+		MeshJob *head = atomic_load_explicit(&finished_mesh_jobs, memory_order_relaxed);
+
+		do {
+			job->next = head;
+		} while (!atomic_compare_exchange_weak_explicit(&finished_mesh_jobs, &head, job, memory_order_release, memory_order_relaxed));
+	}
+}
+
+// returns how many workers actually started (0 means meshing has to happen on the main thread)
+int start_mesh_workers(int thread_count) {
+
+	// leave a core for the main thread
+	if (thread_count <= 0) {
+
+		thread_count = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+		if (thread_count < 1)
+			thread_count = 1;
+	}
+
+	mesh_workers_stopping = FALSE;
+	mesh_worker_threads = malloc(sizeof(pthread_t) * thread_count);
+
+	for (mesh_worker_count = 0; mesh_worker_count < thread_count; mesh_worker_count++) {
+
+		if (pthread_create(&mesh_worker_threads[mesh_worker_count], NULL, run_mesh_worker, NULL) != 0)
+			break;
+	}
+
+	return mesh_worker_count;
+}
+
+void free_mesh_job(MeshJob *job) {
+
+	free(job->mesh.data);
+	free(job);
+}
+
+void submit_mesh_job(const World *world, const Chunk *chunk, int mode) {
+
+	MeshJob *job = calloc(1, sizeof(MeshJob));
+	job->x = chunk->x;
+	job->y = chunk->y;
+	job->z = chunk->z;
+	job->version = chunk->version;
+	job->mode = mode;
+	unpack_chunk_blocks(&chunk->blocks, job->blocks);
+	copy_chunk_borders(world, chunk, job->borders);
+
+	pthread_mutex_lock(&mesh_job_mutex);
+
+	if (mesh_job_tail) {
+		mesh_job_tail->next = job;
+	} else {
+		mesh_job_head = job;
+	}
+
+	mesh_job_tail = job;
+
+	pthread_cond_signal(&mesh_job_available);
+	pthread_mutex_unlock(&mesh_job_mutex);
+}
+
+// main thread only; returns NULL when no finished jobs are left (caller frees the job)
+MeshJob *pop_finished_mesh_job() {
+
+	if (!taken_mesh_jobs) {
+
+		MeshJob *stack = atomic_exchange_explicit(&finished_mesh_jobs, NULL, memory_order_acquire);
+
+		// the stack is newest first, so reverse it to upload in submission order
+		while (stack) {
+
+			MeshJob *next = stack->next;
+			stack->next = taken_mesh_jobs;
+			taken_mesh_jobs = stack;
+			stack = next;
+		}
+	}
+
+	MeshJob *job = taken_mesh_jobs;
+
+	if (job)
+		taken_mesh_jobs = job->next;
+
+	return job;
+}
+
+void stop_mesh_workers() {
+
+	pthread_mutex_lock(&mesh_job_mutex);
+	mesh_workers_stopping = TRUE;
+	pthread_cond_broadcast(&mesh_job_available);
+	pthread_mutex_unlock(&mesh_job_mutex);
+
+	for (int i = 0; i < mesh_worker_count; i++) {
+		pthread_join(mesh_worker_threads[i], NULL);
+	}
+
+	free(mesh_worker_threads);
+	mesh_worker_threads = NULL;
+	mesh_worker_count = 0;
+
+	// throw away anything unfinished or not uploaded
+	while (mesh_job_head) {
+
+		MeshJob *job = mesh_job_head;
+		mesh_job_head = job->next;
+		free_mesh_job(job);
+	}
+
+	mesh_job_tail = NULL;
+
+	MeshJob *job;
+
+	while ((job = pop_finished_mesh_job())) {
+		free_mesh_job(job);
+	}
+}
+
+#endif
@@ -0,0 +1,405 @@
+#ifndef MESHER_DEFINED
+
+#define MESHER_DEFINED
+
+#include "../../util.c"
+#include "world.c"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// turns a chunk's blocks into vertex data (no OpenGL in here, uploading is 3D.c's job)
+
+static unsigned char block_types[256 * 4] = { // 4 bytes: block model (0:empty,1:cube) | top texture index | side texture index | bottom texture index
+	0, 0, 0, 0,       // air
+	1, 98, 243, 242,  // grass
+	1, 242, 242, 242, // dirt
+	1, 241, 241, 241, // stone
+	1, 229, 228, 229, // log
+	1, 181, 181, 181  // leaves
+};
+
+#define BLOCK_MESH_EMPTY 0
+#define BLOCK_MESH_CUBE 1
+
+#define BLOCK_GET_MESH_TYPE(block) (block_types[block * 4])
+#define BLOCK_GET_TOP(block) (block_types[block * 4 + 1])
+#define BLOCK_GET_SIDE(block) (block_types[block * 4 + 2])
+#define BLOCK_GET_BOTTOM(block) (block_types[block * 4 + 3])
+#define BLOCK_HAS_PASSTHROUGH(block) (BLOCK_GET_MESH_TYPE(block) == 0) // "passthrough" means adjacent blocks aren't able to cull the faces that touch it
+
+// borders are the blocks just outside the chunk (see copy_chunk_borders in world.c), or NULL to treat them all as air
+#define BORDER_HAS_PASSTHROUGH(borders, face, a, b) (!(borders) || BLOCK_HAS_PASSTHROUGH((borders)[face][a][b]))
+
+// chunk meshing modes
+#define CHUNK_MESH_PER_FACE 0        // two triangles for every exposed block face
+#define CHUNK_MESH_GREEDY 1          // coplanar faces with the same texture are merged into larger quads
+#define CHUNK_MESH_PER_FACE_SCALAR 2 // same mesh as CHUNK_MESH_PER_FACE, but checking one block and neighbor at a time (reference for benchmarking)
+
+int chunk_mesh_mode = CHUNK_MESH_GREEDY;
+
+// chunk vertices are packed into 32 bits: x (5) | y (5) | z (5) | face direction (3) | spritemap tile index (8)
+// positions are local to the chunk (0-16); the shader works out the normal and UV from the face direction,
+// with UVs measured in blocks so they repeat every block within the tile and merged quads don't stretch their texture
+#define PACK_CHUNK_VERTEX(x, y, z, face, tile) ((unsigned int) (x) | (unsigned int) (y) << 5 | (unsigned int) (z) << 10 | (unsigned int) (face) << 15 | (unsigned int) (tile) << 18)
+
+// faces are quads of 4 vertices, drawn as triangles 0 1 2 and 3 2 1 through a shared index buffer (see 3D.c)
+#define CHUNK_FACE_VERTICES 4
+#define CHUNK_FACE_INDICES 6
+
+// a checkerboard chunk exposes every face of half its blocks, which is the most faces a chunk mesh can have
+#define CHUNK_MAX_FACES (16 * 16 * 16 / 2 * 6)
+
+// faces are emitted per block in FACE_* order (see world.c)
+
+// the 4 corners (0/1 offsets along x, y, z) of each face, ordered for the index pattern above so both triangles are clockwise
+static const unsigned char face_corners[6][4][3] = {
+	{ {0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1} }, // -x
+	{ {1, 0, 0}, {1, 1, 0}, {1, 0, 1}, {1, 1, 1} }, // +x
+	{ {0, 0, 0}, {0, 1, 0}, {1, 0, 0}, {1, 1, 0} }, // -z
+	{ {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1} }, // +z
+	{ {0, 0, 0}, {1, 0, 0}, {0, 0, 1}, {1, 0, 1} }, // -y
+	{ {0, 1, 0}, {0, 1, 1}, {1, 1, 0}, {1, 1, 1} }, // +y
+};
+
+// appends one (possibly merged) face; size is the quad's extent in blocks along x, y, z (1 along the face's normal)
+void append_face_to_mesh(EZArray *mesh, int *vertex_count, int face, int x, int y, int z, const int size[3], unsigned char tile) {
+
+	unsigned int face_data[CHUNK_FACE_VERTICES];
+
+	for (int i = 0; i < CHUNK_FACE_VERTICES; i++) {
+
+		const unsigned char *corner = face_corners[face][i];
+
+		face_data[i] = PACK_CHUNK_VERTEX(
+			x + corner[0] * size[0],
+			y + corner[1] * size[1],
+			z + corner[2] * size[2],
+			face, tile
+		);
+	}
+
+	append_ezarray(mesh, face_data, sizeof(face_data));
+	*vertex_count += CHUNK_FACE_VERTICES;
+}
+
+static unsigned char get_face_tile(unsigned char block, int face) {
+
+	if (face == FACE_POS_Y)
+		return BLOCK_GET_TOP(block);
+
+	if (face == FACE_NEG_Y)
+		return BLOCK_GET_BOTTOM(block);
+
+	return BLOCK_GET_SIDE(block);
+}
+
+void append_block_to_mesh(EZArray *mesh, int *vertex_count, const unsigned char blocks[16][16][16], const unsigned char borders[6][16][16], int block_x, int block_y, int block_z) {
+
+	// this function determines what mesh/UV a block gets (including considering its environment)
+
+	static const int unit_size[3] = {1, 1, 1};
+
+	unsigned char block = blocks[block_x][block_y][block_z];
+
+	if (BLOCK_GET_MESH_TYPE(block) == BLOCK_MESH_EMPTY) { return; }
+
+	// -x face
+	if (block_x == 0 ? BORDER_HAS_PASSTHROUGH(borders, FACE_NEG_X, block_y, block_z) : BLOCK_HAS_PASSTHROUGH(blocks[block_x-1][block_y][block_z]))
+		append_face_to_mesh(mesh, vertex_count, FACE_NEG_X, block_x, block_y, block_z, unit_size, BLOCK_GET_SIDE(block));
+
+	// +x face
+	if (block_x == 15 ? BORDER_HAS_PASSTHROUGH(borders, FACE_POS_X, block_y, block_z) : BLOCK_HAS_PASSTHROUGH(blocks[block_x+1][block_y][block_z]))
+		append_face_to_mesh(mesh, vertex_count, FACE_POS_X, block_x, block_y, block_z, unit_size, BLOCK_GET_SIDE(block));
+
+	// -z face
+	if (block_z == 0 ? BORDER_HAS_PASSTHROUGH(borders, FACE_NEG_Z, block_x, block_y) : BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y][block_z-1]))
+		append_face_to_mesh(mesh, vertex_count, FACE_NEG_Z, block_x, block_y, block_z, unit_size, BLOCK_GET_SIDE(block));
+
+	// +z face
+	if (block_z == 15 ? BORDER_HAS_PASSTHROUGH(borders, FACE_POS_Z, block_x, block_y) : BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y][block_z+1]))
+		append_face_to_mesh(mesh, vertex_count, FACE_POS_Z, block_x, block_y, block_z, unit_size, BLOCK_GET_SIDE(block));
+
+	// -y face
+	if (block_y == 0 ? BORDER_HAS_PASSTHROUGH(borders, FACE_NEG_Y, block_x, block_z) : BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y-1][block_z]))
+		append_face_to_mesh(mesh, vertex_count, FACE_NEG_Y, block_x, block_y, block_z, unit_size, BLOCK_GET_BOTTOM(block));
+
+	// +y face
+	if (block_y == 15 ? BORDER_HAS_PASSTHROUGH(borders, FACE_POS_Y, block_x, block_z) : BLOCK_HAS_PASSTHROUGH(blocks[block_x][block_y+1][block_z]))
+		append_face_to_mesh(mesh, vertex_count, FACE_POS_Y, block_x, block_y, block_z, unit_size, BLOCK_GET_TOP(block));
+}
+
+// works out which faces of the whole chunk are exposed with bitwise ops on occupancy masks, 16 blocks at a time:
+// bit z of masks[face][x][y] is set if the block at (x, y, z) has that face exposed
+static void compute_face_masks(const unsigned char blocks[16][16][16], const unsigned char borders[6][16][16], unsigned short masks[6][16][16]) {
+
+	// bit z of opaque[x + 1][y + 1] is set if the block at (x, y, z) culls faces touching it (and so isn't empty itself)
+	// the outer ring holds the neighboring chunks' border blocks along x and y; the ones along z are single bits at either end
+	unsigned short opaque[18][18] = {0};
+	unsigned short z_neg[16][16] = {0};
+	unsigned short z_pos[16][16] = {0};
+
+	for (int x = 0; x < 16; x++)
+		for (int y = 0; y < 16; y++) {
+
+			unsigned int column = 0;
+
+			for (int z = 0; z < 16; z++) {
+				column |= (unsigned int) !BLOCK_HAS_PASSTHROUGH(blocks[x][y][z]) << z;
+			}
+
+			opaque[x + 1][y + 1] = column;
+		}
+
+	if (borders) {
+
+		for (int a = 0; a < 16; a++)
+			for (int b = 0; b < 16; b++) {
+
+				opaque[0][a + 1]  |= (unsigned int) !BLOCK_HAS_PASSTHROUGH(borders[FACE_NEG_X][a][b]) << b;
+				opaque[17][a + 1] |= (unsigned int) !BLOCK_HAS_PASSTHROUGH(borders[FACE_POS_X][a][b]) << b;
+				opaque[a + 1][0]  |= (unsigned int) !BLOCK_HAS_PASSTHROUGH(borders[FACE_NEG_Y][a][b]) << b;
+				opaque[a + 1][17] |= (unsigned int) !BLOCK_HAS_PASSTHROUGH(borders[FACE_POS_Y][a][b]) << b;
+
+				z_neg[a][b] = !BLOCK_HAS_PASSTHROUGH(borders[FACE_NEG_Z][a][b]);
+				z_pos[a][b] = (unsigned int) !BLOCK_HAS_PASSTHROUGH(borders[FACE_POS_Z][a][b]) << 15;
+			}
+	}
+
+	// a face is exposed where the block is opaque and its neighbor in that direction isn't
+	for (int x = 0; x < 16; x++) {
+
+#ifdef __SSE2__
+
+		// a row of 16 columns is two registers of 8 masks each
+		for (int y = 0; y < 16; y += 8) {
+
+			__m128i self = _mm_loadu_si128((const __m128i *) &opaque[x + 1][y + 1]);
+
+			__m128i neg_x = _mm_loadu_si128((const __m128i *) &opaque[x][y + 1]);
+			__m128i pos_x = _mm_loadu_si128((const __m128i *) &opaque[x + 2][y + 1]);
+			__m128i neg_y = _mm_loadu_si128((const __m128i *) &opaque[x + 1][y]);
+			__m128i pos_y = _mm_loadu_si128((const __m128i *) &opaque[x + 1][y + 2]);
+			__m128i neg_z = _mm_or_si128(_mm_slli_epi16(self, 1), _mm_loadu_si128((const __m128i *) &z_neg[x][y]));
+			__m128i pos_z = _mm_or_si128(_mm_srli_epi16(self, 1), _mm_loadu_si128((const __m128i *) &z_pos[x][y]));
+
+			_mm_storeu_si128((__m128i *) &masks[FACE_NEG_X][x][y], _mm_andnot_si128(neg_x, self));
+			_mm_storeu_si128((__m128i *) &masks[FACE_POS_X][x][y], _mm_andnot_si128(pos_x, self));
+			_mm_storeu_si128((__m128i *) &masks[FACE_NEG_Y][x][y], _mm_andnot_si128(neg_y, self));
+			_mm_storeu_si128((__m128i *) &masks[FACE_POS_Y][x][y], _mm_andnot_si128(pos_y, self));
+			_mm_storeu_si128((__m128i *) &masks[FACE_NEG_Z][x][y], _mm_andnot_si128(neg_z, self));
+			_mm_storeu_si128((__m128i *) &masks[FACE_POS_Z][x][y], _mm_andnot_si128(pos_z, self));
+		}
+
+#else
+
+		for (int y = 0; y < 16; y++) {
+
+			unsigned int self = opaque[x + 1][y + 1];
+
+			masks[FACE_NEG_X][x][y] = self & ~opaque[x][y + 1];
+			masks[FACE_POS_X][x][y] = self & ~opaque[x + 2][y + 1];
+			masks[FACE_NEG_Y][x][y] = self & ~opaque[x + 1][y];
+			masks[FACE_POS_Y][x][y] = self & ~opaque[x + 1][y + 2];
+			masks[FACE_NEG_Z][x][y] = self & ~(self << 1 | z_neg[x][y]);
+			masks[FACE_POS_Z][x][y] = self & ~(self >> 1 | z_pos[x][y]);
+		}
+
+#endif
+	}
+}
+
+// emits exactly what calling append_block_to_mesh on every block would, but only visits blocks with an exposed face
+static void append_masked_faces_to_mesh(EZArray *mesh, int *vertex_count, const unsigned char blocks[16][16][16], const unsigned short masks[6][16][16]) {
+
+	static const int unit_size[3] = {1, 1, 1};
+
+	for (int x = 0; x < 16; x++)
+		for (int y = 0; y < 16; y++) {
+
+			unsigned int exposed = masks[0][x][y] | masks[1][x][y] | masks[2][x][y] | masks[3][x][y] | masks[4][x][y] | masks[5][x][y];
+
+			while (exposed) {
+
+				int z = __builtin_ctz(exposed);
+				exposed &= exposed - 1; // clear lowest set bit
+
+				unsigned char block = blocks[x][y][z];
+
+				for (int face = 0; face < 6; face++) {
+
+					if (masks[face][x][y] >> z & 1)
+						append_face_to_mesh(mesh, vertex_count, face, x, y, z, unit_size, get_face_tile(block, face));
+				}
+			}
+		}
+}
+
+static void append_greedy_faces_to_mesh(EZArray *mesh, int *vertex_count, const unsigned char blocks[16][16][16], const unsigned short masks[6][16][16], int face) {
+
+	// the axis the face points along, and the two axes of the plane it lies in
+	int normal_axis = face == FACE_NEG_X || face == FACE_POS_X ? 0 : (face == FACE_NEG_Y || face == FACE_POS_Y ? 1 : 2);
+	int a_axis = normal_axis == 0 ? 1 : 0;
+	int b_axis = normal_axis == 2 ? 1 : 2;
+
+	for (int slice = 0; slice < 16; slice++) {
+
+		// mask of exposed faces in this slice, as spritemap tile index + 1 (0 = no face)
+		int mask[16][16];
+
+		for (int a = 0; a < 16; a++)
+			for (int b = 0; b < 16; b++) {
+
+				int pos[3];
+				pos[normal_axis] = slice;
+				pos[a_axis] = a;
+				pos[b_axis] = b;
+
+				if (masks[face][pos[0]][pos[1]] >> pos[2] & 1) {
+					mask[a][b] = get_face_tile(blocks[pos[0]][pos[1]][pos[2]], face) + 1;
+				} else {
+					mask[a][b] = 0;
+				}
+			}
+
+		// grab the largest rectangle of matching faces starting from each unclaimed cell (wide along a first, then tall along b)
+		for (int b = 0; b < 16; b++)
+			for (int a = 0; a < 16; a++) {
+
+				int key = mask[a][b];
+
+				if (!key)
+					continue;
+
+				int width = 1;
+
+				while (a + width < 16 && mask[a + width][b] == key) {
+					width++;
+				}
+
+				int height = 1;
+
+				while (b + height < 16) {
+
+					int i;
+
+					for (i = 0; i < width && mask[a + i][b + height] == key; i++);
+
+					if (i < width)
+						break;
+
+					height++;
+				}
+
+				for (int j = 0; j < height; j++)
+					for (int i = 0; i < width; i++)
+						mask[a + i][b + j] = 0;
+
+				int pos[3];
+				pos[normal_axis] = slice;
+				pos[a_axis] = a;
+				pos[b_axis] = b;
+
+				int size[3];
+				size[normal_axis] = 1;
+				size[a_axis] = width;
+				size[b_axis] = height;
+
+				append_face_to_mesh(mesh, vertex_count, face, pos[0], pos[1], pos[2], size, key - 1);
+			}
+	}
+}
+
+void build_chunk_mesh(EZArray *mesh, int *vertex_count, const unsigned char blocks[16][16][16], const unsigned char borders[6][16][16], int mode) {
+
+	if (mode != CHUNK_MESH_PER_FACE_SCALAR) {
+
+		unsigned short masks[6][16][16];
+		compute_face_masks(blocks, borders, masks);
+
+		if (mode == CHUNK_MESH_GREEDY) {
+
+			for (int face = 0; face < 6; face++)
+				append_greedy_faces_to_mesh(mesh, vertex_count, blocks, masks, face);
+
+		} else {
+			append_masked_faces_to_mesh(mesh, vertex_count, blocks, masks);
+		}
+
+		return;
+	}
+
+	for (int x = 0; x < 16; x++)
+		for (int y = 0; y < 16; y++)
+			for (int z = 0; z < 16; z++)
+				append_block_to_mesh(mesh, vertex_count, blocks, borders, x, y, z);
+}
+
+// which faces of the chunk can see each other through its empty space: bit b of connections[a] is set if a path of
+// passthrough blocks links face a to face b (used to skip chunks hidden behind solid ones, see culling.c)
+void compute_chunk_connectivity(const unsigned char blocks[16][16][16], unsigned char connections[6]) {
+
+	memset(connections, 0, 6);
+
+	// cells are numbered x * 256 + y * 16 + z, same as the blocks array
+	const unsigned char *cells = &blocks[0][0][0];
+
+	unsigned char visited[16 * 16 * 16] = {0};
+	unsigned short stack[16 * 16 * 16];
+
+	for (int start = 0; start < 16 * 16 * 16; start++) {
+
+		if (visited[start] || !BLOCK_HAS_PASSTHROUGH(cells[start]))
+			continue;
+
+		// flood fill this pocket of empty space, noting which faces it touches
+		int faces = 0;
+		int stack_size = 0;
+
+		stack[stack_size++] = start;
+		visited[start] = TRUE;
+
+		while (stack_size) {
+
+			int cell = stack[--stack_size];
+			int x = cell >> 8;
+			int y = (cell >> 4) & 15;
+			int z = cell & 15;
+
+			if (x == 0)  faces |= 1 << FACE_NEG_X;
+			if (x == 15) faces |= 1 << FACE_POS_X;
+			if (y == 0)  faces |= 1 << FACE_NEG_Y;
+			if (y == 15) faces |= 1 << FACE_POS_Y;
+			if (z == 0)  faces |= 1 << FACE_NEG_Z;
+			if (z == 15) faces |= 1 << FACE_POS_Z;
+
+			int neighbors[6] = {
+				x > 0  ? cell - 256 : -1,
+				x < 15 ? cell + 256 : -1,
+				y > 0  ? cell - 16 : -1,
+				y < 15 ? cell + 16 : -1,
+				z > 0  ? cell - 1 : -1,
+				z < 15 ? cell + 1 : -1,
+			};
+
+			for (int i = 0; i < 6; i++) {
+
+				int neighbor = neighbors[i];
+
+				if (neighbor != -1 && !visited[neighbor] && BLOCK_HAS_PASSTHROUGH(cells[neighbor])) {
+					visited[neighbor] = TRUE;
+					stack[stack_size++] = neighbor;
+				}
+			}
+		}
+
+		for (int face = 0; face < 6; face++) {
+
+			if (faces >> face & 1)
+				connections[face] |= faces;
+		}
+	}
+}
+
+#endif
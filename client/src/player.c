@@ -0,0 +1,102 @@
+#ifndef PLAYER_DEFINED
+
+#define PLAYER_DEFINED
+
+#include "../../util.c"
+#include "world.c"
+
+// player movement, advanced one fixed tick at a time
+// deliberately knows nothing about OpenGL or SDL, so it can be run headless (e.g. by benchmarks or a server)
+
+#define PLAYER_SIZE 0.2 // half-width of the player's collision cube
+
+typedef struct {
+
+	int left;
+	int right;
+	int forward;
+	int backward;
+	int up;
+	int down;
+
+} PlayerInput;
+
+typedef struct {
+
+	float x; // camera space (z flipped relative to block coordinates)
+	float y;
+	float z;
+	float pitch;
+	float yaw;
+
+} Player;
+
+#define PLAYER_SPEED 0.1 // blocks per tick along each input direction
+#define PLAYER_REACH 6   // how far away blocks can be picked, in blocks
+
+// the player's collision box, in block coordinates
+AABB get_player_aabb(const Player *player) {
+
+	AABB box = {
+		{player->x - PLAYER_SIZE, player->y - PLAYER_SIZE, -player->z - PLAYER_SIZE},
+		{player->x + PLAYER_SIZE, player->y + PLAYER_SIZE, -player->z + PLAYER_SIZE}
+	};
+
+	return box;
+}
+
+// unit vector the camera looks along, in block coordinates
+void get_player_look_direction(const Player *player, float direction[3]) {
+
+	direction[0] = sin(player->yaw) * cos(player->pitch);
+	direction[1] = -sin(player->pitch);
+	direction[2] = cos(player->yaw) * cos(player->pitch);
+}
+
+// finds the block the player is looking at, returns FALSE if there's none within reach
+int pick_player_block(const Player *player, const World *world, RaycastHit *hit) {
+
+	float eye[3] = {player->x, player->y, -player->z};
+	float direction[3];
+
+	get_player_look_direction(player, direction);
+
+	return raycast_blocks(world, eye, direction, PLAYER_REACH, hit);
+}
+
+// moves the player one tick in the direction of input, sliding along any blocks in the way
+void tick_player(Player *player, const PlayerInput *input, const World *world) {
+
+	float motion[3] = {0, 0, 0}; // block coordinates, so z is flipped from the camera's
+
+	if (input->left) {
+		motion[0] -= cos(player->yaw) * PLAYER_SPEED;
+		motion[2] += sin(player->yaw) * PLAYER_SPEED;
+	} else if (input->right) {
+		motion[0] += cos(player->yaw) * PLAYER_SPEED;
+		motion[2] -= sin(player->yaw) * PLAYER_SPEED;
+	}
+
+	if (input->forward) {
+		motion[0] += sin(player->yaw) * PLAYER_SPEED;
+		motion[2] += cos(player->yaw) * PLAYER_SPEED;
+	} else if (input->backward) {
+		motion[0] -= sin(player->yaw) * PLAYER_SPEED;
+		motion[2] -= cos(player->yaw) * PLAYER_SPEED;
+	}
+
+	if (input->up) {
+		motion[1] += PLAYER_SPEED;
+	} else if (input->down) {
+		motion[1] -= PLAYER_SPEED;
+	}
+
+	AABB box = get_player_aabb(player);
+	move_aabb(world, &box, motion);
+
+	player->x += motion[0];
+	player->y += motion[1];
+	player->z -= motion[2];
+}
+
+#endif
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include "../../util.c"
+
+// lightweight frame profiler: CPU time spent in named scopes, GPU time per frame (via timer queries), and a few
+// per-frame counters, kept for the last PROFILER_FRAMES frames
+// everything here compiles out in release builds (NDEBUG), with the PROFILE_* macros turning into nothing
+
+#ifndef NDEBUG
+#define PROFILER_ENABLED
+#endif
+
+#define PROFILER_FRAMES 512
+#define PROFILER_GPU_QUERIES 4 // GPU results come back a few frames late, so queries are cycled instead of waited on
+                               // (a frame whose query is still out goes untimed)
+
+// scopes, in the order (and nesting) they happen in a frame
+#define PROFILE_EVENTS  0
+#define PROFILE_TICK    1
+#define PROFILE_MESHING 2 // inside PROFILE_TICK
+#define PROFILE_UPLOAD  3
+#define PROFILE_CULL    4
+#define PROFILE_DRAW    5
+#define PROFILE_SWAP    6
+#define PROFILE_SCOPE_COUNT 7
+
+#define PROFILE_TICKS                   0
+#define PROFILE_CHUNKS_CONSIDERED       1
+#define PROFILE_CHUNKS_FRUSTUM_CULLED   2
+#define PROFILE_CHUNKS_OCCLUSION_CULLED 3
+#define PROFILE_CHUNKS_DRAWN            4
+#define PROFILE_COUNTER_COUNT 5
+
+#ifdef PROFILER_ENABLED
+
+static const char *profile_scope_names[PROFILE_SCOPE_COUNT] = {
+	"events", "tick", "meshing", "upload", "cull", "draw", "swap"
+};
+
+static const int profile_scope_depths[PROFILE_SCOPE_COUNT] = {
+	0, 0, 1, 0, 0, 0, 0
+};
+
+static const char *profile_counter_names[PROFILE_COUNTER_COUNT] = {
+	"ticks", "chunks_considered", "chunks_frustum_culled", "chunks_occlusion_culled", "chunks_drawn"
+};
+
+typedef struct {
+
+	float frame_ms; // start of this frame to start of the next
+	float gpu_ms;   // -1 until the timer query comes back
+	float scope_ms[PROFILE_SCOPE_COUNT];
+	int counters[PROFILE_COUNTER_COUNT];
+
+} ProfileFrame;
+
+typedef struct {
+
+	ProfileFrame frames[PROFILER_FRAMES]; // ring buffer, indexed by frame_number % PROFILER_FRAMES
+	unsigned int frame_number;            // the frame being recorded
+
+	Uint64 frame_start;
+	Uint64 scope_starts[PROFILE_SCOPE_COUNT];
+
+	GLuint gpu_queries[PROFILER_GPU_QUERIES];
+	unsigned int gpu_query_frames[PROFILER_GPU_QUERIES]; // frame each query was issued in
+	int gpu_query_pending[PROFILER_GPU_QUERIES];
+	int gpu_query_running; // whether this frame got a query (FALSE if the GPU was too far behind)
+
+} Profiler;
+
+static Profiler profiler;
+
+static float counter_to_ms(Uint64 counter) {
+	return counter * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void initialize_profiler() {
+
+	memset(&profiler, 0, sizeof(profiler));
+	glGenQueries(PROFILER_GPU_QUERIES, profiler.gpu_queries);
+
+	profiler.frame_start = SDL_GetPerformanceCounter();
+	profiler.frames[0].gpu_ms = -1;
+}
+
+void free_profiler() {
+	glDeleteQueries(PROFILER_GPU_QUERIES, profiler.gpu_queries);
+}
+
+void profile_begin(int scope) {
+	profiler.scope_starts[scope] = SDL_GetPerformanceCounter();
+}
+
+// scopes can be entered more than once a frame (e.g. a tick per frame), their times add up
+void profile_end(int scope) {
+	profiler.frames[profiler.frame_number % PROFILER_FRAMES].scope_ms[scope] += counter_to_ms(SDL_GetPerformanceCounter() - profiler.scope_starts[scope]);
+}
+
+void profile_count(int counter, int amount) {
+	profiler.frames[profiler.frame_number % PROFILER_FRAMES].counters[counter] += amount;
+}
+
+void profile_gpu_begin() {
+
+	int query = profiler.frame_number % PROFILER_GPU_QUERIES;
+
+	// the GPU is more than PROFILER_GPU_QUERIES frames behind, so rather than wait on it this frame's gpu_ms stays -1
+	// (the query is left alone, its result is still collected when it comes back)
+	profiler.gpu_query_running = !profiler.gpu_query_pending[query];
+
+	if (!profiler.gpu_query_running)
+		return;
+
+	glBeginQuery(GL_TIME_ELAPSED, profiler.gpu_queries[query]);
+	profiler.gpu_query_frames[query] = profiler.frame_number;
+}
+
+void profile_gpu_end() {
+
+	if (!profiler.gpu_query_running)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	profiler.gpu_query_pending[profiler.frame_number % PROFILER_GPU_QUERIES] = TRUE;
+	profiler.gpu_query_running = FALSE;
+}
+
+// collects whatever GPU results are ready without waiting on any
+static void collect_gpu_queries() {
+
+	for (int i = 0; i < PROFILER_GPU_QUERIES; i++) {
+
+		if (!profiler.gpu_query_pending[i])
+			continue;
+
+		GLint available;
+		glGetQueryObjectiv(profiler.gpu_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available)
+			continue;
+
+		GLuint64 nanoseconds;
+		glGetQueryObjectui64v(profiler.gpu_queries[i], GL_QUERY_RESULT, &nanoseconds);
+		profiler.gpu_query_pending[i] = FALSE;
+
+		// (unless the frame has already been overwritten in the ring buffer)
+		if (profiler.frame_number - profiler.gpu_query_frames[i] < PROFILER_FRAMES)
+			profiler.frames[profiler.gpu_query_frames[i] % PROFILER_FRAMES].gpu_ms = nanoseconds / 1000000.0;
+	}
+}
+
+// call at the very start of each frame, finishing off the previous one
+void profile_frame() {
+
+	Uint64 now = SDL_GetPerformanceCounter();
+
+	profiler.frames[profiler.frame_number % PROFILER_FRAMES].frame_ms = counter_to_ms(now - profiler.frame_start);
+	profiler.frame_start = now;
+
+	collect_gpu_queries();
+
+	profiler.frame_number++;
+
+	ProfileFrame *frame = &profiler.frames[profiler.frame_number % PROFILER_FRAMES];
+	memset(frame, 0, sizeof(ProfileFrame));
+	frame->gpu_ms = -1;
+}
+
+static int compare_floats(const void *a, const void *b) {
+
+	float float_a = *(const float *) a;
+	float float_b = *(const float *) b;
+
+	return (float_a > float_b) - (float_a < float_b);
+}
+
+// sorts values in place and returns the value at the given percentile (0 to 100), or 0 if there are none
+static float get_percentile(float *values, int count, int percentile) {
+
+	if (count == 0)
+		return 0;
+
+	qsort(values, count, sizeof(float), compare_floats);
+
+	return values[(count - 1) * percentile / 100];
+}
+
+// finished frames in the ring buffer, oldest first (the current frame is still being recorded, so it's left out)
+static int get_profiled_frames(const ProfileFrame **frames) {
+
+	int count = profiler.frame_number < PROFILER_FRAMES - 1 ? profiler.frame_number : PROFILER_FRAMES - 1;
+
+	for (int i = 0; i < count; i++) {
+		frames[i] = &profiler.frames[(profiler.frame_number - count + i) % PROFILER_FRAMES];
+	}
+
+	return count;
+}
+
+static void print_profile_line(const char *name, int depth, float *values, int count) {
+
+	// percentiles sort values, so the mean has to come first
+	float mean = 0;
+
+	for (int i = 0; i < count; i++) {
+		mean += values[i];
+	}
+
+	mean = count ? mean / count : 0;
+
+	printf("%*s%-*s %8.3f %8.3f %8.3f %8.3f\n", depth * 2, "", 12 - depth * 2, name,
+		mean, get_percentile(values, count, 50), get_percentile(values, count, 99), count ? values[count - 1] : 0);
+}
+
+// prints mean/p50/p99/max for the frame, every scope and the GPU over the frames in the ring buffer
+void print_profile_summary() {
+
+	const ProfileFrame *frames[PROFILER_FRAMES];
+	int count = get_profiled_frames(frames);
+
+	float values[PROFILER_FRAMES];
+
+	printf("\nlast %d frames (ms)  mean      p50      p99      max\n", count);
+
+	for (int i = 0; i < count; i++) {
+		values[i] = frames[i]->frame_ms;
+	}
+
+	print_profile_line("frame", 0, values, count);
+
+	for (int scope = 0; scope < PROFILE_SCOPE_COUNT; scope++) {
+
+		for (int i = 0; i < count; i++) {
+			values[i] = frames[i]->scope_ms[scope];
+		}
+
+		print_profile_line(profile_scope_names[scope], profile_scope_depths[scope] + 1, values, count);
+	}
+
+	int gpu_count = 0;
+
+	for (int i = 0; i < count; i++) {
+
+		if (frames[i]->gpu_ms >= 0)
+			values[gpu_count++] = frames[i]->gpu_ms;
+	}
+
+	print_profile_line("gpu", 0, values, gpu_count);
+
+	for (int counter = 0; counter < PROFILE_COUNTER_COUNT; counter++) {
+
+		float mean = 0;
+
+		for (int i = 0; i < count; i++) {
+			mean += frames[i]->counters[counter];
+		}
+
+		printf("%s: %.1f per frame\n", profile_counter_names[counter], count ? mean / count : 0);
+	}
+}
+
+// writes every frame in the ring buffer as a row of CSV, returns FALSE on error
+int write_profile_csv(const char *path) {
+
+	FILE *file = fopen(path, "w");
+
+	if (!file)
+		return FALSE;
+
+	fprintf(file, "frame,frame_ms,gpu_ms");
+
+	for (int scope = 0; scope < PROFILE_SCOPE_COUNT; scope++) {
+		fprintf(file, ",%s_ms", profile_scope_names[scope]);
+	}
+
+	for (int counter = 0; counter < PROFILE_COUNTER_COUNT; counter++) {
+		fprintf(file, ",%s", profile_counter_names[counter]);
+	}
+
+	fprintf(file, "\n");
+
+	const ProfileFrame *frames[PROFILER_FRAMES];
+	int count = get_profiled_frames(frames);
+
+	for (int i = 0; i < count; i++) {
+
+		fprintf(file, "%u,%.4f,%.4f", profiler.frame_number - count + i, frames[i]->frame_ms, frames[i]->gpu_ms);
+
+		for (int scope = 0; scope < PROFILE_SCOPE_COUNT; scope++) {
+			fprintf(file, ",%.4f", frames[i]->scope_ms[scope]);
+		}
+
+		for (int counter = 0; counter < PROFILE_COUNTER_COUNT; counter++) {
+			fprintf(file, ",%d", frames[i]->counters[counter]);
+		}
+
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+
+	return TRUE;
+}
+
+#define PROFILE_BEGIN(scope) profile_begin(scope)
+#define PROFILE_END(scope) profile_end(scope)
+#define PROFILE_COUNT(counter, amount) profile_count(counter, amount)
+#define PROFILE_GPU_BEGIN() profile_gpu_begin()
+#define PROFILE_GPU_END() profile_gpu_end()
+#define PROFILE_FRAME() profile_frame()
+
+#else
+
+#define PROFILE_BEGIN(scope)
+#define PROFILE_END(scope)
+#define PROFILE_COUNT(counter, amount)
+#define PROFILE_GPU_BEGIN()
+#define PROFILE_GPU_END()
+#define PROFILE_FRAME()
+
+#endif
@@ -0,0 +1,646 @@
+#ifndef REGION_DEFINED
+
+#define REGION_DEFINED
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../../util.c"
+#include "../../chunk_format.c"
+
+// saves chunks to disk, in region files of REGION_SIZE x REGION_SIZE chunks (one chunk tall), each file being:
+//   a header of REGION_SIZE^2 entries (uint32 first sector, uint32 length in bytes, little endian; sector 0 = not saved)
+//   then the chunks, each in ../../chunk_format.c's format (with LZ) starting on a REGION_SECTOR_SIZE boundary
+// a chunk is never written over in place: each save goes to the first free run of sectors big enough (so files only grow
+// when they have to), and its old sectors are only given up once the header pointing away from them is on disk, so a
+// crash at any point leaves every chunk either as it was or as it was saved
+// loads read straight out of a read-only mapping of the file; saves are queued (the newest save of a chunk replacing
+// any older one still waiting) and written by a background thread in batches (every chunk, sync, every header entry,
+// sync), so whoever saves never waits on the disk (saves that haven't been written yet are loaded from the queue)
+// chunks should only be loaded from one thread (which owns the mappings), but saves can come from anywhere
+
+#define REGION_SHIFT 4
+#define REGION_SIZE (1 << REGION_SHIFT)
+#define REGION_SECTOR_SIZE 512
+#define REGION_HEADER_SIZE (REGION_SIZE * REGION_SIZE * 8)
+#define REGION_HEADER_SECTORS (REGION_HEADER_SIZE / REGION_SECTOR_SIZE)
+#define REGION_FLUSH_DELAY 1 // seconds a save waits for others to batch with
+
+#define CHUNK_TO_REGION(coord) ((coord) >> REGION_SHIFT)
+#define CHUNK_TO_REGION_INDEX(x, z) (((z) & (REGION_SIZE - 1)) << REGION_SHIFT | ((x) & (REGION_SIZE - 1)))
+
+typedef struct Region {
+
+	int x, y, z; // region coordinates (chunk x and z / REGION_SIZE, chunk y)
+
+	int descriptor; // -1 if the file couldn't be opened (or doesn't exist yet)
+	int missing;    // the file didn't exist last time it was looked for (loads don't look again, saves create it)
+
+	// loading side
+	const unsigned char *map;
+	size_t map_length;
+
+	// writing side: the header as written, and which sectors are taken
+	uint32_t header[REGION_SIZE * REGION_SIZE][2];
+	unsigned char *used_sectors;
+	int sector_count;
+	int touched; // written to since it was last synced
+	int created; // the file's new, so the directory needs syncing too for it to be there after a crash
+	int failed;  // its last sync didn't work, so what was written before it can't be counted on
+
+	struct Region *next;
+
+} Region;
+
+typedef struct {
+
+	int x, y, z;
+	unsigned char *data; // encoded
+	int length;
+
+	// where the writer put it, and where it was before (filled in while it's being written)
+	Region *region;
+	uint32_t start;
+	uint32_t old_start;
+	uint32_t old_length;
+
+} RegionSave;
+
+typedef struct {
+
+	char *directory;
+
+	Region *regions; // every region looked at so far (only a few around the player at a time)
+
+	// saves waiting for the next batch, and the batch being written
+	RegionSave *pending;
+	int pending_count;
+	int pending_capacity;
+
+	RegionSave *writing;
+	int writing_count;
+	int writing_capacity;
+
+	long chunks_written;
+	long batches_written;
+	long files_synced;
+
+	// guards everything above except the regions' loading and writing sides
+	pthread_mutex_t mutex;
+	pthread_cond_t saves_available;
+	pthread_cond_t saves_written;
+	int flushing;
+	int stopping;
+
+	pthread_t thread;
+
+} RegionStore;
+
+static inline void put_region_uint(unsigned char *data, uint32_t value) {
+
+	data[0] = value;
+	data[1] = value >> 8;
+	data[2] = value >> 16;
+	data[3] = value >> 24;
+}
+
+static inline uint32_t get_region_uint(const unsigned char *data) {
+
+	return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+static void mark_region_sectors(Region *region, int start, int count, unsigned char used) {
+
+	if (start + count > region->sector_count) {
+
+		int sector_count = region->sector_count ? region->sector_count : 64;
+
+		while (sector_count < start + count) {
+			sector_count *= 2;
+		}
+
+		region->used_sectors = realloc(region->used_sectors, sector_count);
+		memset(region->used_sectors + region->sector_count, 0, sector_count - region->sector_count);
+		region->sector_count = sector_count;
+	}
+
+	memset(region->used_sectors + start, used, count);
+}
+
+// must hold the store's mutex, which is let go of while the file's opened and its header read (so nobody waits on the
+// disk behind this); returns the region even if its file couldn't be opened (descriptor -1)
+static Region *get_region(RegionStore *store, int x, int y, int z, int create) {
+
+	Region *region = store->regions;
+
+	while (region && (region->x != x || region->y != y || region->z != z)) {
+		region = region->next;
+	}
+
+	if (!region) {
+
+		region = calloc(1, sizeof(Region));
+		region->x = x;
+		region->y = y;
+		region->z = z;
+		region->descriptor = -1;
+
+		region->next = store->regions;
+		store->regions = region;
+	}
+
+	if (region->descriptor != -1 || (region->missing && !create))
+		return region;
+
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/r.%d.%d.%d.region", store->directory, x, y, z);
+
+	pthread_mutex_unlock(&store->mutex);
+
+	int descriptor = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+	int open_error = errno;
+	int created = FALSE;
+
+	unsigned char header[REGION_HEADER_SIZE] = {0};
+	struct stat status = {0};
+
+	if (descriptor != -1) {
+
+		if (fstat(descriptor, &status) == -1 || status.st_size < REGION_HEADER_SIZE) {
+
+			// (a new file is all header, all empty, but only saving makes one: a short file someone else left is just
+			// read as empty)
+			if (create) {
+
+				if (ftruncate(descriptor, REGION_HEADER_SIZE) == -1)
+					fprintf(stderr, "Could not create region file %s\n", path);
+
+				created = TRUE;
+			}
+
+		} else if (pread(descriptor, header, REGION_HEADER_SIZE, 0) != REGION_HEADER_SIZE) {
+
+			fprintf(stderr, "Could not read region file %s\n", path);
+			memset(header, 0, REGION_HEADER_SIZE);
+		}
+	}
+
+	pthread_mutex_lock(&store->mutex);
+
+	// (opened by someone else in the meantime)
+	if (region->descriptor != -1) {
+
+		if (descriptor != -1)
+			close(descriptor);
+
+		return region;
+	}
+
+	if (descriptor == -1) {
+
+		if (open_error == ENOENT) {
+			region->missing = TRUE;
+		} else {
+			fprintf(stderr, "Could not open region file %s\n", path);
+		}
+
+		return region;
+	}
+
+	region->descriptor = descriptor;
+	region->missing = FALSE;
+	region->created = created;
+
+	mark_region_sectors(region, 0, REGION_HEADER_SECTORS, TRUE);
+
+	for (int i = 0; i < REGION_SIZE * REGION_SIZE; i++) {
+
+		uint32_t start = get_region_uint(header + i * 8);
+		uint32_t length = get_region_uint(header + i * 8 + 4);
+
+		// entries pointing into the header or past the end of the file are garbage, and get dropped
+		if (!start || start < REGION_HEADER_SECTORS || (uint64_t) start * REGION_SECTOR_SIZE + length > (uint64_t) status.st_size)
+			continue;
+
+		region->header[i][0] = start;
+		region->header[i][1] = length;
+
+		mark_region_sectors(region, start, (length + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, TRUE);
+	}
+
+	return region;
+}
+
+// maps the whole file again, since it's grown; returns FALSE on error
+static int map_region(Region *region) {
+
+	if (region->map)
+		munmap((void *) region->map, region->map_length);
+
+	region->map = NULL;
+	region->map_length = 0;
+
+	struct stat status;
+
+	if (fstat(region->descriptor, &status) == -1 || status.st_size < REGION_HEADER_SIZE)
+		return FALSE;
+
+	void *map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, region->descriptor, 0);
+
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	region->map = map;
+	region->map_length = status.st_size;
+
+	return TRUE;
+}
+
+static RegionSave *find_region_save(RegionSave *saves, int count, int x, int y, int z) {
+
+	for (int i = 0; i < count; i++) {
+
+		if (saves[i].x == x && saves[i].y == y && saves[i].z == z)
+			return &saves[i];
+	}
+
+	return NULL;
+}
+
+// writes a chunk into free sectors (never the ones it's in now, which stay taken until its header entry points away from
+// them and is on disk), returns FALSE on error
+static int write_region_chunk(Region *region, RegionSave *save) {
+
+	int index = CHUNK_TO_REGION_INDEX(save->x, save->z);
+	int sectors = (save->length + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+
+	// first fit
+	uint32_t start;
+	int run = 0;
+
+	for (start = REGION_HEADER_SECTORS; start < (uint32_t) region->sector_count && run < sectors; start++) {
+		run = region->used_sectors[start] ? 0 : run + 1;
+	}
+
+	start -= run;
+	mark_region_sectors(region, start, sectors, TRUE);
+
+	if (pwrite(region->descriptor, save->data, save->length, (off_t) start * REGION_SECTOR_SIZE) != save->length) {
+
+		fprintf(stderr, "Could not save chunk %d, %d, %d\n", save->x, save->y, save->z);
+		mark_region_sectors(region, start, sectors, FALSE);
+
+		return FALSE;
+	}
+
+	save->region = region;
+	save->start = start;
+	save->old_start = region->header[index][0];
+	save->old_length = region->header[index][1];
+	region->touched = TRUE;
+
+	return TRUE;
+}
+
+// points the chunk's header entry at where write_region_chunk put it (which has to be on disk first), returns FALSE on
+// error (leaving the entry where it was)
+static int write_region_header_entry(RegionSave *save) {
+
+	Region *region = save->region;
+	int index = CHUNK_TO_REGION_INDEX(save->x, save->z);
+
+	unsigned char entry[8];
+	put_region_uint(entry, save->start);
+	put_region_uint(entry + 4, save->length);
+
+	if (pwrite(region->descriptor, entry, 8, index * 8) != 8) {
+
+		fprintf(stderr, "Could not save chunk %d, %d, %d\n", save->x, save->y, save->z);
+		mark_region_sectors(region, save->start, (save->length + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, FALSE);
+
+		return FALSE;
+	}
+
+	region->header[index][0] = save->start;
+	region->header[index][1] = save->length;
+	region->touched = TRUE;
+
+	return TRUE;
+}
+
+// syncs every region from regions on that's been written to since it was last synced (and the directory, if any of them
+// are new files), setting failed on the ones that didn't make it to disk; returns how many files it synced
+static int sync_region_files(const RegionStore *store, Region *regions) {
+
+	int synced = 0;
+	int created = FALSE;
+
+	for (Region *region = regions; region; region = region->next) {
+
+		if (region->touched) {
+
+			region->failed = fdatasync(region->descriptor) == -1;
+			region->touched = FALSE;
+			synced++;
+
+			if (region->failed)
+				fprintf(stderr, "Could not sync region file %d, %d, %d\n", region->x, region->y, region->z);
+		}
+
+		created |= region->created;
+	}
+
+	if (!created)
+		return synced;
+
+	int directory = open(store->directory, O_RDONLY | O_DIRECTORY);
+	int directory_synced = directory != -1 && fsync(directory) == 0;
+
+	if (directory != -1)
+		close(directory);
+
+	if (!directory_synced)
+		fprintf(stderr, "Could not sync %s\n", store->directory);
+
+	// (a new file that isn't in the directory on disk yet is as good as not written, and gets another try next time)
+	for (Region *region = regions; region; region = region->next) {
+
+		if (region->created) {
+			region->failed |= !directory_synced;
+			region->created = !directory_synced;
+		}
+	}
+
+	return synced + 1;
+}
+
+static void *run_region_writer(void *arg) {
+
+	RegionStore *store = arg;
+
+	pthread_mutex_lock(&store->mutex);
+
+	while (TRUE) {
+
+		while (!store->pending_count && !store->stopping) {
+			pthread_cond_wait(&store->saves_available, &store->mutex);
+		}
+
+		if (!store->pending_count)
+			break;
+
+		// gives the first save of a batch a while for others to join it (unless someone's waiting on it)
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += REGION_FLUSH_DELAY;
+
+		while (!store->stopping && !store->flushing && pthread_cond_timedwait(&store->saves_available, &store->mutex, &deadline) != ETIMEDOUT);
+
+		// takes the whole queue as the batch (loads still find it in writing until it's on disk)
+		RegionSave *saves = store->writing;
+		int capacity = store->writing_capacity;
+
+		store->writing = store->pending;
+		store->writing_count = store->pending_count;
+		store->writing_capacity = store->pending_capacity;
+
+		store->pending = saves;
+		store->pending_count = 0;
+		store->pending_capacity = capacity;
+
+		for (int i = 0; i < store->writing_count; i++) {
+
+			RegionSave *save = &store->writing[i];
+			Region *region = get_region(store, CHUNK_TO_REGION(save->x), save->y, CHUNK_TO_REGION(save->z), TRUE);
+
+			save->region = NULL;
+
+			if (region->descriptor == -1)
+				continue;
+
+			pthread_mutex_unlock(&store->mutex);
+			write_region_chunk(region, save);
+			pthread_mutex_lock(&store->mutex);
+		}
+
+		// (regions only ever get added in front of this, so it's safe to walk from here unlocked)
+		Region *regions = store->regions;
+
+		pthread_mutex_unlock(&store->mutex);
+
+		int synced = sync_region_files(store, regions);
+
+		for (int i = 0; i < store->writing_count; i++) {
+
+			RegionSave *save = &store->writing[i];
+
+			// chunks that might not be on disk keep their old header entries (and give up the sectors they were written to)
+			if (save->region && save->region->failed) {
+				mark_region_sectors(save->region, save->start, (save->length + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, FALSE);
+				save->region = NULL;
+			}
+
+			if (save->region && !write_region_header_entry(save))
+				save->region = NULL;
+		}
+
+		synced += sync_region_files(store, regions);
+
+		// the header's on disk, so nothing points at the old sectors anymore (if it might not be, they're kept, since it
+		// might still point at them)
+		for (int i = 0; i < store->writing_count; i++) {
+
+			const RegionSave *save = &store->writing[i];
+
+			if (save->region && !save->region->failed && save->old_start)
+				mark_region_sectors(save->region, save->old_start, (save->old_length + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, FALSE);
+		}
+
+		pthread_mutex_lock(&store->mutex);
+
+		for (int i = 0; i < store->writing_count; i++) {
+			free(store->writing[i].data);
+		}
+
+		store->chunks_written += store->writing_count;
+		store->batches_written++;
+		store->files_synced += synced;
+		store->writing_count = 0;
+
+		pthread_cond_broadcast(&store->saves_written);
+	}
+
+	pthread_mutex_unlock(&store->mutex);
+
+	return NULL;
+}
+
+// the directory is made if it isn't there; returns FALSE on error
+int initialize_region_store(RegionStore *store, const char *directory) {
+
+	memset(store, 0, sizeof(RegionStore));
+
+	if (mkdir(directory, 0755) == -1 && errno != EEXIST)
+		return FALSE;
+
+	store->directory = malloc(strlen(directory) + 1);
+	strcpy(store->directory, directory);
+
+	pthread_mutex_init(&store->mutex, NULL);
+	pthread_cond_init(&store->saves_available, NULL);
+	pthread_cond_init(&store->saves_written, NULL);
+
+	if (pthread_create(&store->thread, NULL, run_region_writer, store) != 0) {
+
+		pthread_mutex_destroy(&store->mutex);
+		pthread_cond_destroy(&store->saves_available);
+		pthread_cond_destroy(&store->saves_written);
+		free(store->directory);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// returns TRUE and fills in blocks if the chunk has been saved, FALSE if it hasn't (or couldn't be read)
+int load_region_chunk(RegionStore *store, int x, int y, int z, unsigned char blocks[16][16][16]) {
+
+	pthread_mutex_lock(&store->mutex);
+
+	// newest first
+	RegionSave *save = find_region_save(store->pending, store->pending_count, x, y, z);
+
+	if (!save)
+		save = find_region_save(store->writing, store->writing_count, x, y, z);
+
+	if (save) {
+
+		int loaded = decode_chunk(save->data, save->length, blocks);
+		pthread_mutex_unlock(&store->mutex);
+
+		return loaded;
+	}
+
+	Region *region = get_region(store, CHUNK_TO_REGION(x), y, CHUNK_TO_REGION(z), FALSE);
+	int loaded = FALSE;
+
+	if (region->descriptor != -1 && (region->map || map_region(region))) {
+
+		int index = CHUNK_TO_REGION_INDEX(x, z);
+		uint64_t start = (uint64_t) get_region_uint(region->map + index * 8) * REGION_SECTOR_SIZE;
+		uint32_t length = get_region_uint(region->map + index * 8 + 4);
+
+		// (saved since the file was mapped, past the end of the mapping)
+		if (start >= REGION_HEADER_SIZE && start + length > region->map_length)
+			map_region(region);
+
+		if (start >= REGION_HEADER_SIZE && start + length <= region->map_length && length <= MAX_ENCODED_CHUNK_SIZE)
+			loaded = decode_chunk(region->map + start, length, blocks);
+	}
+
+	pthread_mutex_unlock(&store->mutex);
+
+	return loaded;
+}
+
+// never waits on the disk: the chunk's written in the background, with whatever else gets saved in the meantime
+void save_region_chunk(RegionStore *store, int x, int y, int z, const unsigned char blocks[16][16][16]) {
+
+	unsigned char encoded[MAX_ENCODED_CHUNK_SIZE];
+	int length = encode_chunk(blocks, TRUE, encoded);
+
+	unsigned char *data = malloc(length);
+	memcpy(data, encoded, length);
+
+	pthread_mutex_lock(&store->mutex);
+
+	RegionSave *save = find_region_save(store->pending, store->pending_count, x, y, z);
+
+	if (save) {
+
+		free(save->data);
+
+	} else {
+
+		if (store->pending_count == store->pending_capacity) {
+			store->pending_capacity = store->pending_capacity ? store->pending_capacity * 2 : 64;
+			store->pending = realloc(store->pending, sizeof(RegionSave) * store->pending_capacity);
+		}
+
+		save = &store->pending[store->pending_count++];
+		save->x = x;
+		save->y = y;
+		save->z = z;
+
+		if (store->pending_count == 1)
+			pthread_cond_signal(&store->saves_available);
+	}
+
+	save->data = data;
+	save->length = length;
+
+	pthread_mutex_unlock(&store->mutex);
+}
+
+// writes everything saved so far right away, and waits until it's on disk
+void flush_region_store(RegionStore *store) {
+
+	pthread_mutex_lock(&store->mutex);
+
+	store->flushing = TRUE;
+	pthread_cond_signal(&store->saves_available);
+
+	while (store->pending_count || store->writing_count) {
+		pthread_cond_wait(&store->saves_written, &store->mutex);
+	}
+
+	store->flushing = FALSE;
+
+	pthread_mutex_unlock(&store->mutex);
+}
+
+// writes anything still waiting first (only for stores that initialized)
+void free_region_store(RegionStore *store) {
+
+	pthread_mutex_lock(&store->mutex);
+	store->stopping = TRUE;
+	pthread_cond_signal(&store->saves_available);
+	pthread_mutex_unlock(&store->mutex);
+
+	pthread_join(store->thread, NULL);
+
+	while (store->regions) {
+
+		Region *next = store->regions->next;
+
+		if (store->regions->map)
+			munmap((void *) store->regions->map, store->regions->map_length);
+
+		if (store->regions->descriptor != -1)
+			close(store->regions->descriptor);
+
+		free(store->regions->used_sectors);
+		free(store->regions);
+
+		store->regions = next;
+	}
+
+	free(store->pending);
+	free(store->writing);
+	free(store->directory);
+
+	pthread_mutex_destroy(&store->mutex);
+	pthread_cond_destroy(&store->saves_available);
+	pthread_cond_destroy(&store->saves_written);
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef RESOURCE_PACK_DEFINED
+
+#define RESOURCE_PACK_DEFINED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../../util.c"
+
+// the resource pack is one binary file, written by client/res/resloader.c and mmapped by the client:
+// a header, a table of contents, then each resource's data, already in the exact layout OpenGL wants, starting on an
+// RESOURCE_PACK_ALIGNMENT boundary (so the client can hand pointers into the mapping straight to glBufferData/glTexImage2D)
+
+#define RESOURCE_PACK_MAGIC "CCRP"
+#define RESOURCE_PACK_VERSION 2
+#define RESOURCE_PACK_ALIGNMENT 64
+
+#define RESOURCE_MESH 1    // unique vertices of position (3 floats), normal (3 floats), UV (2 floats), then three indices per triangle
+#define RESOURCE_TEXTURE 2 // RGB, 1 byte per channel, rows bottom to top
+
+typedef struct {
+
+	char magic[4];
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t reserved;
+
+} ResourcePackHeader;
+
+typedef struct {
+
+	char name[48]; // NUL terminated
+	uint32_t type;
+
+	uint32_t vertex_count; // meshes only
+	uint32_t width;        // textures only
+	uint32_t height;
+
+	uint64_t offset; // from the start of the file
+	uint64_t bytecount;
+
+	// meshes only, the index data comes right after the vertex data (aligned)
+	uint64_t index_offset;
+	uint32_t index_count;
+	uint32_t index_size; // 2 or 4 bytes
+
+} ResourcePackEntry;
+
+typedef struct {
+
+	const unsigned char *data; // the whole file
+	size_t size;
+
+	const ResourcePackEntry *entries;
+	int entry_count;
+
+} ResourcePack;
+
+ResourcePack resource_pack = {0};
+
+#define RESOURCE_VERTEX_SIZE 32 // position, normal, UV
+
+// whether an entry's data is as big as its type and sizes say, and (for meshes) every index is of one of its vertices, so
+// a stale or broken pack can't make an upload read past the mapping or a draw past the vertex buffer (the entry's offsets
+// have to be in the file already)
+static int is_resource_entry_valid(const unsigned char *data, const ResourcePackEntry *entry) {
+
+	if (entry->type == RESOURCE_TEXTURE)
+		return (uint64_t) entry->width * entry->height * 3 <= entry->bytecount;
+
+	if (entry->type != RESOURCE_MESH)
+		return TRUE;
+
+	if ((uint64_t) entry->vertex_count * RESOURCE_VERTEX_SIZE > entry->bytecount || entry->index_count % 3 != 0
+		|| (entry->index_size != 2 && entry->index_size != 4))
+		return FALSE;
+
+	const unsigned char *indices = data + entry->index_offset;
+
+	for (uint32_t i = 0; i < entry->index_count; i++) {
+
+		uint32_t index;
+
+		if (entry->index_size == 2) {
+			uint16_t short_index;
+			memcpy(&short_index, indices + i * 2, 2);
+			index = short_index;
+		} else {
+			memcpy(&index, indices + i * 4, 4);
+		}
+
+		if (index >= entry->vertex_count)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+// maps the pack into memory (read only, pages get loaded lazily as they're used), returns FALSE on error
+int open_resource_pack(ResourcePack *pack, const char *path) {
+
+	int file = open(path, O_RDONLY);
+
+	if (file == -1)
+		return FALSE;
+
+	struct stat file_stat;
+
+	if (fstat(file, &file_stat) == -1 || file_stat.st_size < sizeof(ResourcePackHeader)) {
+		close(file);
+		return FALSE;
+	}
+
+	void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file); // the mapping keeps the file alive
+
+	if (data == MAP_FAILED)
+		return FALSE;
+
+	const ResourcePackHeader *header = data;
+	const ResourcePackEntry *entries = (const ResourcePackEntry *) (header + 1);
+
+	int valid = !memcmp(header->magic, RESOURCE_PACK_MAGIC, 4)
+		&& header->version == RESOURCE_PACK_VERSION
+		&& sizeof(ResourcePackHeader) + sizeof(ResourcePackEntry) * (uint64_t) header->entry_count <= file_stat.st_size;
+
+	for (int i = 0; valid && i < header->entry_count; i++) {
+
+		valid = entries[i].offset <= file_stat.st_size
+			&& entries[i].bytecount <= file_stat.st_size - entries[i].offset
+			&& entries[i].index_offset <= file_stat.st_size
+			&& (uint64_t) entries[i].index_count * entries[i].index_size <= file_stat.st_size - entries[i].index_offset
+			&& memchr(entries[i].name, '\0', sizeof(entries[i].name))
+			&& is_resource_entry_valid(data, &entries[i]);
+	}
+
+	if (!valid) {
+		munmap(data, file_stat.st_size);
+		return FALSE;
+	}
+
+	pack->data = data;
+	pack->size = file_stat.st_size;
+	pack->entries = entries;
+	pack->entry_count = header->entry_count;
+
+	return TRUE;
+}
+
+void close_resource_pack(ResourcePack *pack) {
+
+	if (pack->data)
+		munmap((void *) pack->data, pack->size);
+
+	memset(pack, 0, sizeof(ResourcePack));
+}
+
+// returns NULL if the pack has no resource of that name and type
+const ResourcePackEntry *find_resource(const ResourcePack *pack, const char *name, uint32_t type) {
+
+	for (int i = 0; i < pack->entry_count; i++) {
+
+		if (pack->entries[i].type == type && !strcmp(pack->entries[i].name, name))
+			return &pack->entries[i];
+	}
+
+	return NULL;
+}
+
+const unsigned char *get_resource_data(const ResourcePack *pack, const ResourcePackEntry *entry) {
+
+	return pack->data + entry->offset;
+}
+
+const unsigned char *get_resource_indices(const ResourcePack *pack, const ResourcePackEntry *entry) {
+
+	return pack->data + entry->index_offset;
+}
+
+#endif
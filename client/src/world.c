@@ -0,0 +1,850 @@
+#ifndef WORLD_DEFINED
+
+#define WORLD_DEFINED
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../util.c"
+#include "chunk_blocks.c"
+#include "../../chunk_format.c"
+#include "../../terrain.c"
+
+// the world is a sparse set of 16x16x16 chunks keyed by chunk coordinates (block coordinates / 16)
+// this file deliberately knows nothing about OpenGL, so the render side hangs its data off chunk->model
+
+typedef struct ChunkModel ChunkModel; // defined in 3D.c
+
+typedef struct Chunk {
+
+	int x; // chunk coordinates
+	int y;
+	int z;
+
+	ChunkBlocks blocks; // palette compressed (see chunk_blocks.c), kept apart from the render data in model
+
+	ChunkModel *model; // NULL until the chunk is first meshed
+
+	unsigned int version; // changes whenever the chunk's mesh would, so meshes built from old data can be recognized
+
+	unsigned int visible_frame; // last frame the renderer's visibility search reached this chunk (see culling.c)
+
+	int loaded_index; // position in world->loaded
+	int dirty_index;  // position in world->dirty, or -1 if the chunk doesn't need remeshing
+	int edited;       // blocks were set since it last left world->dirty, so its palette may have unused entries
+
+} Chunk;
+
+typedef struct {
+
+	// open addressing hash table (linear probing, power of two size) so chunk lookup is O(1)
+	Chunk **slots;
+	int slot_mask;
+
+	// dense list of every loaded chunk, for iterating without walking the whole table
+	Chunk **loaded;
+	int loaded_count;
+
+	// chunks whose mesh is out of date
+	Chunk **dirty;
+	int dirty_count;
+
+	// chunk coordinates (x, y, z triples) waiting to be loaded, nearest first
+	int *load_queue;
+	int load_queue_head;
+	int load_queue_count;
+
+	int view_radius;          // chunks are loaded within this many chunks of the camera horizontally...
+	int view_radius_vertical; // ...and this many vertically
+	int load_budget;          // max chunks loaded per update, so walking doesn't cause a hitch
+
+	unsigned int version_counter;
+
+	int center_x; // chunk the camera was in on the last update
+	int center_y;
+	int center_z;
+	int has_center;
+
+	// called right after a chunk is inserted (to fill in its blocks) and right before it is freed
+	void (*on_chunk_load)(Chunk *chunk);
+	void (*on_chunk_unload)(Chunk *chunk);
+
+	// optional, for blocks that take a while to come up with (e.g. generated in the background): returns TRUE once it has
+	// filled in the blocks of the chunk at (x, y, z), in which case the chunk gets loaded with them (before on_chunk_load,
+	// and taking ownership of them), or FALSE if they aren't ready yet, in which case it's asked again next update
+	int (*fill_chunk)(int x, int y, int z, ChunkBlocks *blocks);
+
+	// optional, called for a chunk fill_chunk might have been asked for that went out of range before it was loaded (so
+	// it won't be asked for again)
+	void (*cancel_chunk)(int x, int y, int z);
+
+} World;
+
+// the 6 directions to a block's (or chunk's) neighbors
+#define FACE_NEG_X 0
+#define FACE_POS_X 1
+#define FACE_NEG_Z 2
+#define FACE_POS_Z 3
+#define FACE_NEG_Y 4
+#define FACE_POS_Y 5
+
+static const signed char face_normals[6][3] = {
+	{-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}
+};
+
+static unsigned int hash_chunk_coords(int x, int y, int z) {
+
+	return ((unsigned int) x * 73856093u) ^ ((unsigned int) y * 19349663u) ^ ((unsigned int) z * 83492791u);
+}
+
+void initialize_world(World *world, int view_radius, int view_radius_vertical) {
+
+	memset(world, 0, sizeof(World));
+
+	world->view_radius = view_radius;
+	world->view_radius_vertical = view_radius_vertical;
+	world->load_budget = 4;
+
+	// chunks are unloaded one chunk past the view radius (so walking back and forth over a border doesn't thrash),
+	// which bounds how many can ever be loaded at once
+	int max_loaded = (view_radius * 2 + 3) * (view_radius * 2 + 3) * (view_radius_vertical * 2 + 3);
+	int max_queued = (view_radius * 2 + 1) * (view_radius * 2 + 1) * (view_radius_vertical * 2 + 1);
+
+	// keep the table at most half full
+	int slot_count = 1;
+
+	while (slot_count < max_loaded * 2) {
+		slot_count *= 2;
+	}
+
+	world->slots = calloc(slot_count, sizeof(Chunk *));
+	world->slot_mask = slot_count - 1;
+
+	world->loaded = malloc(sizeof(Chunk *) * max_loaded);
+	world->dirty = malloc(sizeof(Chunk *) * max_loaded);
+	world->load_queue = malloc(sizeof(int) * 3 * max_queued);
+}
+
+Chunk *get_chunk(const World *world, int x, int y, int z) {
+
+	unsigned int slot = hash_chunk_coords(x, y, z) & world->slot_mask;
+
+	while (world->slots[slot]) {
+
+		Chunk *chunk = world->slots[slot];
+
+		if (chunk->x == x && chunk->y == y && chunk->z == z)
+			return chunk;
+
+		slot = (slot + 1) & world->slot_mask;
+	}
+
+	return NULL;
+}
+
+// returns 0 (air) for blocks in chunks that aren't loaded
+unsigned char get_block(const World *world, int x, int y, int z) {
+
+	Chunk *chunk = get_chunk(world, BLOCK_TO_CHUNK(x), BLOCK_TO_CHUNK(y), BLOCK_TO_CHUNK(z));
+
+	if (!chunk)
+		return 0;
+
+	return get_chunk_block(&chunk->blocks, BLOCK_TO_LOCAL(x), BLOCK_TO_LOCAL(y), BLOCK_TO_LOCAL(z));
+}
+
+void mark_chunk_dirty(World *world, Chunk *chunk) {
+
+	chunk->version = ++world->version_counter;
+
+	if (chunk->dirty_index != -1)
+		return;
+
+	chunk->dirty_index = world->dirty_count;
+	world->dirty[world->dirty_count++] = chunk;
+}
+
+static void unmark_chunk_dirty(World *world, Chunk *chunk) {
+
+	if (chunk->dirty_index == -1)
+		return;
+
+	// swap-remove
+	Chunk *last = world->dirty[--world->dirty_count];
+	world->dirty[chunk->dirty_index] = last;
+	last->dirty_index = chunk->dirty_index;
+
+	chunk->dirty_index = -1;
+}
+
+// returns NULL once no chunks need remeshing
+Chunk *pop_dirty_chunk(World *world) {
+
+	if (world->dirty_count == 0)
+		return NULL;
+
+	Chunk *chunk = world->dirty[world->dirty_count - 1];
+	unmark_chunk_dirty(world, chunk);
+
+	// once per remesh rather than per edit (e.g. a chunk dug back out to all air goes back to the uniform path)
+	if (chunk->edited) {
+		compact_chunk_blocks(&chunk->blocks);
+		chunk->edited = FALSE;
+	}
+
+	return chunk;
+}
+
+static void mark_neighbor_dirty(World *world, const Chunk *chunk, int face) {
+
+	Chunk *neighbor = get_chunk(world, chunk->x + face_normals[face][0], chunk->y + face_normals[face][1], chunk->z + face_normals[face][2]);
+
+	if (neighbor)
+		mark_chunk_dirty(world, neighbor);
+}
+
+void set_block(World *world, int x, int y, int z, unsigned char block) {
+
+	Chunk *chunk = get_chunk(world, BLOCK_TO_CHUNK(x), BLOCK_TO_CHUNK(y), BLOCK_TO_CHUNK(z));
+
+	if (!chunk)
+		return;
+
+	int local_x = BLOCK_TO_LOCAL(x);
+	int local_y = BLOCK_TO_LOCAL(y);
+	int local_z = BLOCK_TO_LOCAL(z);
+
+	set_chunk_block(&chunk->blocks, local_x, local_y, local_z, block);
+	chunk->edited = TRUE;
+	mark_chunk_dirty(world, chunk);
+
+	// blocks on the border can expose or hide faces of the neighboring chunk
+	if (local_x == 0)  mark_neighbor_dirty(world, chunk, FACE_NEG_X);
+	if (local_x == 15) mark_neighbor_dirty(world, chunk, FACE_POS_X);
+	if (local_y == 0)  mark_neighbor_dirty(world, chunk, FACE_NEG_Y);
+	if (local_y == 15) mark_neighbor_dirty(world, chunk, FACE_POS_Y);
+	if (local_z == 0)  mark_neighbor_dirty(world, chunk, FACE_NEG_Z);
+	if (local_z == 15) mark_neighbor_dirty(world, chunk, FACE_POS_Z);
+}
+
+// applies a batch of changes to one chunk (as the server sends them each tick, BLOCK_CHANGE_SIZE bytes per change, see
+// ../../chunk_format.c), then marks the chunk and each neighbor whose border it touched for one remesh, however many
+// blocks changed; returns FALSE if the chunk isn't loaded or any change is malformed (then none of them apply)
+int apply_block_changes(World *world, int chunk_x, int chunk_y, int chunk_z, const unsigned char *changes, int count) {
+
+	Chunk *chunk = get_chunk(world, chunk_x, chunk_y, chunk_z);
+
+	if (!chunk)
+		return FALSE;
+
+	int x, y, z;
+	unsigned char block;
+
+	// check the whole batch first so a bad change can't leave the chunk half updated
+	for (int i = 0; i < count; i++) {
+
+		if (!get_block_change(changes + i * BLOCK_CHANGE_SIZE, &x, &y, &z, &block) || block > BLOCK_LEAVES)
+			return FALSE;
+	}
+
+	if (count <= 0)
+		return TRUE;
+
+	int touched_faces = 0; // bit per face whose border layer changed
+
+	for (int i = 0; i < count; i++) {
+
+		get_block_change(changes + i * BLOCK_CHANGE_SIZE, &x, &y, &z, &block);
+		set_chunk_block(&chunk->blocks, x, y, z, block);
+
+		touched_faces |= (x == 0) << FACE_NEG_X | (x == 15) << FACE_POS_X | (y == 0) << FACE_NEG_Y | (y == 15) << FACE_POS_Y
+			| (z == 0) << FACE_NEG_Z | (z == 15) << FACE_POS_Z;
+	}
+
+	chunk->edited = TRUE;
+	mark_chunk_dirty(world, chunk);
+
+	for (int face = 0; face < 6; face++) {
+
+		if (touched_faces & 1 << face)
+			mark_neighbor_dirty(world, chunk, face);
+	}
+
+	return TRUE;
+}
+
+// replaces a loaded chunk's blocks with ones in ../../chunk_format.c's format (the server resending it whole, when too
+// much of it changed for a batch), returns FALSE if the chunk isn't loaded or the data is malformed
+int apply_encoded_chunk(World *world, int x, int y, int z, const unsigned char *data, int length) {
+
+	Chunk *chunk = get_chunk(world, x, y, z);
+	unsigned char blocks[16][16][16];
+
+	if (!chunk || !decode_chunk(data, length, blocks))
+		return FALSE;
+
+	pack_chunk_blocks(&chunk->blocks, blocks);
+	mark_chunk_dirty(world, chunk);
+
+	for (int face = 0; face < 6; face++) {
+		mark_neighbor_dirty(world, chunk, face);
+	}
+
+	return TRUE;
+}
+
+// the block in the chunk's outermost layer on the given side, at in-plane coordinates (a, b) (the remaining two of x, y, z, in that order)
+static unsigned char get_border_block(const Chunk *chunk, int face, int a, int b) {
+
+	int layer = face_normals[face][0] + face_normals[face][1] + face_normals[face][2] > 0 ? 15 : 0;
+
+	switch (face) {
+		case FACE_NEG_X: case FACE_POS_X: return get_chunk_block(&chunk->blocks, layer, a, b);
+		case FACE_NEG_Y: case FACE_POS_Y: return get_chunk_block(&chunk->blocks, a, layer, b);
+		default:                          return get_chunk_block(&chunk->blocks, a, b, layer);
+	}
+}
+
+// fills in the layer of blocks just outside each side of the chunk (borders[face][a][b], a and b as in get_border_block),
+// which is what the mesher needs to cull faces on chunk boundaries; sides with no loaded neighbor are air
+void copy_chunk_borders(const World *world, const Chunk *chunk, unsigned char borders[6][16][16]) {
+
+	for (int face = 0; face < 6; face++) {
+
+		Chunk *neighbor = get_chunk(world, chunk->x + face_normals[face][0], chunk->y + face_normals[face][1], chunk->z + face_normals[face][2]);
+
+		if (!neighbor) {
+			memset(borders[face], 0, sizeof(borders[face]));
+			continue;
+		}
+
+		if (is_chunk_uniform(&neighbor->blocks)) {
+			memset(borders[face], neighbor->blocks.single_block, sizeof(borders[face]));
+			continue;
+		}
+
+		// the neighbor's layer touching this chunk is on its opposite side (faces come in -/+ pairs)
+		for (int a = 0; a < 16; a++)
+			for (int b = 0; b < 16; b++)
+				borders[face][a][b] = get_border_block(neighbor, face ^ 1, a, b);
+	}
+}
+
+static int is_border_empty(const Chunk *chunk, int face) {
+
+	if (is_chunk_uniform(&chunk->blocks))
+		return chunk->blocks.single_block == BLOCK_AIR;
+
+	for (int a = 0; a < 16; a++)
+		for (int b = 0; b < 16; b++)
+			if (get_border_block(chunk, face, a, b))
+				return FALSE;
+
+	return TRUE;
+}
+
+// takes ownership of blocks, which can be NULL for all air
+static Chunk *load_chunk(World *world, int x, int y, int z, ChunkBlocks *blocks) {
+
+	Chunk *chunk = calloc(1, sizeof(Chunk));
+	chunk->x = x;
+	chunk->y = y;
+	chunk->z = z;
+	chunk->dirty_index = -1;
+
+	if (blocks)
+		chunk->blocks = *blocks;
+
+	// insert into table
+	unsigned int slot = hash_chunk_coords(x, y, z) & world->slot_mask;
+
+	while (world->slots[slot]) {
+		slot = (slot + 1) & world->slot_mask;
+	}
+
+	world->slots[slot] = chunk;
+
+	chunk->loaded_index = world->loaded_count;
+	world->loaded[world->loaded_count++] = chunk;
+
+	if (world->on_chunk_load)
+		world->on_chunk_load(chunk);
+
+	mark_chunk_dirty(world, chunk);
+
+	// neighbors were meshed as if this chunk were air, so they only need remeshing if the side touching them isn't
+	for (int face = 0; face < 6; face++) {
+
+		if (!is_border_empty(chunk, face))
+			mark_neighbor_dirty(world, chunk, face);
+	}
+
+	return chunk;
+}
+
+static void unload_chunk(World *world, Chunk *chunk) {
+
+	if (world->on_chunk_unload)
+		world->on_chunk_unload(chunk);
+
+	unmark_chunk_dirty(world, chunk);
+
+	// neighbors culled the faces hidden by this chunk, which are now at the edge of what's loaded (the same check as
+	// load_chunk, an empty side didn't hide anything)
+	for (int face = 0; face < 6; face++) {
+
+		if (!is_border_empty(chunk, face))
+			mark_neighbor_dirty(world, chunk, face);
+	}
+
+	// swap-remove from the loaded list
+	Chunk *last = world->loaded[--world->loaded_count];
+	world->loaded[chunk->loaded_index] = last;
+	last->loaded_index = chunk->loaded_index;
+
+	// remove from table, shifting later entries of the probe run back so lookups never hit a false gap (no tombstones needed)
+	unsigned int slot = hash_chunk_coords(chunk->x, chunk->y, chunk->z) & world->slot_mask;
+
+	while (world->slots[slot] != chunk) {
+		slot = (slot + 1) & world->slot_mask;
+	}
+
+	unsigned int hole = slot;
+
+	while (TRUE) {
+
+		slot = (slot + 1) & world->slot_mask;
+
+		Chunk *other = world->slots[slot];
+
+		if (!other)
+			break;
+
+		unsigned int home = hash_chunk_coords(other->x, other->y, other->z) & world->slot_mask;
+
+		// move the entry into the hole unless its home lies cyclically in (hole, slot]
+		if (((slot - home) & world->slot_mask) >= ((slot - hole) & world->slot_mask)) {
+			world->slots[hole] = other;
+			hole = slot;
+		}
+	}
+
+	world->slots[hole] = NULL;
+
+	free_chunk_blocks(&chunk->blocks);
+	free(chunk);
+}
+
+static int is_chunk_in_range(const World *world, int x, int y, int z, int extra) {
+
+	return abs(x - world->center_x) <= world->view_radius + extra
+	    && abs(z - world->center_z) <= world->view_radius + extra
+	    && abs(y - world->center_y) <= world->view_radius_vertical + extra;
+}
+
+// streams chunks in and out around the camera; cheap unless the camera crossed into a new chunk or loads are pending
+void update_world(World *world, float camera_x, float camera_y, float camera_z) {
+
+	// camera space has z flipped relative to block coordinates
+	int center_x = BLOCK_TO_CHUNK((int) floorf(camera_x));
+	int center_y = BLOCK_TO_CHUNK((int) floorf(camera_y));
+	int center_z = BLOCK_TO_CHUNK((int) floorf(-camera_z));
+
+	if (!world->has_center || center_x != world->center_x || center_y != world->center_y || center_z != world->center_z) {
+
+		world->center_x = center_x;
+		world->center_y = center_y;
+		world->center_z = center_z;
+		world->has_center = TRUE;
+
+		// evict everything that fell out of range (iterating backwards since unloading swap-removes)
+		for (int i = world->loaded_count - 1; i >= 0; i--) {
+
+			Chunk *chunk = world->loaded[i];
+
+			if (!is_chunk_in_range(world, chunk->x, chunk->y, chunk->z, 1))
+				unload_chunk(world, chunk);
+		}
+
+		// gives up on what's still queued and out of range now (the rest gets queued again below)
+		for (int i = world->load_queue_head; world->cancel_chunk && i < world->load_queue_count; i++) {
+
+			const int *coords = &world->load_queue[i * 3];
+
+			if (!is_chunk_in_range(world, coords[0], coords[1], coords[2], 0))
+				world->cancel_chunk(coords[0], coords[1], coords[2]);
+		}
+
+		// queue up everything missing, in rings of increasing distance so the nearest chunks show up first
+		world->load_queue_head = 0;
+		world->load_queue_count = 0;
+
+		for (int ring = 0; ring <= world->view_radius; ring++)
+			for (int x = -ring; x <= ring; x++)
+				for (int z = -ring; z <= ring; z++) {
+
+					if (abs(x) != ring && abs(z) != ring)
+						continue;
+
+					for (int y = -world->view_radius_vertical; y <= world->view_radius_vertical; y++) {
+
+						if (get_chunk(world, center_x + x, center_y + y, center_z + z))
+							continue;
+
+						int *coords = &world->load_queue[world->load_queue_count++ * 3];
+						coords[0] = center_x + x;
+						coords[1] = center_y + y;
+						coords[2] = center_z + z;
+					}
+				}
+	}
+
+	int loaded = 0;
+
+	if (!world->fill_chunk) {
+
+		while (loaded < world->load_budget && world->load_queue_head < world->load_queue_count) {
+
+			int *coords = &world->load_queue[world->load_queue_head++ * 3];
+
+			if (get_chunk(world, coords[0], coords[1], coords[2]))
+				continue;
+
+			load_chunk(world, coords[0], coords[1], coords[2], NULL);
+			loaded++;
+		}
+
+		return;
+	}
+
+	// chunks can become ready in any order, so walk the queue loading whatever is ready, and keep the rest queued
+	// (still nearest first) for next time
+	int kept = world->load_queue_head;
+	int i;
+
+	for (i = world->load_queue_head; i < world->load_queue_count && loaded < world->load_budget; i++) {
+
+		int *coords = &world->load_queue[i * 3];
+
+		if (get_chunk(world, coords[0], coords[1], coords[2]))
+			continue;
+
+		ChunkBlocks blocks = {0};
+
+		if (world->fill_chunk(coords[0], coords[1], coords[2], &blocks)) {
+			load_chunk(world, coords[0], coords[1], coords[2], &blocks);
+			loaded++;
+			continue;
+		}
+
+		memmove(&world->load_queue[kept++ * 3], coords, sizeof(int) * 3);
+	}
+
+	memmove(&world->load_queue[kept * 3], &world->load_queue[i * 3], sizeof(int) * 3 * (world->load_queue_count - i));
+	world->load_queue_count = kept + world->load_queue_count - i;
+}
+
+// bytes of block storage across every loaded chunk
+size_t get_world_block_memory(const World *world) {
+
+	size_t bytes = 0;
+
+	for (int i = 0; i < world->loaded_count; i++) {
+		bytes += get_chunk_blocks_memory(&world->loaded[i]->blocks);
+	}
+
+	return bytes;
+}
+
+void free_world(World *world) {
+
+	while (world->loaded_count) {
+		unload_chunk(world, world->loaded[world->loaded_count - 1]);
+	}
+
+	free(world->slots);
+	free(world->loaded);
+	free(world->dirty);
+	free(world->load_queue);
+}
+
+int is_point_inside_block(const World *world, float x, float y, float z) {
+
+	return get_block(world, (int) floorf(x), (int) floorf(y), (int) floorf(-z));
+}
+
+int is_aabb_cube_inside_block(const World *world, float x, float y, float z, float size) {
+
+	// gonna use unit aabb for now
+	return is_point_inside_block(world, x - size, y - size, z - size)
+	    || is_point_inside_block(world, x - size, y - size, z + size)
+		|| is_point_inside_block(world, x - size, y + size, z - size)
+		|| is_point_inside_block(world, x - size, y + size, z + size)
+		|| is_point_inside_block(world, x + size, y - size, z - size)
+		|| is_point_inside_block(world, x + size, y - size, z + size)
+		|| is_point_inside_block(world, x + size, y + size, z - size)
+		|| is_point_inside_block(world, x + size, y + size, z + size);
+}
+
+
+// swept collision for axis aligned boxes, in block coordinates (unlike the functions above, which take camera space)
+
+#define COLLISION_EPSILON 0.0001f // boxes overlapping a block by less than this don't count as inside it
+
+typedef struct {
+
+	float min[3];
+	float max[3];
+
+} AABB;
+
+// get_block, but remembering the last chunk, since a sweep looks at lots of blocks in the same few chunks
+typedef struct {
+
+	const Chunk *chunk; // NULL if that chunk isn't loaded
+	int x;
+	int y;
+	int z;
+	int valid;
+
+} BlockLookup;
+
+static int is_block_solid_cached(const World *world, BlockLookup *lookup, int x, int y, int z) {
+
+	int chunk_x = BLOCK_TO_CHUNK(x);
+	int chunk_y = BLOCK_TO_CHUNK(y);
+	int chunk_z = BLOCK_TO_CHUNK(z);
+
+	if (!lookup->valid || lookup->x != chunk_x || lookup->y != chunk_y || lookup->z != chunk_z) {
+
+		lookup->chunk = get_chunk(world, chunk_x, chunk_y, chunk_z);
+		lookup->x = chunk_x;
+		lookup->y = chunk_y;
+		lookup->z = chunk_z;
+		lookup->valid = TRUE;
+	}
+
+	return lookup->chunk && get_chunk_block(&lookup->chunk->blocks, BLOCK_TO_LOCAL(x), BLOCK_TO_LOCAL(y), BLOCK_TO_LOCAL(z)) != BLOCK_AIR;
+}
+
+// is there a solid block in the layer (along axis) at the given cell, within the box's cross section?
+static int is_layer_solid(const World *world, BlockLookup *lookup, const AABB *box, int axis, int layer) {
+
+	int a = axis == 0 ? 1 : 0; // the other two axes
+	int b = axis == 2 ? 1 : 2;
+
+	int min_a = (int) floorf(box->min[a] + COLLISION_EPSILON);
+	int max_a = (int) ceilf(box->max[a] - COLLISION_EPSILON) - 1;
+	int min_b = (int) floorf(box->min[b] + COLLISION_EPSILON);
+	int max_b = (int) ceilf(box->max[b] - COLLISION_EPSILON) - 1;
+
+	int cell[3];
+	cell[axis] = layer;
+
+	for (cell[a] = min_a; cell[a] <= max_a; cell[a]++)
+		for (cell[b] = min_b; cell[b] <= max_b; cell[b]++)
+			if (is_block_solid_cached(world, lookup, cell[0], cell[1], cell[2]))
+				return TRUE;
+
+	return FALSE;
+}
+
+// moves the box along one axis, stopping flush against the first solid layer of blocks it would sweep into
+// returns how far it actually moved
+static float sweep_aabb_axis(const World *world, BlockLookup *lookup, AABB *box, int axis, float motion) {
+
+	if (motion > 0) {
+
+		int first = (int) ceilf(box->max[axis] - COLLISION_EPSILON);
+		int last = (int) ceilf(box->max[axis] + motion - COLLISION_EPSILON) - 1;
+
+		for (int layer = first; layer <= last; layer++) {
+
+			if (is_layer_solid(world, lookup, box, axis, layer)) {
+				motion = layer - box->max[axis];
+				break;
+			}
+		}
+
+	} else if (motion < 0) {
+
+		int first = (int) floorf(box->min[axis] + COLLISION_EPSILON) - 1;
+		int last = (int) floorf(box->min[axis] + motion + COLLISION_EPSILON);
+
+		for (int layer = first; layer >= last; layer--) {
+
+			if (is_layer_solid(world, lookup, box, axis, layer)) {
+				motion = layer + 1 - box->min[axis];
+				break;
+			}
+		}
+	}
+
+	box->min[axis] += motion;
+	box->max[axis] += motion;
+
+	return motion;
+}
+
+static int move_aabb_cached(const World *world, BlockLookup *lookup, AABB *box, float motion[3]) {
+
+	static const int axis_order[3] = {1, 0, 2};
+
+	int blocked = 0;
+
+	for (int i = 0; i < 3; i++) {
+
+		int axis = axis_order[i];
+		float moved = sweep_aabb_axis(world, lookup, box, axis, motion[axis]);
+
+		if (moved != motion[axis])
+			blocked |= 1 << axis;
+
+		motion[axis] = moved;
+	}
+
+	return blocked;
+}
+
+// moves the box by motion, one axis at a time (y, then x, then z) so it slides along whatever it hits instead of stopping
+// dead; only the blocks it sweeps through are looked at, so it can't tunnel through anything however fast it goes
+// motion is updated to how far the box actually moved, returns which axes were blocked (bit 0 for x, 1 for y, 2 for z)
+int move_aabb(const World *world, AABB *box, float motion[3]) {
+
+	BlockLookup lookup = {0};
+
+	return move_aabb_cached(world, &lookup, box, motion);
+}
+
+// move_aabb for a whole batch of boxes (e.g. every entity each tick), sharing the chunk lookup between them, so it's
+// cheapest when boxes near each other come one after another; blocked can be NULL
+void move_aabbs(const World *world, AABB *boxes, float (*motions)[3], int *blocked, int count) {
+
+	BlockLookup lookup = {0};
+
+	for (int i = 0; i < count; i++) {
+
+		int axes = move_aabb_cached(world, &lookup, &boxes[i], motions[i]);
+
+		if (blocked)
+			blocked[i] = axes;
+	}
+}
+
+// ray casting through the block grid (block coordinates too)
+
+typedef struct {
+
+	int x; // block coordinates of the first solid block the ray reached
+	int y;
+	int z;
+	unsigned char block;
+
+	int face;       // FACE_* of the side the ray went in through, -1 if it started inside the block
+	float distance; // along the ray, from its origin to where it went into the block
+
+} RaycastHit;
+
+static const int axis_faces[3][2] = { // [axis][entered moving in the positive direction]
+	{FACE_POS_X, FACE_NEG_X}, {FACE_POS_Y, FACE_NEG_Y}, {FACE_POS_Z, FACE_NEG_Z}
+};
+
+// Amanatides & Woo's DDA: steps from cell to cell in the order the ray crosses them, so only the cells on the ray are
+// looked at and the cost is proportional to the distance
+static int raycast_blocks_cached(const World *world, BlockLookup *lookup, const float origin[3], const float direction[3], float max_distance, RaycastHit *hit) {
+
+	int cell[3];
+	int step[3];
+	float next_boundary[3]; // distance along the ray to the next cell boundary on each axis
+	float boundary_spacing[3];
+
+	for (int axis = 0; axis < 3; axis++) {
+
+		cell[axis] = (int) floorf(origin[axis]);
+
+		if (direction[axis] > 0) {
+			step[axis] = 1;
+			next_boundary[axis] = (cell[axis] + 1 - origin[axis]) / direction[axis];
+			boundary_spacing[axis] = 1 / direction[axis];
+		} else if (direction[axis] < 0) {
+			step[axis] = -1;
+			next_boundary[axis] = (origin[axis] - cell[axis]) / -direction[axis];
+			boundary_spacing[axis] = 1 / -direction[axis];
+		} else {
+			step[axis] = 0;
+			next_boundary[axis] = INFINITY;
+			boundary_spacing[axis] = INFINITY;
+		}
+	}
+
+	int face = -1;
+	float distance = 0;
+
+	while (TRUE) {
+
+		if (is_block_solid_cached(world, lookup, cell[0], cell[1], cell[2])) {
+
+			hit->x = cell[0];
+			hit->y = cell[1];
+			hit->z = cell[2];
+			hit->block = get_chunk_block(&lookup->chunk->blocks, BLOCK_TO_LOCAL(cell[0]), BLOCK_TO_LOCAL(cell[1]), BLOCK_TO_LOCAL(cell[2]));
+			hit->face = face;
+			hit->distance = distance;
+
+			return TRUE;
+		}
+
+		// cross whichever boundary comes first
+		int axis = next_boundary[0] < next_boundary[1]
+			? (next_boundary[0] < next_boundary[2] ? 0 : 2)
+			: (next_boundary[1] < next_boundary[2] ? 1 : 2);
+
+		distance = next_boundary[axis];
+
+		if (distance > max_distance)
+			return FALSE;
+
+		cell[axis] += step[axis];
+		next_boundary[axis] += boundary_spacing[axis];
+		face = axis_faces[axis][step[axis] > 0];
+	}
+}
+
+// finds the first solid block along the ray within max_distance, returns FALSE if there isn't one (hit is then untouched)
+// direction should be normalized (distances are measured in its lengths); unloaded chunks count as air
+int raycast_blocks(const World *world, const float origin[3], const float direction[3], float max_distance, RaycastHit *hit) {
+
+	BlockLookup lookup = {0};
+
+	return raycast_blocks_cached(world, &lookup, origin, direction, max_distance, hit);
+}
+
+// raycast_blocks for a whole batch of rays (e.g. line of sight checks for every mob), sharing the chunk lookup between
+// them; hits[i] is only written where found[i] comes back TRUE
+void raycast_blocks_batch(const World *world, const float (*origins)[3], const float (*directions)[3], float max_distance, RaycastHit *hits, int *found, int count) {
+
+	BlockLookup lookup = {0};
+
+	for (int i = 0; i < count; i++) {
+		found[i] = raycast_blocks_cached(world, &lookup, origins[i], directions[i], max_distance, &hits[i]);
+	}
+}
+
+// TRUE if no solid block touches the segment between the two points (so both should be in the air, like eyes are)
+int has_line_of_sight(const World *world, const float from[3], const float to[3]) {
+
+	float direction[3] = {to[0] - from[0], to[1] - from[1], to[2] - from[2]};
+	float distance = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+
+	if (distance == 0)
+		return !get_block(world, (int) floorf(from[0]), (int) floorf(from[1]), (int) floorf(from[2]));
+
+	for (int axis = 0; axis < 3; axis++) {
+		direction[axis] /= distance;
+	}
+
+	RaycastHit hit;
+
+	return !raycast_blocks(world, from, direction, distance, &hit);
+}
+#endif
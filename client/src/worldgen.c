@@ -0,0 +1,605 @@
+#ifndef WORLDGEN_DEFINED
+
+#define WORLDGEN_DEFINED
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "../../util.c"
+#include "chunk_blocks.c"
+#include "../../terrain.c"
+
+// generates terrain on a pool of background threads, in stages:
+//   heightmap -> density (solid ground with caves carved out) -> surface (grass/dirt/stone) -> features (trees)
+// the first three only look at the chunk itself, but trees cross chunk borders, so a chunk's features stage waits until
+// every chunk a tree could grow in from (the 3x3 columns around it, this layer and the one below) is through its surface
+// stage; those neighbors get generated that far just for this, even if nobody asked for them
+// everything is a pure function of the seed and chunk coordinates, so the order (and thread) chunks generate in never
+// changes the result, and finished chunks are kept (packed) in an LRU cache so walking back somewhere doesn't regenerate it
+
+#define WORLDGEN_HEIGHTMAP 0 // stages, in order (a chunk's stage is the next one it needs to run)
+#define WORLDGEN_DENSITY   1
+#define WORLDGEN_SURFACE   2
+#define WORLDGEN_FEATURES  3
+#define WORLDGEN_DONE      4
+
+#define WORLDGEN_WORKER_NICENESS 10
+
+// the chunks a chunk's features stage reads are at these offsets (trees grow up, so never from the layer above)
+#define FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) \
+	for (int dx = -1; dx <= 1; dx++) \
+		for (int dy = -1; dy <= 0; dy++) \
+			for (int dz = -1; dz <= 1; dz++)
+
+typedef struct GenChunk {
+
+	int x; // chunk coordinates
+	int y;
+	int z;
+
+	int stage;
+	int wanted;    // somebody asked for this chunk and hasn't collected it yet (otherwise it's only generated as far as
+	               // its neighbors need, and can be evicted once it's done)
+	int scheduled; // queued or being worked on, so at most one thread touches the chunk at a time
+
+	float heightmap[16][16];     // [x][z], world y of the top of the ground
+	signed char surface[16][16]; // [x][z], local y of the column's grass block, or -1 if it isn't in this chunk
+
+	unsigned char (*blocks)[16][16]; // [16][16][16] while generating, NULL once done
+	ChunkBlocks finished;            // packed once done, which is how the cache keeps it
+
+	struct GenChunk *next_in_bucket;
+	struct GenChunk *lru_previous; // towards the most recently used
+	struct GenChunk *lru_next;
+	struct GenChunk *next_job;
+
+} GenChunk;
+
+typedef struct {
+
+	unsigned int seed;
+
+	// chained hash table (the cache can overflow its capacity for a while, when nothing in it can be evicted yet)
+	GenChunk **buckets;
+	int bucket_mask;
+	int chunk_count;
+	int cache_capacity;
+
+	GenChunk *lru_head; // most recently used
+	GenChunk *lru_tail;
+
+	GenChunk *job_head; // FIFO of chunks with a stage ready to run
+	GenChunk *job_tail;
+
+	long chunks_generated; // finished all stages (not counting cache hits)
+
+	// guards everything above, and the stage/wanted/scheduled fields of every chunk (the stages themselves run unlocked)
+	pthread_mutex_t mutex;
+	pthread_cond_t job_available;
+	int stopping;
+
+	pthread_t *threads;
+	int thread_count;
+
+} WorldGenerator;
+
+static unsigned int hash_gen_chunk_coords(int x, int y, int z) {
+
+	return ((unsigned int) x * 73856093u) ^ ((unsigned int) y * 19349663u) ^ ((unsigned int) z * 83492791u);
+}
+
+static GenChunk *find_gen_chunk(const WorldGenerator *gen, int x, int y, int z) {
+
+	GenChunk *chunk = gen->buckets[hash_gen_chunk_coords(x, y, z) & gen->bucket_mask];
+
+	while (chunk && (chunk->x != x || chunk->y != y || chunk->z != z)) {
+		chunk = chunk->next_in_bucket;
+	}
+
+	return chunk;
+}
+
+static void unlink_gen_chunk_lru(WorldGenerator *gen, GenChunk *chunk) {
+
+	if (chunk->lru_previous)
+		chunk->lru_previous->lru_next = chunk->lru_next;
+	else
+		gen->lru_head = chunk->lru_next;
+
+	if (chunk->lru_next)
+		chunk->lru_next->lru_previous = chunk->lru_previous;
+	else
+		gen->lru_tail = chunk->lru_previous;
+}
+
+static void touch_gen_chunk(WorldGenerator *gen, GenChunk *chunk) {
+
+	if (gen->lru_head == chunk)
+		return;
+
+	unlink_gen_chunk_lru(gen, chunk);
+
+	chunk->lru_previous = NULL;
+	chunk->lru_next = gen->lru_head;
+	gen->lru_head->lru_previous = chunk;
+	gen->lru_head = chunk;
+}
+
+// a chunk can go once it isn't being worked on, it isn't finished and waiting to be collected, and nothing unfinished
+// that was asked for (or having its features stage run, asked for or not anymore) still needs it
+static int is_gen_chunk_evictable(const WorldGenerator *gen, const GenChunk *chunk) {
+
+	if (chunk->scheduled || chunk->wanted)
+		return FALSE;
+
+	// (this includes the chunk itself)
+	FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) {
+
+		GenChunk *dependent = find_gen_chunk(gen, chunk->x - dx, chunk->y - dy, chunk->z - dz);
+
+		if (dependent && dependent->stage != WORLDGEN_DONE && (dependent->wanted || (dependent->scheduled && dependent->stage == WORLDGEN_FEATURES)))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void evict_gen_chunk(WorldGenerator *gen, GenChunk *chunk) {
+
+	GenChunk **link = &gen->buckets[hash_gen_chunk_coords(chunk->x, chunk->y, chunk->z) & gen->bucket_mask];
+
+	while (*link != chunk) {
+		link = &(*link)->next_in_bucket;
+	}
+
+	*link = chunk->next_in_bucket;
+
+	unlink_gen_chunk_lru(gen, chunk);
+	gen->chunk_count--;
+
+	free(chunk->blocks);
+	free_chunk_blocks(&chunk->finished);
+	free(chunk);
+}
+
+// evicts least recently used chunks until the cache is back under capacity (giving up after a few that can't go, so
+// this stays cheap while everything is busy)
+static void trim_gen_cache(WorldGenerator *gen) {
+
+	GenChunk *chunk = gen->lru_tail;
+	int skipped = 0;
+
+	// (never the most recently used chunk, which is the one the caller is about to use)
+	while (chunk != gen->lru_head && gen->chunk_count > gen->cache_capacity && skipped < 16) {
+
+		GenChunk *previous = chunk->lru_previous;
+
+		if (is_gen_chunk_evictable(gen, chunk)) {
+			evict_gen_chunk(gen, chunk);
+		} else {
+			skipped++;
+		}
+
+		chunk = previous;
+	}
+}
+
+static GenChunk *get_or_create_gen_chunk(WorldGenerator *gen, int x, int y, int z) {
+
+	GenChunk *chunk = find_gen_chunk(gen, x, y, z);
+
+	if (chunk) {
+		touch_gen_chunk(gen, chunk);
+		return chunk;
+	}
+
+	chunk = calloc(1, sizeof(GenChunk));
+	chunk->x = x;
+	chunk->y = y;
+	chunk->z = z;
+	chunk->stage = WORLDGEN_HEIGHTMAP;
+	chunk->blocks = malloc(16 * 16 * 16);
+
+	unsigned int bucket = hash_gen_chunk_coords(x, y, z) & gen->bucket_mask;
+	chunk->next_in_bucket = gen->buckets[bucket];
+	gen->buckets[bucket] = chunk;
+
+	chunk->lru_next = gen->lru_head;
+
+	if (gen->lru_head)
+		gen->lru_head->lru_previous = chunk;
+	else
+		gen->lru_tail = chunk;
+
+	gen->lru_head = chunk;
+	gen->chunk_count++;
+
+	trim_gen_cache(gen);
+
+	return chunk;
+}
+
+static int are_feature_neighbors_ready(const WorldGenerator *gen, const GenChunk *chunk) {
+
+	FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) {
+
+		GenChunk *neighbor = find_gen_chunk(gen, chunk->x + dx, chunk->y + dy, chunk->z + dz);
+
+		if (!neighbor || neighbor->stage <= WORLDGEN_SURFACE)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+// queues the chunk's next stage if it can run yet (called with the mutex held)
+static void schedule_gen_chunk(WorldGenerator *gen, GenChunk *chunk) {
+
+	if (chunk->scheduled || chunk->stage == WORLDGEN_DONE)
+		return;
+
+	if (chunk->stage == WORLDGEN_FEATURES && (!chunk->wanted || !are_feature_neighbors_ready(gen, chunk)))
+		return;
+
+	chunk->scheduled = TRUE;
+	chunk->next_job = NULL;
+
+	if (gen->job_tail)
+		gen->job_tail->next_job = chunk;
+	else
+		gen->job_head = chunk;
+
+	gen->job_tail = chunk;
+
+	pthread_cond_signal(&gen->job_available);
+}
+
+static void generate_heightmap(const WorldGenerator *gen, GenChunk *chunk) {
+
+	populate_chunk_heightmap(gen->seed, chunk->x, chunk->z, WORLDGEN_HILL_FREQUENCY, WORLDGEN_HILL_OCTAVES, chunk->heightmap);
+
+	for (int x = 0; x < 16; x++)
+		for (int z = 0; z < 16; z++)
+			chunk->heightmap[x][z] = 8 + chunk->heightmap[x][z] * 12;
+}
+
+#define CAVE_SAMPLE_SPACING 4 // blocks between cave noise samples, which get interpolated in between
+
+static void generate_density(const WorldGenerator *gen, GenChunk *chunk) {
+
+	// caves are big and smooth, so sampling the noise on a coarse grid and interpolating looks the same and is way
+	// cheaper than sampling every block
+	unsigned int cave_seed = gen->seed ^ 0x5ca1ab1eu;
+
+	float caves[16 / CAVE_SAMPLE_SPACING + 1][16 / CAVE_SAMPLE_SPACING + 1][16 / CAVE_SAMPLE_SPACING + 1];
+
+	for (int x = 0; x <= 16 / CAVE_SAMPLE_SPACING; x++)
+		for (int y = 0; y <= 16 / CAVE_SAMPLE_SPACING; y++)
+			for (int z = 0; z <= 16 / CAVE_SAMPLE_SPACING; z++) {
+
+				int world_x = chunk->x * 16 + x * CAVE_SAMPLE_SPACING;
+				int world_y = chunk->y * 16 + y * CAVE_SAMPLE_SPACING;
+				int world_z = chunk->z * 16 + z * CAVE_SAMPLE_SPACING;
+
+				caves[x][y][z] = fractal_noise_3D(cave_seed, world_x / 24.0f, world_y / 16.0f, world_z / 24.0f, 2);
+			}
+
+	for (int x = 0; x < 16; x++)
+		for (int z = 0; z < 16; z++)
+			for (int y = 0; y < 16; y++) {
+
+				if (chunk->y * 16 + y >= chunk->heightmap[x][z]) {
+					chunk->blocks[x][y][z] = BLOCK_AIR;
+					continue;
+				}
+
+				int cell_x = x / CAVE_SAMPLE_SPACING;
+				int cell_y = y / CAVE_SAMPLE_SPACING;
+				int cell_z = z / CAVE_SAMPLE_SPACING;
+
+				float u = (float) (x % CAVE_SAMPLE_SPACING) / CAVE_SAMPLE_SPACING;
+				float v = (float) (y % CAVE_SAMPLE_SPACING) / CAVE_SAMPLE_SPACING;
+				float w = (float) (z % CAVE_SAMPLE_SPACING) / CAVE_SAMPLE_SPACING;
+
+				float x00 = caves[cell_x][cell_y][cell_z]         + u * (caves[cell_x + 1][cell_y][cell_z]         - caves[cell_x][cell_y][cell_z]);
+				float x10 = caves[cell_x][cell_y + 1][cell_z]     + u * (caves[cell_x + 1][cell_y + 1][cell_z]     - caves[cell_x][cell_y + 1][cell_z]);
+				float x01 = caves[cell_x][cell_y][cell_z + 1]     + u * (caves[cell_x + 1][cell_y][cell_z + 1]     - caves[cell_x][cell_y][cell_z + 1]);
+				float x11 = caves[cell_x][cell_y + 1][cell_z + 1] + u * (caves[cell_x + 1][cell_y + 1][cell_z + 1] - caves[cell_x][cell_y + 1][cell_z + 1]);
+
+				float y0 = x00 + v * (x10 - x00);
+				float y1 = x01 + v * (x11 - x01);
+
+				chunk->blocks[x][y][z] = y0 + w * (y1 - y0) < WORLDGEN_CAVE_THRESHOLD ? BLOCK_STONE : BLOCK_AIR;
+			}
+}
+
+static void generate_surface(const WorldGenerator *gen, GenChunk *chunk) {
+
+	for (int x = 0; x < 16; x++)
+		for (int z = 0; z < 16; z++) {
+
+			int top = (int) ceilf(chunk->heightmap[x][z]) - 1; // world y of the highest solid block
+
+			chunk->surface[x][z] = -1;
+
+			for (int y = 0; y < 16; y++) {
+
+				if (chunk->blocks[x][y][z] == BLOCK_AIR)
+					continue;
+
+				int depth = top - (chunk->y * 16 + y);
+
+				if (depth == 0) {
+					chunk->blocks[x][y][z] = BLOCK_GRASS;
+					chunk->surface[x][z] = y;
+				} else if (depth <= 3) {
+					chunk->blocks[x][y][z] = BLOCK_DIRT;
+				}
+			}
+		}
+}
+
+// leaves only grow into air and trunks only replace air or leaves, so overlapping trees come out the same in any order
+static void place_tree_block(GenChunk *chunk, int world_x, int world_y, int world_z, unsigned char block) {
+
+	int x = world_x - chunk->x * 16;
+	int y = world_y - chunk->y * 16;
+	int z = world_z - chunk->z * 16;
+
+	if (x < 0 || x > 15 || y < 0 || y > 15 || z < 0 || z > 15)
+		return;
+
+	unsigned char existing = chunk->blocks[x][y][z];
+
+	if (existing == BLOCK_AIR || (block == BLOCK_LOG && existing == BLOCK_LEAVES))
+		chunk->blocks[x][y][z] = block;
+}
+
+static void place_tree(GenChunk *chunk, int base_x, int base_y, int base_z, unsigned int hash) {
+
+	int trunk_height = 4 + (hash >> 8) % 3;
+	int top = base_y + trunk_height - 1;
+
+	// two wide layers around the top of the trunk, then two narrow ones (the last without corners)
+	for (int y = top - 2; y <= top + 1; y++) {
+
+		int radius = y < top ? 2 : 1;
+
+		for (int x = -radius; x <= radius; x++)
+			for (int z = -radius; z <= radius; z++) {
+
+				int corner = abs(x) == radius && abs(z) == radius;
+
+				if (corner && (y == top + 1 || (radius == 2 && (hash >> (16 + (x > 0) * 2 + (z > 0))) & 1)))
+					continue;
+
+				place_tree_block(chunk, base_x + x, y, base_z + z, BLOCK_LEAVES);
+			}
+	}
+
+	for (int y = base_y; y <= top; y++) {
+		place_tree_block(chunk, base_x, y, base_z, BLOCK_LOG);
+	}
+}
+
+// neighbors[dx + 1][dy + 1][dz + 1], through their surface stage (so their surface arrays won't change anymore)
+static void generate_features(const WorldGenerator *gen, GenChunk *chunk, GenChunk *neighbors[3][2][3]) {
+
+	unsigned int tree_seed = gen->seed ^ 0x72ee5eedu;
+
+	FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) {
+
+		const GenChunk *neighbor = neighbors[dx + 1][dy + 1][dz + 1];
+
+		for (int x = 0; x < 16; x++)
+			for (int z = 0; z < 16; z++) {
+
+				if (neighbor->surface[x][z] == -1)
+					continue;
+
+				int world_x = neighbor->x * 16 + x;
+				int world_z = neighbor->z * 16 + z;
+
+				unsigned int hash = hash_noise_lattice(tree_seed, world_x, world_z);
+
+				if (hash % WORLDGEN_TREE_CHANCE)
+					continue;
+
+				place_tree(chunk, world_x, neighbor->y * 16 + neighbor->surface[x][z] + 1, world_z, hash);
+			}
+	}
+}
+
+static void *run_worldgen_worker(void *arg) {
+
+	WorldGenerator *gen = arg;
+
+#ifdef __linux__
+	// behind whatever the main thread has to get out on time (a frame, or a server tick), when they share a core
+	// (on linux this is just this thread's priority)
+	setpriority(PRIO_PROCESS, 0, WORLDGEN_WORKER_NICENESS);
+#endif
+
+	pthread_mutex_lock(&gen->mutex);
+
+	while (TRUE) {
+
+		while (!gen->job_head && !gen->stopping) {
+			pthread_cond_wait(&gen->job_available, &gen->mutex);
+		}
+
+		if (gen->stopping)
+			break;
+
+		GenChunk *chunk = gen->job_head;
+		gen->job_head = chunk->next_job;
+
+		if (!gen->job_head)
+			gen->job_tail = NULL;
+
+		// neighbors can't be evicted while this chunk's features stage is scheduled, so the pointers stay good unlocked
+		GenChunk *neighbors[3][2][3];
+
+		if (chunk->stage == WORLDGEN_FEATURES) {
+
+			FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) {
+				neighbors[dx + 1][dy + 1][dz + 1] = find_gen_chunk(gen, chunk->x + dx, chunk->y + dy, chunk->z + dz);
+			}
+		}
+
+		pthread_mutex_unlock(&gen->mutex);
+
+		switch (chunk->stage) {
+			case WORLDGEN_HEIGHTMAP: generate_heightmap(gen, chunk); break;
+			case WORLDGEN_DENSITY:   generate_density(gen, chunk); break;
+			case WORLDGEN_SURFACE:   generate_surface(gen, chunk); break;
+			case WORLDGEN_FEATURES:  generate_features(gen, chunk, neighbors); break;
+		}
+
+		if (chunk->stage == WORLDGEN_FEATURES) {
+			pack_chunk_blocks(&chunk->finished, chunk->blocks);
+			free(chunk->blocks);
+			chunk->blocks = NULL;
+		}
+
+		pthread_mutex_lock(&gen->mutex);
+
+		chunk->stage++;
+		chunk->scheduled = FALSE;
+
+		schedule_gen_chunk(gen, chunk);
+
+		// finishing the surface stage might be the last thing a neighbor's features stage was waiting on
+		if (chunk->stage == WORLDGEN_FEATURES) {
+
+			FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) {
+
+				GenChunk *dependent = find_gen_chunk(gen, chunk->x - dx, chunk->y - dy, chunk->z - dz);
+
+				if (dependent)
+					schedule_gen_chunk(gen, dependent);
+			}
+		}
+
+		if (chunk->stage == WORLDGEN_DONE)
+			gen->chunks_generated++;
+	}
+
+	pthread_mutex_unlock(&gen->mutex);
+
+	return NULL;
+}
+
+// thread_count 0 means one per core but one (for the main thread); returns how many workers actually started
+int initialize_world_generator(WorldGenerator *gen, unsigned int seed, int thread_count, int cache_capacity) {
+
+	memset(gen, 0, sizeof(WorldGenerator));
+
+	gen->seed = seed;
+	gen->cache_capacity = cache_capacity;
+
+	int bucket_count = 1;
+
+	while (bucket_count < cache_capacity * 2) {
+		bucket_count *= 2;
+	}
+
+	gen->buckets = calloc(bucket_count, sizeof(GenChunk *));
+	gen->bucket_mask = bucket_count - 1;
+
+	pthread_mutex_init(&gen->mutex, NULL);
+	pthread_cond_init(&gen->job_available, NULL);
+
+	if (thread_count <= 0) {
+
+		thread_count = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+		if (thread_count < 1)
+			thread_count = 1;
+	}
+
+	gen->threads = malloc(sizeof(pthread_t) * thread_count);
+
+	for (gen->thread_count = 0; gen->thread_count < thread_count; gen->thread_count++) {
+
+		if (pthread_create(&gen->threads[gen->thread_count], NULL, run_worldgen_worker, gen) != 0)
+			break;
+	}
+
+	return gen->thread_count;
+}
+
+// never blocks: returns TRUE and fills in blocks (a copy, which the caller frees) if the chunk is finished (or cached),
+// otherwise makes sure it's being generated and returns FALSE, so just ask again later (or cancel_generated_chunk if it
+// isn't needed anymore: a finished chunk is kept until it's been collected one way or the other)
+int request_generated_chunk(WorldGenerator *gen, int x, int y, int z, ChunkBlocks *blocks) {
+
+	pthread_mutex_lock(&gen->mutex);
+
+	GenChunk *chunk = get_or_create_gen_chunk(gen, x, y, z);
+
+	if (chunk->stage == WORLDGEN_DONE) {
+
+		copy_chunk_blocks(blocks, &chunk->finished);
+		chunk->wanted = FALSE;
+
+		pthread_mutex_unlock(&gen->mutex);
+
+		return TRUE;
+	}
+
+	if (!chunk->wanted) {
+
+		chunk->wanted = TRUE;
+
+		// (the neighbors' earlier stages will schedule this chunk's features stage once they're all through)
+		FOR_EACH_FEATURE_NEIGHBOR(dx, dy, dz) {
+			schedule_gen_chunk(gen, get_or_create_gen_chunk(gen, x + dx, y + dy, z + dz));
+		}
+	}
+
+	pthread_mutex_unlock(&gen->mutex);
+
+	return FALSE;
+}
+
+// for a chunk that was asked for but won't be asked for again: it stops being generated if it isn't finished already
+// (unless something else needs it), and can be evicted if it is
+void cancel_generated_chunk(WorldGenerator *gen, int x, int y, int z) {
+
+	pthread_mutex_lock(&gen->mutex);
+
+	GenChunk *chunk = find_gen_chunk(gen, x, y, z);
+
+	if (chunk)
+		chunk->wanted = FALSE;
+
+	pthread_mutex_unlock(&gen->mutex);
+}
+
+void free_world_generator(WorldGenerator *gen) {
+
+	pthread_mutex_lock(&gen->mutex);
+	gen->stopping = TRUE;
+	pthread_cond_broadcast(&gen->job_available);
+	pthread_mutex_unlock(&gen->mutex);
+
+	for (int i = 0; i < gen->thread_count; i++) {
+		pthread_join(gen->threads[i], NULL);
+	}
+
+	while (gen->lru_head) {
+		evict_gen_chunk(gen, gen->lru_head);
+	}
+
+	pthread_mutex_destroy(&gen->mutex);
+	pthread_cond_destroy(&gen->job_available);
+
+	free(gen->threads);
+	free(gen->buckets);
+}
+
+#endif
@@ -0,0 +1,337 @@
+#ifndef CLIENTS_DEFINED
+
+#define CLIENTS_DEFINED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "../../util.c"
+#include "net.c"
+
+// every connection, and the single threaded epoll loop that services them
+// nothing here ever blocks: reads take whatever has arrived, sends queue into the client's ring buffer and get flushed
+// when the socket has room, and a client that lets its ring buffer fill up gets disconnected instead of waited on
+
+typedef struct Clients Clients;
+
+typedef struct {
+
+	int socket;
+	int id;    // unique for the server's lifetime
+	int index; // in all_clients->clients
+
+	int closing; // disconnect_client was called, the socket gets closed after the current round of events
+	int pending; // in all_clients->pending (has sends that haven't been flushed yet)
+	int polling_writes; // registered for EPOLLOUT, because the socket couldn't take everything last time
+
+	RingBuffer incoming;
+	RingBuffer outgoing;
+
+	Clients *all_clients;
+	void *data; // belongs to game.c
+
+} Client;
+
+struct Clients {
+
+	int epoll;
+	int listener;
+	int spare_descriptor; // given up to accept (and immediately close) a connection when we're out of descriptors
+
+	Client **clients;
+	int count;
+	int capacity;
+
+	Client **pending; // clients with unflushed sends
+	int pending_count;
+
+	Client **closing; // clients to close once the current round of events is done
+	int closing_count;
+
+	int next_id;
+	unsigned int tick;
+};
+
+// from game.c
+void on_client_connect(Clients *all_clients, Client *client);
+void on_client_disconnect(Clients *all_clients, Client *client);
+void on_client_message(Clients *all_clients, Client *client, const unsigned char *message, int length);
+
+// grows a list of clients to fit count + 1 (all three lists share a capacity, since none can hold more than every client)
+static void reserve_client_lists(Clients *all_clients) {
+
+	if (all_clients->count < all_clients->capacity)
+		return;
+
+	all_clients->capacity = all_clients->capacity ? all_clients->capacity * 2 : 256;
+	all_clients->clients = realloc(all_clients->clients, sizeof(Client *) * all_clients->capacity);
+	all_clients->pending = realloc(all_clients->pending, sizeof(Client *) * all_clients->capacity);
+	all_clients->closing = realloc(all_clients->closing, sizeof(Client *) * all_clients->capacity);
+}
+
+// the socket gets closed (and on_client_disconnect called) after the current round of events, so it's safe to call
+// from anywhere, including while iterating over all_clients
+void disconnect_client(Client *client) {
+
+	if (client->closing)
+		return;
+
+	client->closing = TRUE;
+	client->all_clients->closing[client->all_clients->closing_count++] = client;
+}
+
+// queues one message, returns FALSE (and disconnects the client) if it's so far behind that there's no room for it
+int send_to_client(Client *client, const void *message, int length) {
+
+	if (client->closing)
+		return FALSE;
+
+	if (!write_message(&client->outgoing, message, length)) {
+		disconnect_client(client);
+		return FALSE;
+	}
+
+	if (!client->pending) {
+		client->pending = TRUE;
+		client->all_clients->pending[client->all_clients->pending_count++] = client;
+	}
+
+	return TRUE;
+}
+
+// how many bytes of messages (headers included) can be sent right now without disconnecting the client, for sends that
+// can wait a tick or two (like chunks)
+int get_client_send_space(const Client *client) {
+
+	return client->closing ? 0 : get_ring_buffer_space(&client->outgoing);
+}
+
+// returns FALSE on error
+int initialize_clients(Clients *all_clients, int port) {
+
+	memset(all_clients, 0, sizeof(Clients));
+
+	all_clients->listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+	if (all_clients->listener == -1)
+		return FALSE;
+
+	int reuse = 1;
+	setsockopt(all_clients->listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in address = {0};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (bind(all_clients->listener, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(all_clients->listener, SOMAXCONN) == -1) {
+		close(all_clients->listener);
+		return FALSE;
+	}
+
+	all_clients->epoll = epoll_create1(0);
+
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL }; // NULL is the listener
+	epoll_ctl(all_clients->epoll, EPOLL_CTL_ADD, all_clients->listener, &event);
+
+	all_clients->spare_descriptor = open("/dev/null", O_RDONLY);
+
+	return TRUE;
+}
+
+static void accept_clients(Clients *all_clients) {
+
+	while (TRUE) {
+
+		int socket = accept4(all_clients->listener, NULL, NULL, SOCK_NONBLOCK);
+
+		if (socket == -1) {
+
+			// out of descriptors: the listener would stay readable forever, so turn the connection away to clear it
+			if ((errno == EMFILE || errno == ENFILE) && all_clients->spare_descriptor != -1) {
+
+				close(all_clients->spare_descriptor);
+				close(accept(all_clients->listener, NULL, NULL));
+				all_clients->spare_descriptor = open("/dev/null", O_RDONLY);
+
+				continue;
+			}
+
+			return; // EAGAIN (no one else waiting) or a connection that died before we got to it
+		}
+
+		int no_delay = 1;
+		setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+		// the kernel would otherwise buffer megabytes for a client that isn't reading, per client, before we noticed
+		int send_buffer_size = CLIENT_SOCKET_SEND_BUFFER_SIZE;
+		setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, sizeof(send_buffer_size));
+
+		reserve_client_lists(all_clients);
+
+		Client *client = calloc(1, sizeof(Client));
+		client->socket = socket;
+		client->id = all_clients->next_id++;
+		client->index = all_clients->count;
+		client->all_clients = all_clients;
+
+		initialize_ring_buffer(&client->incoming, CLIENT_READ_BUFFER_SIZE);
+		initialize_ring_buffer(&client->outgoing, CLIENT_WRITE_BUFFER_SIZE);
+
+		all_clients->clients[all_clients->count++] = client;
+
+		struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+		epoll_ctl(all_clients->epoll, EPOLL_CTL_ADD, socket, &event);
+
+		on_client_connect(all_clients, client);
+	}
+}
+
+// reads once (level triggered, so anything left over comes back next round, and one busy client can't starve the rest)
+// then handles every complete message
+static void receive_from_client(Clients *all_clients, Client *client) {
+
+	if (receive_ring_buffer(&client->incoming, client->socket) == -1) {
+		disconnect_client(client);
+		return;
+	}
+
+	static unsigned char scratch[MAX_CLIENT_MESSAGE_SIZE];
+	const unsigned char *message;
+	int length = 0;
+
+	while (!client->closing && (length = read_message(&client->incoming, MAX_CLIENT_MESSAGE_SIZE, scratch, &message)) > 0) {
+		on_client_message(all_clients, client, message, length);
+		consume_message(&client->incoming, length);
+	}
+
+	if (length == -1)
+		disconnect_client(client);
+}
+
+static void poll_client_writes(Clients *all_clients, Client *client, int polling_writes) {
+
+	if (client->polling_writes == polling_writes)
+		return;
+
+	client->polling_writes = polling_writes;
+
+	struct epoll_event event = { .events = polling_writes ? EPOLLIN | EPOLLOUT : EPOLLIN, .data.ptr = client };
+	epoll_ctl(all_clients->epoll, EPOLL_CTL_MOD, client->socket, &event);
+}
+
+// sends as much as the socket takes, and waits for EPOLLOUT if that wasn't everything
+static void send_to_socket(Clients *all_clients, Client *client) {
+
+	if (send_ring_buffer(&client->outgoing, client->socket) == -1) {
+		disconnect_client(client);
+		return;
+	}
+
+	poll_client_writes(all_clients, client, get_ring_buffer_used(&client->outgoing) > 0);
+}
+
+// handles whatever epoll has for us, waiting at most timeout milliseconds for it
+void poll_clients(Clients *all_clients, int timeout) {
+
+	struct epoll_event events[256];
+
+	int event_count = epoll_wait(all_clients->epoll, events, 256, timeout);
+
+	for (int i = 0; i < event_count; i++) {
+
+		Client *client = events[i].data.ptr;
+
+		if (client == NULL) {
+			accept_clients(all_clients);
+			continue;
+		}
+
+		if (client->closing)
+			continue;
+
+		if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			receive_from_client(all_clients, client);
+
+		if (!client->closing && (events[i].events & EPOLLOUT))
+			send_to_socket(all_clients, client);
+	}
+}
+
+// sends everything queued since the last flush (clients whose sockets are full wait for EPOLLOUT)
+void flush_clients(Clients *all_clients) {
+
+	for (int i = 0; i < all_clients->pending_count; i++) {
+
+		Client *client = all_clients->pending[i];
+		client->pending = FALSE;
+
+		if (!client->closing && !client->polling_writes)
+			send_to_socket(all_clients, client);
+	}
+
+	all_clients->pending_count = 0;
+}
+
+// closes every client disconnect_client was called on
+void close_clients(Clients *all_clients) {
+
+	// on_client_disconnect can disconnect more clients, so this keeps going until there are none left
+	while (all_clients->closing_count) {
+
+		Client *client = all_clients->closing[--all_clients->closing_count];
+
+		on_client_disconnect(all_clients, client);
+
+		// (only if it got disconnected for falling behind since the last flush)
+		if (client->pending) {
+
+			int i = 0;
+
+			while (all_clients->pending[i] != client)
+				i++;
+
+			all_clients->pending[i] = all_clients->pending[--all_clients->pending_count];
+		}
+
+		epoll_ctl(all_clients->epoll, EPOLL_CTL_DEL, client->socket, NULL);
+		close(client->socket);
+
+		// swap the last client into its place
+		Client *last = all_clients->clients[--all_clients->count];
+		all_clients->clients[client->index] = last;
+		last->index = client->index;
+
+		free_ring_buffer(&client->incoming);
+		free_ring_buffer(&client->outgoing);
+		free(client);
+	}
+}
+
+// disconnects everyone and stops listening
+void free_clients(Clients *all_clients) {
+
+	for (int i = 0; i < all_clients->count; i++) {
+		disconnect_client(all_clients->clients[i]);
+	}
+
+	close_clients(all_clients);
+
+	close(all_clients->listener);
+	close(all_clients->epoll);
+	close(all_clients->spare_descriptor);
+
+	free(all_clients->clients);
+	free(all_clients->pending);
+	free(all_clients->closing);
+}
+
+#endif
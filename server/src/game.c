@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../../util.c"
+#include "protocol.c"
+#include "clients.c"
+#include "world.c"
+#include "player_grid.c"
+
+// the server's side of the game (see ../a.txt): the world, who's playing, and where they are
+// players only hear about what's near them: each is subscribed to the chunks in its view (and sent them, nearest first),
+// and only gets the movements of players in the grid cells its view reaches, so what a player costs depends on how
+// crowded it is around them rather than on how many players there are
+
+#define VIEW_RADIUS 6      // chunks sent around a player, horizontally
+#define VIEW_HEIGHT 1      // and vertically
+#define CHUNKS_PER_TICK 16 // most chunks sent to one player per tick (fewer if their connection is backed up)
+#define CHUNK_LOOKAHEAD 64 // most of a player's queue looked at per tick (so asked of the generator, if it isn't done)
+#define VIEW_CELLS ((VIEW_RADIUS * 16 + PLAYER_CELL_SIZE - 1) / PLAYER_CELL_SIZE) // player cells a view reaches, each way
+
+#define SPAWN_X 0.0f
+#define SPAWN_Y 22.0f
+#define SPAWN_Z 0.0f
+
+#define MAX_PLAYER_COORD 1e7f // (moves further out than this are nonsense)
+#define MAX_MOVE_PER_TICK 16.0f // from where a player started the tick (a chunk, so a view moves a chunk a tick at most)
+
+typedef struct {
+
+	int joined;
+	int moved; // since the last tick
+	float x, y, z;
+
+	// where they were at the start of move_tick, the tick they last moved in (moves that tick are kept near it)
+	float move_origin[3];
+	unsigned int move_tick;
+
+	PlayerCell *cell;
+	int view[3]; // the chunk their view is around (the one they're in)
+
+	// chunks they've subscribed to but haven't been sent yet (or generated, maybe), nearest first from chunk_queue_start on
+	ServerChunk **chunk_queue;
+	int chunk_queue_start;
+	int chunk_queue_count;
+	int chunk_queue_capacity;
+
+} ServerPlayer;
+
+ServerWorld server_world;
+PlayerGrid player_grid;
+unsigned int world_seed = 1;
+
+int player_count = 0;
+
+// players who moved since the last tick (so building the tick's updates doesn't look at anyone who didn't)
+static Client **moved_clients = NULL;
+static int moved_count = 0;
+static int moved_capacity = 0;
+
+void on_server_start() {
+
+	initialize_server_world(&server_world, world_seed);
+	initialize_player_grid(&player_grid);
+}
+
+void on_server_stop() {
+
+	free_server_world(&server_world);
+	free_player_grid(&player_grid);
+	free(moved_clients);
+}
+
+// scratch for each player's SERVER_MESSAGE_PLAYERS
+static EZArray players_message = {0};
+
+// the tick the player cells' updates and the block deltas were last built for
+static unsigned int tick_messages_tick = 0;
+
+static void queue_chunk(ServerPlayer *player, ServerChunk *chunk) {
+
+	// slides the queue back to the start once half of it's been sent, rather than growing forever
+	if (player->chunk_queue_start > player->chunk_queue_capacity / 2) {
+
+		memmove(player->chunk_queue, player->chunk_queue + player->chunk_queue_start, sizeof(ServerChunk *) * player->chunk_queue_count);
+		player->chunk_queue_start = 0;
+	}
+
+	if (player->chunk_queue_start + player->chunk_queue_count == player->chunk_queue_capacity) {
+		player->chunk_queue_capacity = player->chunk_queue_capacity ? player->chunk_queue_capacity * 2 : 64;
+		player->chunk_queue = realloc(player->chunk_queue, sizeof(ServerChunk *) * player->chunk_queue_capacity);
+	}
+
+	player->chunk_queue[player->chunk_queue_start + player->chunk_queue_count++] = chunk;
+}
+
+// the view qsort is sorting a queue around (qsort doesn't take a context)
+static const int *sorting_view;
+
+static int compare_queued_chunks(const void *a, const void *b) {
+
+	const ServerChunk *chunk_a = *(ServerChunk *const *) a;
+	const ServerChunk *chunk_b = *(ServerChunk *const *) b;
+
+	int ax = chunk_a->x - sorting_view[0], ay = chunk_a->y - sorting_view[1], az = chunk_a->z - sorting_view[2];
+	int bx = chunk_b->x - sorting_view[0], by = chunk_b->y - sorting_view[1], bz = chunk_b->z - sorting_view[2];
+
+	return (ax * ax + ay * ay + az * az) - (bx * bx + by * by + bz * bz);
+}
+
+static void subscribe_client(Client *client, int x, int y, int z) {
+
+	ServerChunk *chunk = get_server_chunk(&server_world, x, y, z);
+
+	subscribe_to_chunk(chunk, client);
+	queue_chunk(client->data, chunk);
+}
+
+static void unsubscribe_client(Client *client, int x, int y, int z) {
+
+	ServerChunk *chunk = find_server_chunk(&server_world, x, y, z);
+
+	unsubscribe_from_chunk(chunk, client);
+	release_server_chunk(&server_world, chunk);
+}
+
+// calls visit on every chunk in the view around a that isn't in the view around b (b can be NULL, for none), skipping
+// straight over the overlap so only the chunks that actually changed get touched
+static void visit_view_difference(const int *a, const int *b, Client *client, void (*visit)(Client *client, int x, int y, int z)) {
+
+	for (int x = a[0] - VIEW_RADIUS; x <= a[0] + VIEW_RADIUS; x++)
+		for (int y = a[1] - VIEW_HEIGHT; y <= a[1] + VIEW_HEIGHT; y++) {
+
+			// where this row overlaps b's view (nowhere, if it's outside it in x or y)
+			int overlap_start = 1;
+			int overlap_end = 0;
+
+			if (b && abs(x - b[0]) <= VIEW_RADIUS && abs(y - b[1]) <= VIEW_HEIGHT) {
+				overlap_start = b[2] - VIEW_RADIUS;
+				overlap_end = b[2] + VIEW_RADIUS;
+			}
+
+			for (int z = a[2] - VIEW_RADIUS; z <= a[2] + VIEW_RADIUS; z++) {
+
+				if (z >= overlap_start && z <= overlap_end) {
+					z = overlap_end;
+					continue;
+				}
+
+				visit(client, x, y, z);
+			}
+		}
+}
+
+// moves a player's view from around one chunk to around another (either can be NULL, for joining and leaving)
+static void move_view(Client *client, const int *old_view, const int *new_view) {
+
+	ServerPlayer *player = client->data;
+
+	if (new_view) {
+
+		// drops what they've moved away from before it's sent (so each chunk is in the queue at most once), before
+		// unsubscribing frees it
+		int kept = 0;
+
+		for (int i = 0; i < player->chunk_queue_count; i++) {
+
+			ServerChunk *chunk = player->chunk_queue[player->chunk_queue_start + i];
+
+			if (abs(chunk->x - new_view[0]) <= VIEW_RADIUS && abs(chunk->y - new_view[1]) <= VIEW_HEIGHT && abs(chunk->z - new_view[2]) <= VIEW_RADIUS)
+				player->chunk_queue[player->chunk_queue_start + kept++] = chunk;
+		}
+
+		player->chunk_queue_count = kept;
+	}
+
+	if (old_view)
+		visit_view_difference(old_view, new_view, client, unsubscribe_client);
+
+	if (new_view) {
+
+		visit_view_difference(new_view, old_view, client, subscribe_client);
+
+		// the whole queue, since what's nearest changed for what was already in it too
+		sorting_view = new_view;
+		qsort(player->chunk_queue + player->chunk_queue_start, player->chunk_queue_count, sizeof(ServerChunk *), compare_queued_chunks);
+	}
+}
+
+static void move_player(Client *client, float x, float y, float z) {
+
+	ServerPlayer *player = client->data;
+
+	player->x = x;
+	player->y = y;
+	player->z = z;
+
+	if (!player->moved) {
+
+		if (moved_count == moved_capacity) {
+			moved_capacity = moved_capacity ? moved_capacity * 2 : 64;
+			moved_clients = realloc(moved_clients, sizeof(Client *) * moved_capacity);
+		}
+
+		moved_clients[moved_count++] = client;
+		player->moved = TRUE;
+	}
+
+	PlayerCell *cell = get_player_cell(&player_grid, BLOCK_TO_PLAYER_CELL(x), BLOCK_TO_PLAYER_CELL(z));
+
+	if (cell != player->cell) {
+
+		if (player->cell)
+			remove_from_player_cell(&player_grid, player->cell, client);
+
+		add_to_player_cell(cell, client);
+		player->cell = cell;
+	}
+
+	int view[3] = { BLOCK_TO_CHUNK((int) floorf(x)), BLOCK_TO_CHUNK((int) floorf(y)), BLOCK_TO_CHUNK((int) floorf(z)) };
+
+	if (!player->joined) {
+
+		move_view(client, NULL, view);
+
+	} else if (view[0] != player->view[0] || view[1] != player->view[1] || view[2] != player->view[2]) {
+
+		move_view(client, player->view, view);
+	}
+
+	memcpy(player->view, view, sizeof(view));
+}
+
+void on_client_connect(Clients *all_clients, Client *client) {
+
+	client->data = calloc(1, sizeof(ServerPlayer));
+}
+
+void on_client_disconnect(Clients *all_clients, Client *client) {
+
+	ServerPlayer *player = client->data;
+
+	if (player->joined) {
+
+		player_count--;
+
+		move_view(client, player->view, NULL);
+		remove_from_player_cell(&player_grid, player->cell, client);
+
+		for (int i = 0; player->moved && i < moved_count; i++) {
+
+			if (moved_clients[i] == client) {
+				moved_clients[i] = moved_clients[--moved_count];
+				break;
+			}
+		}
+	}
+
+	free(player->chunk_queue);
+	free(player);
+}
+
+void on_client_message(Clients *all_clients, Client *client, const unsigned char *message, int length) {
+
+	ServerPlayer *player = client->data;
+
+	if (message[0] == CLIENT_MESSAGE_JOIN && length == 1 && !player->joined) {
+
+		move_player(client, SPAWN_X, SPAWN_Y, SPAWN_Z);
+
+		player->move_origin[0] = SPAWN_X;
+		player->move_origin[1] = SPAWN_Y;
+		player->move_origin[2] = SPAWN_Z;
+		player->move_tick = all_clients->tick;
+
+		player->joined = TRUE;
+		player_count++;
+
+		unsigned char welcome[5] = { SERVER_MESSAGE_WELCOME };
+		put_message_uint(welcome + 1, client->id);
+
+		send_to_client(client, welcome, sizeof(welcome));
+
+	} else if (message[0] == CLIENT_MESSAGE_MOVE && length == 13 && player->joined) {
+
+		float x = get_message_float(message + 1);
+		float y = get_message_float(message + 5);
+		float z = get_message_float(message + 9);
+
+		// (fabsf is false for NaN too)
+		if (!(fabsf(x) < MAX_PLAYER_COORD && fabsf(y) < MAX_PLAYER_COORD && fabsf(z) < MAX_PLAYER_COORD)) {
+			disconnect_client(client);
+			return;
+		}
+
+		if (player->move_tick != all_clients->tick) {
+			player->move_origin[0] = player->x;
+			player->move_origin[1] = player->y;
+			player->move_origin[2] = player->z;
+			player->move_tick = all_clients->tick;
+		}
+
+		// moves too far get cut short, so a player can only drag their view (and the chunks it subscribes to) across
+		// the world so fast
+		float dx = x - player->move_origin[0], dy = y - player->move_origin[1], dz = z - player->move_origin[2];
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+		if (distance > MAX_MOVE_PER_TICK) {
+			x = player->move_origin[0] + dx * (MAX_MOVE_PER_TICK / distance);
+			y = player->move_origin[1] + dy * (MAX_MOVE_PER_TICK / distance);
+			z = player->move_origin[2] + dz * (MAX_MOVE_PER_TICK / distance);
+		}
+
+		move_player(client, x, y, z);
+
+	} else if (message[0] == CLIENT_MESSAGE_SET_BLOCK && length == 14 && player->joined && message[13] <= BLOCK_LEAVES) {
+
+		int x = get_message_uint(message + 1);
+		int y = get_message_uint(message + 5);
+		int z = get_message_uint(message + 9);
+
+		// only in chunks they've been sent, so it's somewhere they can see (otherwise it's ignored, since a player can
+		// change a block just as its chunk leaves their view)
+		ServerChunk *chunk = find_server_chunk(&server_world, BLOCK_TO_CHUNK(x), BLOCK_TO_CHUNK(y), BLOCK_TO_CHUNK(z));
+		ChunkSubscriber *subscription = chunk ? find_chunk_subscriber(chunk, client) : NULL;
+
+		// (goes out to the chunk's subscribers at the next tick, batched with every other change to the chunk)
+		if (subscription && subscription->sent)
+			set_server_block(&server_world, x, y, z, message[13]);
+
+	} else {
+		disconnect_client(client); // doesn't speak the protocol
+	}
+}
+
+// adds every player that moved since the last tick to their cell's updates, once, for everyone near it to share
+static void build_cell_updates(unsigned int tick) {
+
+	for (int i = 0; i < moved_count; i++) {
+
+		ServerPlayer *player = moved_clients[i]->data;
+		PlayerCell *cell = player->cell;
+
+		if (cell->updates_tick != tick) {
+			cell->updates.bytecount = 0;
+			cell->updates_tick = tick;
+		}
+
+		unsigned char update[PLAYER_UPDATE_SIZE];
+		put_message_uint(update, moved_clients[i]->id);
+		put_message_float(update + 4, player->x);
+		put_message_float(update + 8, player->y);
+		put_message_float(update + 12, player->z);
+
+		append_ezarray(&cell->updates, update, PLAYER_UPDATE_SIZE);
+
+		player->moved = FALSE;
+	}
+
+	moved_count = 0;
+}
+
+// one message per changed chunk, however many blocks changed in it, to whoever's been sent the chunk
+static void send_block_deltas() {
+
+	for (int i = 0; i < server_world.delta_count; i++) {
+
+		const BlockDelta *delta = &server_world.deltas[i];
+
+		for (int j = 0; j < delta->chunk->subscriber_count; j++) {
+
+			if (delta->chunk->subscribers[j].sent)
+				send_to_client(delta->chunk->subscribers[j].subscriber, delta->message, delta->length);
+		}
+	}
+}
+
+// the updates from the cells around the player, even if there aren't any (it's also their tick)
+static void send_players_message(Client *client, ServerPlayer *player, unsigned int tick) {
+
+	unsigned char header[5] = { SERVER_MESSAGE_PLAYERS };
+	put_message_uint(header + 1, tick);
+
+	players_message.bytecount = 0;
+	append_ezarray(&players_message, header, sizeof(header));
+
+	for (int x = player->cell->x - VIEW_CELLS; x <= player->cell->x + VIEW_CELLS; x++)
+		for (int z = player->cell->z - VIEW_CELLS; z <= player->cell->z + VIEW_CELLS; z++) {
+
+			const PlayerCell *cell = find_player_cell(&player_grid, x, z);
+
+			if (cell && cell->updates_tick == tick)
+				append_ezarray(&players_message, cell->updates.data, cell->updates.bytecount);
+		}
+
+	send_to_client(client, players_message.data, players_message.bytecount);
+}
+
+// sends the next few chunks in the player's queue that have been generated, as long as their connection keeps up, while
+// the generator works on the ones it hasn't finished yet (the encoded chunks are cached in the world, so players in the
+// same area all get the same encode)
+static void send_chunks(Client *client, ServerPlayer *player) {
+
+	ServerChunk **queue = player->chunk_queue + player->chunk_queue_start;
+
+	int sent = 0;
+	int looked = 0;
+	int waiting = 0; // of the chunks looked at, ones that aren't generated yet (moved up to the front as they're found)
+
+	while (sent < CHUNKS_PER_TICK && looked < CHUNK_LOOKAHEAD && looked < player->chunk_queue_count) {
+
+		// leaves room for everything else, and waits for the client to catch up instead of dropping it
+		if (get_client_send_space(client) < MESSAGE_HEADER_SIZE + CHUNK_MESSAGE_HEADER_SIZE + MAX_ENCODED_CHUNK_SIZE + CLIENT_WRITE_BUFFER_SIZE / 4)
+			break;
+
+		ServerChunk *chunk = queue[looked++];
+		ChunkSubscriber *subscription = find_chunk_subscriber(chunk, client);
+
+		if (!subscription || subscription->sent)
+			continue;
+
+		if (!generate_server_chunk(&server_world, chunk)) {
+			queue[waiting++] = chunk;
+			continue;
+		}
+
+		int length;
+		const unsigned char *message = get_chunk_message(&server_world, chunk, &length);
+
+		send_to_client(client, message, length);
+		subscription->sent = TRUE;
+		sent++;
+	}
+
+	// the waiting ones go back in front of the ones that weren't looked at, still nearest first
+	memmove(queue + looked - waiting, queue, sizeof(ServerChunk *) * waiting);
+
+	player->chunk_queue_start += looked - waiting;
+	player->chunk_queue_count -= looked - waiting;
+
+	if (player->chunk_queue_count == 0)
+		player->chunk_queue_start = 0;
+}
+
+void on_server_tick(Clients *all_clients, Client *client) {
+
+	ServerPlayer *player = client->data;
+
+	if (tick_messages_tick != all_clients->tick) {
+
+		build_cell_updates(all_clients->tick);
+
+		// (before anyone's send_chunks, whose chunks are up to date)
+		collect_block_deltas(&server_world);
+		send_block_deltas();
+
+		tick_messages_tick = all_clients->tick;
+	}
+
+	if (!player->joined)
+		return;
+
+	send_players_message(client, player, all_clients->tick);
+	send_chunks(client, player);
+}
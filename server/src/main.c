@@ -0,0 +1,126 @@
+#define _GNU_SOURCE // for accept4
+
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "../../util.c"
+#include "protocol.c"
+#include "net.c"
+#include "clients.c"
+#include "world.c"
+#include "player_grid.c"
+#include "game.c"
+
+#define SERVER_PORT 25565
+#define TICKS_PER_SECOND 20
+#define MAX_TICKS_BEHIND 5 // if the server falls further behind than this, it skips ticks instead of spiraling
+#define TICK_REPORT_SECONDS 10
+
+static volatile sig_atomic_t running = TRUE;
+
+static void stop_running(int signal) {
+
+	running = FALSE;
+}
+
+static double get_seconds() {
+
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// one round of work for every client, then everything it sent goes out
+static void run_tick(Clients *all_clients) {
+
+	all_clients->tick++;
+
+	for (int i = 0; i < all_clients->count; i++) {
+		on_server_tick(all_clients, all_clients->clients[i]);
+	}
+
+	flush_clients(all_clients);
+	close_clients(all_clients);
+}
+
+int main(int argc, char **argv) {
+
+	int port = argc > 1 ? atoi(argv[1]) : SERVER_PORT;
+
+	// every connection is a descriptor, and the default limit (usually 1024) is nowhere near enough
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	Clients all_clients;
+
+	if (!initialize_clients(&all_clients, port)) {
+		fprintf(stderr, "\nCould not listen on port %d\n\n", port);
+		return 1;
+	}
+
+	printf("Starting CinnamonCraft server on port %d\n", port);
+
+	on_server_start();
+
+	const double tick_length = 1.0 / TICKS_PER_SECOND;
+	double next_tick = get_seconds() + tick_length;
+
+	double tick_time = 0;
+	double worst_tick_time = 0;
+
+	while (running) {
+
+		// handle whatever comes in until the next tick is due
+		double timeout = next_tick - get_seconds();
+
+		poll_clients(&all_clients, timeout > 0 ? (int) (timeout * 1000) + 1 : 0);
+		flush_clients(&all_clients);
+		close_clients(&all_clients);
+
+		double now = get_seconds();
+
+		if (now - next_tick > tick_length * MAX_TICKS_BEHIND)
+			next_tick = now - tick_length * MAX_TICKS_BEHIND;
+
+		while (now >= next_tick) {
+
+			run_tick(&all_clients);
+
+			double tick_end = get_seconds();
+
+			tick_time += tick_end - now;
+			worst_tick_time = tick_end - now > worst_tick_time ? tick_end - now : worst_tick_time;
+
+			now = tick_end;
+			next_tick += tick_length;
+
+			if (all_clients.tick % (TICKS_PER_SECOND * TICK_REPORT_SECONDS) == 0) {
+
+				printf("tick %u: %d connections, %d players, %.3f ms average tick, %.3f ms worst, %d chunks, %ld of %ld chunk sends encoded\n",
+					all_clients.tick, all_clients.count, player_count, tick_time * 1000 / (TICKS_PER_SECOND * TICK_REPORT_SECONDS), worst_tick_time * 1000,
+					server_world.chunk_count, server_world.chunk_encodes, server_world.chunk_messages);
+				fflush(stdout);
+
+				tick_time = 0;
+				worst_tick_time = 0;
+			}
+		}
+	}
+
+	printf("Stopping CinnamonCraft server\n");
+
+	free_clients(&all_clients);
+	on_server_stop();
+
+	return 0;
+}
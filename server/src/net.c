@@ -0,0 +1,221 @@
+#ifndef NET_DEFINED
+
+#define NET_DEFINED
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "../../util.c"
+#include "protocol.c"
+
+// non-blocking sockets with a ring buffer each way, and length-prefixed messages:
+// every message is a 4 byte little endian length, then that many bytes
+
+#define MESSAGE_HEADER_SIZE 4
+#define MAX_CLIENT_MESSAGE_SIZE 4096 // client -> server, anything bigger is a protocol error
+
+#define CLIENT_READ_BUFFER_SIZE 8192    // must fit a whole MAX_CLIENT_MESSAGE_SIZE message plus its header
+#define CLIENT_WRITE_BUFFER_SIZE 262144 // if a client falls this far behind, it gets dropped instead of stalling the tick
+#define CLIENT_SOCKET_SEND_BUFFER_SIZE 65536
+
+// head and tail count up forever (wrapping at 2^32), so used bytes is always tail - head, and capacity must be a power of 2
+typedef struct {
+
+	unsigned char *data; // allocated on first use, so idle connections cost next to nothing
+	uint32_t capacity;
+	uint32_t head; // next byte to read
+	uint32_t tail; // next byte to write
+
+} RingBuffer;
+
+static inline uint32_t get_ring_buffer_used(const RingBuffer *ring) {
+
+	return ring->tail - ring->head;
+}
+
+static inline uint32_t get_ring_buffer_space(const RingBuffer *ring) {
+
+	return ring->capacity - (ring->tail - ring->head);
+}
+
+void initialize_ring_buffer(RingBuffer *ring, uint32_t capacity) {
+
+	memset(ring, 0, sizeof(RingBuffer));
+	ring->capacity = capacity;
+}
+
+void free_ring_buffer(RingBuffer *ring) {
+
+	free(ring->data);
+	initialize_ring_buffer(ring, ring->capacity);
+}
+
+// returns FALSE if out of memory
+static int allocate_ring_buffer(RingBuffer *ring) {
+
+	if (!ring->data)
+		ring->data = malloc(ring->capacity);
+
+	return ring->data != NULL;
+}
+
+// copies length bytes in, all or nothing, returns FALSE if they don't fit
+int write_ring_buffer(RingBuffer *ring, const void *data, uint32_t length) {
+
+	if (length > get_ring_buffer_space(ring) || !allocate_ring_buffer(ring))
+		return FALSE;
+
+	uint32_t start = ring->tail & (ring->capacity - 1);
+	uint32_t first = ring->capacity - start < length ? ring->capacity - start : length;
+
+	memcpy(ring->data + start, data, first);
+	memcpy(ring->data, (const unsigned char *) data + first, length - first);
+
+	ring->tail += length;
+
+	return TRUE;
+}
+
+// copies length bytes starting offset bytes past the head, without consuming them (the caller makes sure they're there)
+void peek_ring_buffer(const RingBuffer *ring, uint32_t offset, void *data, uint32_t length) {
+
+	uint32_t start = (ring->head + offset) & (ring->capacity - 1);
+	uint32_t first = ring->capacity - start < length ? ring->capacity - start : length;
+
+	memcpy(data, ring->data + start, first);
+	memcpy((unsigned char *) data + first, ring->data, length - first);
+}
+
+// returns a pointer to length bytes starting offset bytes past the head if they don't wrap around the end, NULL otherwise
+const unsigned char *get_ring_buffer_span(const RingBuffer *ring, uint32_t offset, uint32_t length) {
+
+	uint32_t start = (ring->head + offset) & (ring->capacity - 1);
+
+	return ring->capacity - start >= length ? ring->data + start : NULL;
+}
+
+static inline void consume_ring_buffer(RingBuffer *ring, uint32_t length) {
+
+	ring->head += length;
+
+	// back to the start when empty, so the next message is less likely to wrap
+	if (ring->head == ring->tail)
+		ring->head = ring->tail = 0;
+}
+
+// reads whatever the socket has, up to the free space, returns the number of bytes read, 0 if there was nothing to read
+// (or no space), or -1 if the connection closed or failed
+int receive_ring_buffer(RingBuffer *ring, int socket) {
+
+	uint32_t space = get_ring_buffer_space(ring);
+
+	if (space == 0)
+		return 0;
+
+	if (!allocate_ring_buffer(ring))
+		return -1;
+
+	uint32_t start = ring->tail & (ring->capacity - 1);
+	uint32_t first = ring->capacity - start < space ? ring->capacity - start : space;
+
+	struct iovec spans[2] = {
+		{ ring->data + start, first },
+		{ ring->data, space - first }
+	};
+
+	ssize_t received = readv(socket, spans, space > first ? 2 : 1);
+
+	if (received > 0) {
+		ring->tail += received;
+		return received;
+	}
+
+	if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return 0;
+
+	return -1;
+}
+
+// writes as much as the socket will take without blocking, returns the number of bytes written or -1 on error
+int send_ring_buffer(RingBuffer *ring, int socket) {
+
+	uint32_t used = get_ring_buffer_used(ring);
+
+	if (used == 0)
+		return 0;
+
+	uint32_t start = ring->head & (ring->capacity - 1);
+	uint32_t first = ring->capacity - start < used ? ring->capacity - start : used;
+
+	struct iovec spans[2] = {
+		{ ring->data + start, first },
+		{ ring->data, used - first }
+	};
+
+	struct msghdr message = { .msg_iov = spans, .msg_iovlen = used > first ? 2 : 1 };
+
+	ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+
+	if (sent >= 0) {
+		consume_ring_buffer(ring, sent);
+		return sent;
+	}
+
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		return 0;
+
+	return -1;
+}
+
+// appends one length-prefixed message, all or nothing, returns FALSE if it doesn't fit
+int write_message(RingBuffer *ring, const void *data, uint32_t length) {
+
+	if (MESSAGE_HEADER_SIZE + length > get_ring_buffer_space(ring))
+		return FALSE;
+
+	unsigned char header[MESSAGE_HEADER_SIZE];
+	put_message_uint(header, length);
+
+	return write_ring_buffer(ring, header, MESSAGE_HEADER_SIZE) && write_ring_buffer(ring, data, length);
+}
+
+// finds the next complete message, returns its length (and points message at it), 0 if it hasn't all arrived yet, or -1
+// if it's empty or longer than max_length
+// message points into the ring when the message is in one piece, otherwise into scratch (which must fit max_length),
+// and either way stays valid until consume_message
+int read_message(RingBuffer *ring, uint32_t max_length, unsigned char *scratch, const unsigned char **message) {
+
+	if (get_ring_buffer_used(ring) < MESSAGE_HEADER_SIZE)
+		return 0;
+
+	unsigned char header[MESSAGE_HEADER_SIZE];
+	peek_ring_buffer(ring, 0, header, MESSAGE_HEADER_SIZE);
+
+	uint32_t length = get_message_uint(header);
+
+	if (length > max_length || length == 0)
+		return -1;
+
+	if (get_ring_buffer_used(ring) < MESSAGE_HEADER_SIZE + length)
+		return 0;
+
+	*message = get_ring_buffer_span(ring, MESSAGE_HEADER_SIZE, length);
+
+	if (*message == NULL) {
+		peek_ring_buffer(ring, MESSAGE_HEADER_SIZE, scratch, length);
+		*message = scratch;
+	}
+
+	return length;
+}
+
+static inline void consume_message(RingBuffer *ring, uint32_t length) {
+
+	consume_ring_buffer(ring, MESSAGE_HEADER_SIZE + length);
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef PLAYER_GRID_DEFINED
+
+#define PLAYER_GRID_DEFINED
+
+#include <stdlib.h>
+#include <string.h>
+#include "../../util.c"
+
+// a spatial hash of players: the world's x/z plane is split into PLAYER_CELL_SIZE block square cells (players only spread
+// out a little vertically), and each cell that has players in it is in a hash table with the players in it
+// so finding who's near a player only looks at a few cells around them, however many players there are in total
+
+#define PLAYER_CELL_SIZE 64
+
+#define BLOCK_TO_PLAYER_CELL(coord) ((int) floorf((coord) / PLAYER_CELL_SIZE))
+
+typedef struct PlayerCell {
+
+	int x, z; // cell coordinates (block coordinates / PLAYER_CELL_SIZE)
+
+	void **members; // (game.c's clients)
+	int member_count;
+	int member_capacity;
+
+	// the player updates from this cell for tick updates_tick, built once and sent to everyone near it
+	EZArray updates;
+	unsigned int updates_tick;
+
+	struct PlayerCell *next_in_bucket;
+
+} PlayerCell;
+
+typedef struct {
+
+	// chained hash table, doubling whenever there are more cells than buckets (a cell's freed once its last player leaves,
+	// so this only holds the cells players are in)
+	PlayerCell **buckets;
+	int bucket_mask;
+	int cell_count;
+
+} PlayerGrid;
+
+static unsigned int hash_player_cell_coords(int x, int z) {
+
+	return ((unsigned int) x * 73856093u) ^ ((unsigned int) z * 83492791u);
+}
+
+void initialize_player_grid(PlayerGrid *grid) {
+
+	memset(grid, 0, sizeof(PlayerGrid));
+
+	grid->buckets = calloc(256, sizeof(PlayerCell *));
+	grid->bucket_mask = 255;
+}
+
+void free_player_grid(PlayerGrid *grid) {
+
+	for (int i = 0; i <= grid->bucket_mask; i++) {
+
+		PlayerCell *cell = grid->buckets[i];
+
+		while (cell) {
+
+			PlayerCell *next = cell->next_in_bucket;
+
+			free(cell->members);
+			free(cell->updates.data);
+			free(cell);
+
+			cell = next;
+		}
+	}
+
+	free(grid->buckets);
+}
+
+// returns NULL if no one's in the cell
+PlayerCell *find_player_cell(const PlayerGrid *grid, int x, int z) {
+
+	PlayerCell *cell = grid->buckets[hash_player_cell_coords(x, z) & grid->bucket_mask];
+
+	while (cell && (cell->x != x || cell->z != z)) {
+		cell = cell->next_in_bucket;
+	}
+
+	return cell;
+}
+
+static void grow_player_grid(PlayerGrid *grid) {
+
+	int bucket_count = (grid->bucket_mask + 1) * 2;
+	PlayerCell **buckets = calloc(bucket_count, sizeof(PlayerCell *));
+
+	for (int i = 0; i <= grid->bucket_mask; i++) {
+
+		PlayerCell *cell = grid->buckets[i];
+
+		while (cell) {
+
+			PlayerCell *next = cell->next_in_bucket;
+			unsigned int bucket = hash_player_cell_coords(cell->x, cell->z) & (bucket_count - 1);
+
+			cell->next_in_bucket = buckets[bucket];
+			buckets[bucket] = cell;
+
+			cell = next;
+		}
+	}
+
+	free(grid->buckets);
+	grid->buckets = buckets;
+	grid->bucket_mask = bucket_count - 1;
+}
+
+PlayerCell *get_player_cell(PlayerGrid *grid, int x, int z) {
+
+	PlayerCell *cell = find_player_cell(grid, x, z);
+
+	if (cell)
+		return cell;
+
+	if (grid->cell_count > grid->bucket_mask)
+		grow_player_grid(grid);
+
+	cell = calloc(1, sizeof(PlayerCell));
+	cell->x = x;
+	cell->z = z;
+
+	unsigned int bucket = hash_player_cell_coords(x, z) & grid->bucket_mask;
+	cell->next_in_bucket = grid->buckets[bucket];
+	grid->buckets[bucket] = cell;
+	grid->cell_count++;
+
+	return cell;
+}
+
+void add_to_player_cell(PlayerCell *cell, void *member) {
+
+	if (cell->member_count == cell->member_capacity) {
+		cell->member_capacity = cell->member_capacity ? cell->member_capacity * 2 : 8;
+		cell->members = realloc(cell->members, sizeof(void *) * cell->member_capacity);
+	}
+
+	cell->members[cell->member_count++] = member;
+}
+
+// frees the cell if that was the last player in it
+void remove_from_player_cell(PlayerGrid *grid, PlayerCell *cell, void *member) {
+
+	for (int i = 0; i < cell->member_count; i++) {
+
+		if (cell->members[i] == member) {
+			cell->members[i] = cell->members[--cell->member_count];
+			break;
+		}
+	}
+
+	if (cell->member_count)
+		return;
+
+	PlayerCell **link = &grid->buckets[hash_player_cell_coords(cell->x, cell->z) & grid->bucket_mask];
+
+	while (*link != cell) {
+		link = &(*link)->next_in_bucket;
+	}
+
+	*link = cell->next_in_bucket;
+	grid->cell_count--;
+
+	free(cell->members);
+	free(cell->updates.data);
+	free(cell);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef PROTOCOL_DEFINED
+
+#define PROTOCOL_DEFINED
+
+#include <stdint.h>
+#include <string.h>
+
+// what goes inside each length-prefixed message (see net.c): a type byte, then that type's fields, little endian
+
+// client -> server
+#define CLIENT_MESSAGE_JOIN 1      // nothing else, a connection doesn't get any updates until it joins
+#define CLIENT_MESSAGE_MOVE 2      // float x, y, z
+#define CLIENT_MESSAGE_SET_BLOCK 3 // int32 x, y, z, uint8 block
+
+// server -> client
+#define SERVER_MESSAGE_WELCOME 1 // uint32 player id
+#define SERVER_MESSAGE_PLAYERS 2 // uint32 tick, then uint32 id, float x, y, z for every nearby player that moved since the last tick
+#define SERVER_MESSAGE_CHUNK 3   // int32 chunk x, y, z, then the blocks in ../../chunk_format.c's format
+#define SERVER_MESSAGE_BLOCK 4   // int32 x, y, z, uint8 block, when it's the only block in its chunk that changed this tick
+#define SERVER_MESSAGE_BLOCKS 5  // int32 chunk x, y, z, then every block in it that changed this tick, as block changes (see
+                                 // ../../chunk_format.c)
+
+#define PLAYER_UPDATE_SIZE 16
+
+static inline void put_message_uint(unsigned char *data, uint32_t value) {
+
+	data[0] = value;
+	data[1] = value >> 8;
+	data[2] = value >> 16;
+	data[3] = value >> 24;
+}
+
+static inline uint32_t get_message_uint(const unsigned char *data) {
+
+	return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+static inline void put_message_float(unsigned char *data, float value) {
+
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	put_message_uint(data, bits);
+}
+
+static inline float get_message_float(const unsigned char *data) {
+
+	uint32_t bits = get_message_uint(data);
+	float value;
+	memcpy(&value, &bits, 4);
+
+	return value;
+}
+
+#endif
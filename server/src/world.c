@@ -0,0 +1,437 @@
+#ifndef SERVER_WORLD_DEFINED
+
+#define SERVER_WORLD_DEFINED
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../util.c"
+#include "../../chunk_format.c"
+#include "../../terrain.c"
+#include "../../client/src/worldgen.c"
+#include "protocol.c"
+
+// the server's copy of the world, which is the one that counts: a chunk is there while anyone's subscribed to it (or once
+// a block in it has changed), gets generated the first time it's sent (in the background, by the client's generator, so
+// it's the same terrain single player gets for the seed), and keeps its SERVER_MESSAGE_CHUNK around once it's been
+// encoded, so every client that needs that chunk gets the same bytes until a block in it changes
+
+#define CHUNK_MESSAGE_HEADER_SIZE 13 // type, then int32 x, y, z
+
+// past this many changes in a tick, a chunk always gets resent whole instead (no encoded chunk is bigger than this many
+// block changes), below it only when the encoded chunk is smaller than the changes
+#define MAX_BLOCK_DELTA_CHANGES (MAX_ENCODED_CHUNK_SIZE / BLOCK_CHANGE_SIZE + 1)
+
+// which blocks in a chunk changed since the last tick's deltas went out
+typedef struct {
+
+	uint64_t changed[64]; // bit per block, so a block changed twice is only sent once
+	unsigned short indices[MAX_BLOCK_DELTA_CHANGES]; // x * 256 + y * 16 + z, in the order they changed
+	int count; // past MAX_BLOCK_DELTA_CHANGES, the whole chunk gets resent (and indices stops being kept up)
+
+} BlockChanges;
+
+typedef struct {
+
+	void *subscriber; // (game.c's clients)
+	int sent;         // whether the subscriber has the chunk yet (so whether it needs to hear about changes to it)
+
+} ChunkSubscriber;
+
+typedef struct ServerChunk {
+
+	int x, y, z;
+	unsigned char blocks[16][16][16]; // all air until it's generated
+
+	int generated;
+	int edited; // since it was generated (so it can't just be generated again, and has to be kept)
+
+	unsigned char *message; // SERVER_MESSAGE_CHUNK, header and all, NULL if it hasn't been encoded since the last change
+	int message_length;
+
+	BlockChanges *changes; // NULL if nothing changed this tick
+
+	// everyone whose view the chunk is in
+	ChunkSubscriber *subscribers;
+	int subscriber_count;
+	int subscriber_capacity;
+
+	struct ServerChunk *next_in_bucket;
+
+} ServerChunk;
+
+// the one message a changed chunk's (sent) subscribers get for a tick
+typedef struct {
+
+	ServerChunk *chunk;
+	const unsigned char *message; // SERVER_MESSAGE_BLOCK, SERVER_MESSAGE_BLOCKS, or SERVER_MESSAGE_CHUNK
+	int length;
+
+} BlockDelta;
+
+#define SERVER_WORLDGEN_CACHE_CAPACITY 1024 // finished chunks the generator keeps (the world keeps its own copy of each)
+
+typedef struct {
+
+	WorldGenerator generator;
+
+	// chained hash table, doubling whenever there are more chunks than buckets
+	ServerChunk **buckets;
+	int bucket_mask;
+	int chunk_count;
+
+	long chunk_encodes;
+	long chunk_messages; // times get_chunk_message was called, cached or not
+
+	// chunks with blocks changed since collect_block_deltas was last called
+	ServerChunk **changed_chunks;
+	int changed_chunk_count;
+	int changed_chunk_capacity;
+
+	// what collect_block_deltas made of them (valid until it's called again)
+	BlockDelta *deltas;
+	int delta_count;
+	EZArray delta_messages;
+
+} ServerWorld;
+
+static unsigned int hash_server_chunk_coords(int x, int y, int z) {
+
+	return ((unsigned int) x * 73856093u) ^ ((unsigned int) y * 19349663u) ^ ((unsigned int) z * 83492791u);
+}
+
+void initialize_server_world(ServerWorld *world, unsigned int seed) {
+
+	memset(world, 0, sizeof(ServerWorld));
+
+	initialize_world_generator(&world->generator, seed, 0, SERVER_WORLDGEN_CACHE_CAPACITY);
+
+	world->buckets = calloc(1024, sizeof(ServerChunk *));
+	world->bucket_mask = 1023;
+}
+
+void free_server_world(ServerWorld *world) {
+
+	for (int i = 0; i <= world->bucket_mask; i++) {
+
+		ServerChunk *chunk = world->buckets[i];
+
+		while (chunk) {
+
+			ServerChunk *next = chunk->next_in_bucket;
+
+			free(chunk->message);
+			free(chunk->changes);
+			free(chunk->subscribers);
+			free(chunk);
+
+			chunk = next;
+		}
+	}
+
+	free_world_generator(&world->generator);
+
+	free(world->buckets);
+	free(world->changed_chunks);
+	free(world->deltas);
+	free(world->delta_messages.data);
+}
+
+// fills in the chunk's blocks if the generator's finished them (or already had), returns FALSE if it hasn't yet (it's
+// working on them now, so ask again later)
+int generate_server_chunk(ServerWorld *world, ServerChunk *chunk) {
+
+	if (chunk->generated)
+		return TRUE;
+
+	ChunkBlocks blocks = {0};
+
+	if (!request_generated_chunk(&world->generator, chunk->x, chunk->y, chunk->z, &blocks))
+		return FALSE;
+
+	unpack_chunk_blocks(&blocks, chunk->blocks);
+	free_chunk_blocks(&blocks);
+
+	chunk->generated = TRUE;
+
+	return TRUE;
+}
+
+static void grow_server_world(ServerWorld *world) {
+
+	int bucket_count = (world->bucket_mask + 1) * 2;
+	ServerChunk **buckets = calloc(bucket_count, sizeof(ServerChunk *));
+
+	for (int i = 0; i <= world->bucket_mask; i++) {
+
+		ServerChunk *chunk = world->buckets[i];
+
+		while (chunk) {
+
+			ServerChunk *next = chunk->next_in_bucket;
+			unsigned int bucket = hash_server_chunk_coords(chunk->x, chunk->y, chunk->z) & (bucket_count - 1);
+
+			chunk->next_in_bucket = buckets[bucket];
+			buckets[bucket] = chunk;
+
+			chunk = next;
+		}
+	}
+
+	free(world->buckets);
+	world->buckets = buckets;
+	world->bucket_mask = bucket_count - 1;
+}
+
+// returns NULL if the chunk isn't there
+ServerChunk *find_server_chunk(const ServerWorld *world, int x, int y, int z) {
+
+	ServerChunk *chunk = world->buckets[hash_server_chunk_coords(x, y, z) & world->bucket_mask];
+
+	while (chunk && (chunk->x != x || chunk->y != y || chunk->z != z)) {
+		chunk = chunk->next_in_bucket;
+	}
+
+	return chunk;
+}
+
+// adds the chunk if it isn't there yet, ungenerated (see generate_server_chunk)
+ServerChunk *get_server_chunk(ServerWorld *world, int x, int y, int z) {
+
+	ServerChunk *chunk = find_server_chunk(world, x, y, z);
+
+	if (chunk)
+		return chunk;
+
+	if (world->chunk_count > world->bucket_mask)
+		grow_server_world(world);
+
+	chunk = calloc(1, sizeof(ServerChunk));
+	chunk->x = x;
+	chunk->y = y;
+	chunk->z = z;
+
+	unsigned int bucket = hash_server_chunk_coords(x, y, z) & world->bucket_mask;
+	chunk->next_in_bucket = world->buckets[bucket];
+	world->buckets[bucket] = chunk;
+	world->chunk_count++;
+
+	return chunk;
+}
+
+// frees the chunk if nobody's subscribed to it and it hasn't been edited (so it'd be generated the same way again),
+// returns FALSE if it's kept
+int release_server_chunk(ServerWorld *world, ServerChunk *chunk) {
+
+	if (chunk->subscriber_count || chunk->edited)
+		return FALSE;
+
+	// (it might have been asked of the generator, but it won't be collected now)
+	if (!chunk->generated)
+		cancel_generated_chunk(&world->generator, chunk->x, chunk->y, chunk->z);
+
+	ServerChunk **link = &world->buckets[hash_server_chunk_coords(chunk->x, chunk->y, chunk->z) & world->bucket_mask];
+
+	while (*link != chunk) {
+		link = &(*link)->next_in_bucket;
+	}
+
+	*link = chunk->next_in_bucket;
+	world->chunk_count--;
+
+	free(chunk->message);
+	free(chunk->subscribers);
+	free(chunk);
+
+	return TRUE;
+}
+
+void subscribe_to_chunk(ServerChunk *chunk, void *subscriber) {
+
+	if (chunk->subscriber_count == chunk->subscriber_capacity) {
+		chunk->subscriber_capacity = chunk->subscriber_capacity ? chunk->subscriber_capacity * 2 : 4;
+		chunk->subscribers = realloc(chunk->subscribers, sizeof(ChunkSubscriber) * chunk->subscriber_capacity);
+	}
+
+	chunk->subscribers[chunk->subscriber_count++] = (ChunkSubscriber) { subscriber, FALSE };
+}
+
+// returns NULL if they aren't subscribed
+ChunkSubscriber *find_chunk_subscriber(ServerChunk *chunk, void *subscriber) {
+
+	for (int i = 0; i < chunk->subscriber_count; i++) {
+
+		if (chunk->subscribers[i].subscriber == subscriber)
+			return &chunk->subscribers[i];
+	}
+
+	return NULL;
+}
+
+void unsubscribe_from_chunk(ServerChunk *chunk, void *subscriber) {
+
+	ChunkSubscriber *entry = find_chunk_subscriber(chunk, subscriber);
+
+	if (entry)
+		*entry = chunk->subscribers[--chunk->subscriber_count];
+}
+
+// the change goes out to players with the rest of the tick's changes to the chunk (see collect_block_deltas)
+// only changes chunks that have been generated (so a change can't make the world any bigger), returns FALSE otherwise
+int set_server_block(ServerWorld *world, int x, int y, int z, unsigned char block) {
+
+	ServerChunk *chunk = find_server_chunk(world, BLOCK_TO_CHUNK(x), BLOCK_TO_CHUNK(y), BLOCK_TO_CHUNK(z));
+
+	if (!chunk || !chunk->generated)
+		return FALSE;
+
+	int local_x = BLOCK_TO_LOCAL(x);
+	int local_y = BLOCK_TO_LOCAL(y);
+	int local_z = BLOCK_TO_LOCAL(z);
+
+	if (chunk->blocks[local_x][local_y][local_z] == block)
+		return TRUE;
+
+	chunk->blocks[local_x][local_y][local_z] = block;
+	chunk->edited = TRUE;
+
+	// the cached message is out of date
+	free(chunk->message);
+	chunk->message = NULL;
+
+	if (!chunk->changes) {
+
+		chunk->changes = calloc(1, sizeof(BlockChanges));
+
+		if (world->changed_chunk_count == world->changed_chunk_capacity) {
+			world->changed_chunk_capacity = world->changed_chunk_capacity ? world->changed_chunk_capacity * 2 : 64;
+			world->changed_chunks = realloc(world->changed_chunks, sizeof(ServerChunk *) * world->changed_chunk_capacity);
+		}
+
+		world->changed_chunks[world->changed_chunk_count++] = chunk;
+	}
+
+	BlockChanges *changes = chunk->changes;
+	int index = local_x << 8 | local_y << 4 | local_z;
+
+	if (changes->changed[index >> 6] & (uint64_t) 1 << (index & 63))
+		return TRUE;
+
+	changes->changed[index >> 6] |= (uint64_t) 1 << (index & 63);
+
+	if (changes->count < MAX_BLOCK_DELTA_CHANGES)
+		changes->indices[changes->count] = index;
+
+	changes->count++;
+
+	return TRUE;
+}
+
+// the chunk's SERVER_MESSAGE_CHUNK, encoding it only if it changed since last time (the result belongs to the chunk, which
+// has to have been generated)
+const unsigned char *get_chunk_message(ServerWorld *world, ServerChunk *chunk, int *length) {
+
+	world->chunk_messages++;
+
+	if (!chunk->message) {
+
+		unsigned char message[CHUNK_MESSAGE_HEADER_SIZE + MAX_ENCODED_CHUNK_SIZE];
+
+		message[0] = SERVER_MESSAGE_CHUNK;
+		put_message_uint(message + 1, chunk->x);
+		put_message_uint(message + 5, chunk->y);
+		put_message_uint(message + 9, chunk->z);
+
+		chunk->message_length = CHUNK_MESSAGE_HEADER_SIZE + encode_chunk(chunk->blocks, TRUE, message + CHUNK_MESSAGE_HEADER_SIZE);
+		chunk->message = malloc(chunk->message_length);
+		memcpy(chunk->message, message, chunk->message_length);
+
+		world->chunk_encodes++;
+	}
+
+	*length = chunk->message_length;
+
+	return chunk->message;
+}
+
+// turns every chunk's changes since the last call into one message for the chunk: a single block, a batch of blocks
+// (BLOCK_CHANGE_SIZE bytes each, see ../../chunk_format.c), or the whole chunk when that many changes would be bigger
+// the results are in world->deltas
+void collect_block_deltas(ServerWorld *world) {
+
+	world->delta_count = 0;
+	world->delta_messages.bytecount = 0;
+
+	world->deltas = realloc(world->deltas, sizeof(BlockDelta) * (world->changed_chunk_capacity + 1));
+
+	for (int i = 0; i < world->changed_chunk_count; i++) {
+
+		ServerChunk *chunk = world->changed_chunks[i];
+		BlockChanges *changes = chunk->changes;
+		BlockDelta *delta = &world->deltas[world->delta_count++];
+
+		delta->chunk = chunk;
+
+		// (a single block's message is smaller than any chunk's)
+		int chunk_length = 0;
+
+		if (changes->count > 1)
+			get_chunk_message(world, chunk, &chunk_length);
+
+		if (changes->count > MAX_BLOCK_DELTA_CHANGES || (changes->count > 1 && chunk_length <= CHUNK_MESSAGE_HEADER_SIZE + changes->count * BLOCK_CHANGE_SIZE)) {
+
+			delta->message = get_chunk_message(world, chunk, &delta->length);
+
+		} else if (changes->count == 1) {
+
+			int index = changes->indices[0];
+			unsigned char message[14] = { SERVER_MESSAGE_BLOCK };
+
+			put_message_uint(message + 1, chunk->x * 16 + (index >> 8));
+			put_message_uint(message + 5, chunk->y * 16 + (index >> 4 & 15));
+			put_message_uint(message + 9, chunk->z * 16 + (index & 15));
+			message[13] = chunk->blocks[index >> 8][index >> 4 & 15][index & 15];
+
+			delta->message = NULL; // (pointed into delta_messages below, once it's done moving around)
+			delta->length = sizeof(message);
+			append_ezarray(&world->delta_messages, message, sizeof(message));
+
+		} else {
+
+			unsigned char message[CHUNK_MESSAGE_HEADER_SIZE + MAX_BLOCK_DELTA_CHANGES * BLOCK_CHANGE_SIZE] = { SERVER_MESSAGE_BLOCKS };
+
+			put_message_uint(message + 1, chunk->x);
+			put_message_uint(message + 5, chunk->y);
+			put_message_uint(message + 9, chunk->z);
+
+			for (int c = 0; c < changes->count; c++) {
+
+				int index = changes->indices[c];
+				int x = index >> 8, y = index >> 4 & 15, z = index & 15;
+
+				put_block_change(message + CHUNK_MESSAGE_HEADER_SIZE + c * BLOCK_CHANGE_SIZE, x, y, z, chunk->blocks[x][y][z]);
+			}
+
+			delta->message = NULL;
+			delta->length = CHUNK_MESSAGE_HEADER_SIZE + changes->count * BLOCK_CHANGE_SIZE;
+			append_ezarray(&world->delta_messages, message, delta->length);
+		}
+
+		free(chunk->changes);
+		chunk->changes = NULL;
+	}
+
+	world->changed_chunk_count = 0;
+
+	int offset = 0;
+
+	for (int i = 0; i < world->delta_count; i++) {
+
+		if (world->deltas[i].message == NULL) {
+			world->deltas[i].message = world->delta_messages.data + offset;
+			offset += world->deltas[i].length;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TERRAIN_DEFINED
+
+#define TERRAIN_DEFINED
+
+// what the world is made of, shared by the client and the server (like util.c), which both generate it with
+// client/src/worldgen.c, so the same seed is the same terrain on both
+
+// block types (see block_types in client/src/mesher.c for how each one looks)
+#define BLOCK_AIR    0
+#define BLOCK_GRASS  1
+#define BLOCK_DIRT   2
+#define BLOCK_STONE  3
+#define BLOCK_LOG    4
+#define BLOCK_LEAVES 5
+
+// arithmetic shift/mask, so negative block coordinates map to the correct chunk
+#define BLOCK_TO_CHUNK(coord) ((coord) >> 4)
+#define BLOCK_TO_LOCAL(coord) ((coord) & 15)
+
+#define WORLDGEN_HILL_FREQUENCY (1 / 48.0f) // per block
+#define WORLDGEN_HILL_OCTAVES 4
+#define WORLDGEN_CAVE_THRESHOLD 0.3f      // higher means fewer caves
+#define WORLDGEN_TREE_CHANCE 64           // one in this many grass blocks grows a tree
+
+#endif
@@ -2,6 +2,14 @@
 
 #define UTIL_DEFINED
 
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define TRUE 1
 #define FALSE 0
 #define DEG2RAD (M_PI / 180)
@@ -49,36 +57,257 @@ void append_ezarray(EZArray *array, void *data, int data_length) {
 	array->bytecount += data_length;
 }
 
-void populate_2D_noise(int width, int height, int smoothness, float *buffer) {
+// seeded gradient noise ("Perlin" noise), a pure function of the seed and the coordinates, so it's safe to call from
+// any thread and any chunk can be generated on its own (in any order) and still line up with its neighbors
+
+static inline unsigned int hash_noise_lattice(unsigned int seed, int x, int y) {
+
+	unsigned int hash = seed ^ (unsigned int) x * 0x27d4eb2du ^ (unsigned int) y * 0x165667b1u;
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6du;
+	hash ^= hash >> 12;
+
+	return hash;
+}
+
+static inline float fade_noise(float t) {
+
+	return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+// the gradients are the four diagonals, picked by the low two bits of the hash
+static inline float dot_noise_gradient(unsigned int hash, float dx, float dy) {
+
+	return (hash & 1 ? -dx : dx) + (hash & 2 ? -dy : dy);
+}
+
+// returns roughly -1 to 1, with features about 1 unit apart
+float gradient_noise_2D(unsigned int seed, float x, float y) {
+
+	int xi = (int) floorf(x);
+	int yi = (int) floorf(y);
+
+	float dx = x - (float) xi;
+	float dy = y - (float) yi;
+
+	float n00 = dot_noise_gradient(hash_noise_lattice(seed, xi, yi), dx, dy);
+	float n10 = dot_noise_gradient(hash_noise_lattice(seed, xi + 1, yi), dx - 1, dy);
+	float n01 = dot_noise_gradient(hash_noise_lattice(seed, xi, yi + 1), dx, dy - 1);
+	float n11 = dot_noise_gradient(hash_noise_lattice(seed, xi + 1, yi + 1), dx - 1, dy - 1);
+
+	float u = fade_noise(dx);
+	float v = fade_noise(dy);
+
+	float nx0 = n00 + u * (n10 - n00);
+	float nx1 = n01 + u * (n11 - n01);
+
+	return nx0 + v * (nx1 - nx0);
+}
+
+#define NOISE_OCTAVE_SEED_STEP 0x9e3779b9u // each octave gets its own seed, so they don't line up at the origin
+
+// octaves of gradient noise, each at double the frequency and half the amplitude of the last, returns roughly -1 to 1
+float fractal_noise_2D(unsigned int seed, float x, float y, int octaves) {
+
+	float total = 0;
+	float amplitude = 1;
+	float frequency = 1;
+	float amplitude_sum = 0;
 
-	// these comments were made for 1D noise and I kinda just extrapolated the code to 2D the best I could
+	for (int octave = 0; octave < octaves; octave++) {
 
-	// generate array of random values
-	for (int i = 0; i < width * height; i++) {
-		buffer[i] = random_uint(10000) * 0.0001;
+		total += amplitude * gradient_noise_2D(seed + octave * NOISE_OCTAVE_SEED_STEP, x * frequency, y * frequency);
+		amplitude_sum += amplitude;
+
+		amplitude *= 0.5f;
+		frequency *= 2;
 	}
 
-	// smoothing step (must repeat this ~20 times or until smooth)
-	for (int i = 0; i < smoothness; i++) {
+	return total / amplitude_sum;
+}
 
-		// for every element except the last one, average it with the element following it
-		for (int x = 0; x < width - 1; x++) {
-			for (int y = 0; y < height - 1; y++) {
-			
-				buffer[y * width + x] = (buffer[y * width + x] + buffer[y * width + x + 1] + buffer[(y + 1) * width + x] + buffer[(y + 1) * width + x + 1]) / 4;
-			}
-		}
+static inline unsigned int hash_noise_lattice_3D(unsigned int seed, int x, int y, int z) {
 
-		// finally set the last element to the first element
-		for (int x = 0; x < width - 1; x++) {
+	return hash_noise_lattice(seed ^ (unsigned int) z * 0x9e3779b1u, x, y);
+}
 
-			buffer[(height - 1) * width + x] = buffer[x];
-		}
+// the gradients are the 12 cube edge midpoints (as in improved Perlin noise), picked by the low four bits of the hash
+static inline float dot_noise_gradient_3D(unsigned int hash, float dx, float dy, float dz) {
+
+	int h = hash & 15;
+	float u = h < 8 ? dx : dy;
+	float v = h < 4 ? dy : h == 12 || h == 14 ? dx : dz;
+
+	return (h & 1 ? -u : u) + (h & 2 ? -v : v);
+}
+
+// 3D version of gradient_noise_2D (no SIMD row version, since terrain only needs it for a few samples per column)
+float gradient_noise_3D(unsigned int seed, float x, float y, float z) {
+
+	int xi = (int) floorf(x);
+	int yi = (int) floorf(y);
+	int zi = (int) floorf(z);
+
+	float dx = x - (float) xi;
+	float dy = y - (float) yi;
+	float dz = z - (float) zi;
+
+	float u = fade_noise(dx);
+	float v = fade_noise(dy);
+	float w = fade_noise(dz);
+
+	float corners[2][2][2];
+
+	for (int cx = 0; cx < 2; cx++)
+		for (int cy = 0; cy < 2; cy++)
+			for (int cz = 0; cz < 2; cz++)
+				corners[cx][cy][cz] = dot_noise_gradient_3D(hash_noise_lattice_3D(seed, xi + cx, yi + cy, zi + cz), dx - cx, dy - cy, dz - cz);
+
+	float x00 = corners[0][0][0] + u * (corners[1][0][0] - corners[0][0][0]);
+	float x10 = corners[0][1][0] + u * (corners[1][1][0] - corners[0][1][0]);
+	float x01 = corners[0][0][1] + u * (corners[1][0][1] - corners[0][0][1]);
+	float x11 = corners[0][1][1] + u * (corners[1][1][1] - corners[0][1][1]);
+
+	float y0 = x00 + v * (x10 - x00);
+	float y1 = x01 + v * (x11 - x01);
+
+	return y0 + w * (y1 - y0);
+}
+
+float fractal_noise_3D(unsigned int seed, float x, float y, float z, int octaves) {
+
+	float total = 0;
+	float amplitude = 1;
+	float frequency = 1;
+	float amplitude_sum = 0;
+
+	for (int octave = 0; octave < octaves; octave++) {
+
+		total += amplitude * gradient_noise_3D(seed + octave * NOISE_OCTAVE_SEED_STEP, x * frequency, y * frequency, z * frequency);
+		amplitude_sum += amplitude;
+
+		amplitude *= 0.5f;
+		frequency *= 2;
+	}
+
+	return total / amplitude_sum;
+}
+
+#ifdef __SSE2__
+
+// SSE2 has no 32 bit multiply-low (that's SSE4.1), so multiply the even and odd lanes separately and interleave them
+static inline __m128i multiply_noise_lanes(__m128i a, __m128i b) {
+
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// the same math as above for four samples at once, op for op, so both paths give the exact same terrain
+static inline __m128i hash_noise_lattice_4(__m128i seed, __m128i x, __m128i y) {
+
+	__m128i hash = _mm_xor_si128(seed, _mm_xor_si128(multiply_noise_lanes(x, _mm_set1_epi32(0x27d4eb2d)), multiply_noise_lanes(y, _mm_set1_epi32(0x165667b1))));
+	hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 15));
+	hash = multiply_noise_lanes(hash, _mm_set1_epi32(0x2c1b3c6d));
+	hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 12));
+
+	return hash;
+}
+
+static inline __m128 fade_noise_4(__m128 t) {
+
+	__m128 polynomial = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6)), _mm_set1_ps(15))), _mm_set1_ps(10));
+
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), polynomial);
+}
+
+static inline __m128 dot_noise_gradient_4(__m128i hash, __m128 dx, __m128 dy) {
+
+	// negating is flipping the sign bit, so move hash bits 0 and 1 up to bit 31
+	__m128 x_sign = _mm_castsi128_ps(_mm_slli_epi32(hash, 31));
+	__m128 y_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(hash, 1), 31));
+
+	return _mm_add_ps(_mm_xor_ps(dx, x_sign), _mm_xor_ps(dy, y_sign));
+}
+
+static inline __m128 gradient_noise_2D_4(__m128i seed, __m128 x, __m128 y) {
+
+	// floor is truncation, minus one wherever that rounded up (negative coordinates)
+	__m128i xi = _mm_cvttps_epi32(x);
+	__m128i yi = _mm_cvttps_epi32(y);
+	xi = _mm_add_epi32(xi, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(xi))));
+	yi = _mm_add_epi32(yi, _mm_castps_si128(_mm_cmplt_ps(y, _mm_cvtepi32_ps(yi))));
+
+	__m128 dx = _mm_sub_ps(x, _mm_cvtepi32_ps(xi));
+	__m128 dy = _mm_sub_ps(y, _mm_cvtepi32_ps(yi));
+	__m128 dx1 = _mm_sub_ps(dx, _mm_set1_ps(1));
+	__m128 dy1 = _mm_sub_ps(dy, _mm_set1_ps(1));
 
-		for (int y = 0; y < height; y++) {
+	__m128i one = _mm_set1_epi32(1);
+	__m128i xi1 = _mm_add_epi32(xi, one);
+	__m128i yi1 = _mm_add_epi32(yi, one);
 
-			buffer[y * width + (width - 1)] = buffer[y * width];
+	__m128 n00 = dot_noise_gradient_4(hash_noise_lattice_4(seed, xi, yi), dx, dy);
+	__m128 n10 = dot_noise_gradient_4(hash_noise_lattice_4(seed, xi1, yi), dx1, dy);
+	__m128 n01 = dot_noise_gradient_4(hash_noise_lattice_4(seed, xi, yi1), dx, dy1);
+	__m128 n11 = dot_noise_gradient_4(hash_noise_lattice_4(seed, xi1, yi1), dx1, dy1);
+
+	__m128 u = fade_noise_4(dx);
+	__m128 v = fade_noise_4(dy);
+
+	__m128 nx0 = _mm_add_ps(n00, _mm_mul_ps(u, _mm_sub_ps(n10, n00)));
+	__m128 nx1 = _mm_add_ps(n01, _mm_mul_ps(u, _mm_sub_ps(n11, n01)));
+
+	return _mm_add_ps(nx0, _mm_mul_ps(v, _mm_sub_ps(nx1, nx0)));
+}
+
+#endif
+
+// fills samples[i] with fractal_noise_2D(seed, x + i * step, y, octaves), four samples at a time where SSE2 is available
+void fractal_noise_2D_row(unsigned int seed, float x, float y, float step, int octaves, int count, float *samples) {
+
+	int i = 0;
+
+#ifdef __SSE2__
+
+	for (; i + 4 <= count; i += 4) {
+
+		__m128 row_x = _mm_add_ps(_mm_set1_ps(x), _mm_mul_ps(_mm_setr_ps(i, i + 1, i + 2, i + 3), _mm_set1_ps(step)));
+		__m128 row_y = _mm_set1_ps(y);
+
+		__m128 total = _mm_setzero_ps();
+		float amplitude = 1;
+		float frequency = 1;
+		float amplitude_sum = 0;
+
+		for (int octave = 0; octave < octaves; octave++) {
+
+			__m128i octave_seed = _mm_set1_epi32(seed + octave * NOISE_OCTAVE_SEED_STEP);
+			__m128 noise = gradient_noise_2D_4(octave_seed, _mm_mul_ps(row_x, _mm_set1_ps(frequency)), _mm_mul_ps(row_y, _mm_set1_ps(frequency)));
+
+			total = _mm_add_ps(total, _mm_mul_ps(_mm_set1_ps(amplitude), noise));
+			amplitude_sum += amplitude;
+
+			amplitude *= 0.5f;
+			frequency *= 2;
 		}
+
+		_mm_storeu_ps(&samples[i], _mm_div_ps(total, _mm_set1_ps(amplitude_sum)));
+	}
+
+#endif
+
+	for (; i < count; i++) {
+		samples[i] = fractal_noise_2D(seed, x + (float) i * step, y, octaves);
+	}
+}
+
+// heightmap[x][z] is the noise at block (chunk_x * 16 + x, chunk_z * 16 + z), scaled by frequency (features per block)
+void populate_chunk_heightmap(unsigned int seed, int chunk_x, int chunk_z, float frequency, int octaves, float heightmap[16][16]) {
+
+	for (int x = 0; x < 16; x++) {
+		fractal_noise_2D_row(seed, (float) (chunk_z * 16) * frequency, (float) (chunk_x * 16 + x) * frequency, frequency, octaves, 16, heightmap[x]);
 	}
 }
 